@@ -0,0 +1,277 @@
+/* ---------------------------------------------------------------------------
+ #
+ #       L-Py: L-systems in Python
+ #
+ #       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+ #
+ #       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+ #
+ # ---------------------------------------------------------------------------
+ #
+ #                      GNU General Public Licence
+ #
+ #       This program is free software; you can redistribute it and/or
+ #       modify it under the terms of the GNU General Public License as
+ #       published by the Free Software Foundation; either version 2 of
+ #       the License, or (at your option) any later version.
+ #
+ #       This program is distributed in the hope that it will be useful,
+ #       but WITHOUT ANY WARRANTY; without even the implied warranty of
+ #       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+ #       GNU General Public License for more details.
+ #
+ #       You should have received a copy of the GNU General Public
+ #       License along with this program; see the file COPYING. If not,
+ #       write to the Free Software Foundation, Inc., 59
+ #       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ #
+ # ---------------------------------------------------------------------------
+ */
+
+/* Derivation benchmark over a directory of L-Py models.
+
+   usage: lpy_benchmark [models directory] [output json file]
+
+   Each .lpy file is loaded through an embedded interpreter and the timings of 
+   parsing, compilation of the generated code, each derivation iteration, 
+   homomorphism and string serialization are reported in JSON, with the
+   derivation throughput in modules per second. As the models share the 
+   process, the memory of a model is reported as the change of resident 
+   memory while it is alive (residentMemoryDelta) and only the whole run 
+   reports the peak memory of the process. 
+   The compilation cache is redirected to a temporary directory so that every 
+   run measures a cold compilation.
+*/
+
+#define BOOST_PYTHON_STATIC_LIB
+#include <boost/python.hpp>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QStringList>
+#include <QtCore/QCoreApplication>
+#include "../cpp/lsystem.h"
+#include "../cpp/compilation.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+#endif
+
+using namespace boost::python;
+#define bp boost::python
+LPY_USING_NAMESPACE
+
+#if PY_VERSION_HEX >= 0x03000000
+extern "C" PyObject * PyInit_lpy();
+#else
+extern "C" void initlpy();
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+typedef std::chrono::steady_clock Clock;
+
+static inline double seconds_since(const Clock::time_point& start)
+{ return std::chrono::duration<double>(Clock::now() - start).count(); }
+
+/// Peak resident memory of the process in bytes.
+static size_t peak_memory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return size_t(usage.ru_maxrss);
+#else
+	return size_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+/// Current resident memory of the process in bytes, 0 if unknown.
+static size_t resident_memory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0;
+#elif defined(__APPLE__)
+	mach_task_basic_info_data_t info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS)
+		return size_t(info.resident_size);
+	return 0;
+#else
+	std::ifstream statm("/proc/self/statm");
+	size_t size = 0, resident = 0;
+	if (statm >> size >> resident) return resident * size_t(sysconf(_SC_PAGESIZE));
+	return 0;
+#endif
+}
+
+/// Return the message of the current python error and clear it.
+static std::string python_error_message()
+{
+	PyObject * type, * value, * traceback;
+	PyErr_Fetch(&type, &value, &traceback);
+	std::string message = "Unknown error";
+	if (value) {
+		PyObject * str = PyObject_Str(value);
+		if (str) { 
+			message = extract<std::string>(str)(); 
+			Py_DECREF(str); 
+		}
+	}
+	Py_XDECREF(type); Py_XDECREF(value); Py_XDECREF(traceback);
+	PyErr_Clear();
+	return message;
+}
+
+static std::string read_file(const std::string& filename)
+{
+	std::ifstream file(filename.c_str());
+	std::stringstream buffer; 
+	buffer << file.rdbuf();
+	return buffer.str();
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bp::dict benchmark_model(const std::string& filename)
+{
+	bp::dict result;
+	result["file"] = filename;
+	std::string code = read_file(filename);
+	size_t memory = resident_memory();
+	// The lsystem is destroyed after the error has been handled since its cleaning calls python.
+	Lsystem lsystem;
+	try {
+		lsystem.setFilename(filename);
+
+		// Loading the model parses it and compiles the generated python code. 
+		// The compilation is timed again separately to isolate the parsing time.
+		std::string pycode;
+		Clock::time_point start = Clock::now();
+		lsystem.set(code, &pycode);
+		double loading = seconds_since(start);
+
+		start = Clock::now();
+		PyObject * codeobject = Py_CompileString(pycode.c_str(), filename.c_str(), Py_file_input);
+		double compilation = seconds_since(start);
+		if (!codeobject) throw_error_already_set();
+		Py_DECREF(codeobject);
+
+		result["parse"] = std::max(0.0, loading - compilation);
+		result["compile"] = compilation;
+
+		bp::list iterations;
+		AxialTree workstring = lsystem.getAxiom();
+		size_t nbmodules = 0;
+		double derivation = 0;
+		for (size_t i = 0; i < lsystem.derivationLength(); ++i) {
+			start = Clock::now();
+			workstring = lsystem.derive(workstring, i, 1);
+			double duration = seconds_since(start);
+			derivation += duration;
+			nbmodules += workstring.size();
+			bp::dict iteration;
+			iteration["iteration"] = i;
+			iteration["duration"] = duration;
+			iteration["length"] = workstring.size();
+			iterations.append(iteration);
+		}
+		result["iterations"] = iterations;
+		result["derive"] = derivation;
+		result["length"] = workstring.size();
+		result["modulesPerSecond"] = (derivation > 0 ? nbmodules / derivation : 0.0);
+
+		start = Clock::now();
+		lsystem.interpret(workstring);
+		result["homomorphism"] = seconds_since(start);
+
+		start = Clock::now();
+		std::string text = workstring.str();
+		result["strSerialization"] = seconds_since(start);
+
+		start = Clock::now();
+		std::string binary = workstring.toBinary();
+		result["binarySerialization"] = seconds_since(start);
+	}
+	catch (error_already_set) {
+		result["error"] = python_error_message();
+	}
+	catch (std::exception& e) {
+		result["error"] = std::string(e.what());
+	}
+	// signed since memory can be given back to the system.
+	result["residentMemoryDelta"] = (long long)resident_memory() - (long long)memory;
+	return result;
+}
+
+int main(int argc, char ** argv)
+{
+	std::string modeldir = (argc > 1 ? argv[1] : "models");
+	std::string output = (argc > 2 ? argv[2] : "");
+
+	QCoreApplication application(argc, argv);
+
+#if PY_VERSION_HEX >= 0x03000000
+	PyImport_AppendInittab("lpy", &PyInit_lpy);
+#else
+	PyImport_AppendInittab("lpy", &initlpy);
+#endif
+	Py_Initialize();
+	int status = 0;
+	QString cachedir = QDir::temp().filePath(QString("lpy_benchmark_%1").arg(QCoreApplication::applicationPid()));
+	try {
+		bp::import("lpy");
+		bp::object json = bp::import("json");
+
+		Compilation::setCacheDirectory(cachedir.toStdString());
+
+		QStringList filenames;
+		QDirIterator it(QString::fromStdString(modeldir), QStringList("*.lpy"), QDir::Files, QDirIterator::Subdirectories);
+		while (it.hasNext()) filenames.append(it.next());
+		filenames.sort();
+
+		bp::list models;
+		for (QStringList::const_iterator itf = filenames.begin(); itf != filenames.end(); ++itf) {
+			std::string filename = itf->toStdString();
+			std::cerr << "Benchmarking " << filename << std::endl;
+			Compilation::clearMemoryCache();
+			models.append(benchmark_model(filename));
+		}
+
+		bp::dict report;
+		report["models"] = models;
+		report["processPeakMemory"] = peak_memory();
+		bp::dict options;
+		options["indent"] = 2;
+		std::string text = extract<std::string>(json.attr("dumps")(*bp::make_tuple(report), **options))();
+		if (output.empty()) std::cout << text << std::endl;
+		else std::ofstream(output.c_str()) << text << std::endl;
+	}
+	catch (error_already_set) {
+		PyErr_Print();
+		status = 1;
+	}
+	QDir(cachedir).removeRecursively();
+	return status;
+}
@@ -0,0 +1,241 @@
+/* ---------------------------------------------------------------------------
+ #
+ #       L-Py: L-systems in Python
+ #
+ #       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+ #
+ #       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+ #
+ # ---------------------------------------------------------------------------
+ #
+ #                      GNU General Public Licence
+ #
+ #       This program is free software; you can redistribute it and/or
+ #       modify it under the terms of the GNU General Public License as
+ #       published by the Free Software Foundation; either version 2 of
+ #       the License, or (at your option) any later version.
+ #
+ #       This program is distributed in the hope that it will be useful,
+ #       but WITHOUT ANY WARRANTY; without even the implied warranty of
+ #       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+ #       GNU General Public License for more details.
+ #
+ #       You should have received a copy of the GNU General Public
+ #       License along with this program; see the file COPYING. If not,
+ #       write to the Free Software Foundation, Inc., 59
+ #       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ #
+ # ---------------------------------------------------------------------------
+ */
+
+/* Microbenchmarks of the module and string matching strategies of MatchingEngine.
+
+   usage: lpy_matching_benchmark [depth] [branching factor] [ignore density] [output json file]
+
+   A synthetic AxialTree is generated with axes of 8 modules A carrying branches
+   up to the given depth, each module of an axis bearing the given number of 
+   branches. Modules I are inserted before each A with the ignore density as 
+   probability. The throughput of module_match is measured for each module 
+   matching method, and those of right_match and left_match for each string 
+   matching method and each ConsiderFilter setting (none, ignoring I, considering A).
+   Results are reported in JSON.
+*/
+
+#define BOOST_PYTHON_STATIC_LIB
+#include <boost/python.hpp>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include "../cpp/matching.h"
+#include "../cpp/consider.h"
+
+using namespace boost::python;
+#define bp boost::python
+LPY_USING_NAMESPACE
+
+#if PY_VERSION_HEX >= 0x03000000
+extern "C" PyObject * PyInit_lpy();
+#else
+extern "C" void initlpy();
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+typedef std::chrono::steady_clock Clock;
+
+static inline double seconds_since(const Clock::time_point& start)
+{ return std::chrono::duration<double>(Clock::now() - start).count(); }
+
+/// Minimal duration in seconds of each measure.
+static const double MeasureDuration = 0.2;
+
+static const size_t AxisLength = 8;
+
+struct TreeParameters {
+	size_t depth;
+	size_t branching;
+	double ignoredensity;
+};
+
+static void grow_axis(AxialTree& tree, size_t depth, const TreeParameters& parameters, 
+					  std::mt19937& generator, size_t& counter)
+{
+	std::uniform_real_distribution<double> distribution(0,1);
+	for (size_t i = 0; i < AxisLength; ++i) {
+		if (distribution(generator) < parameters.ignoredensity) tree.append(ParamModule("I"));
+		tree.append(ParamModule("A", bp::object(counter++)));
+		if (depth > 0) {
+			for (size_t b = 0; b < parameters.branching; ++b) {
+				tree.append(ParamModule("["));
+				grow_axis(tree, depth-1, parameters, generator, counter);
+				tree.append(ParamModule("]"));
+			}
+		}
+	}
+}
+
+static AxialTree generate_tree(const TreeParameters& parameters)
+{
+	AxialTree tree;
+	std::mt19937 generator(0);
+	size_t counter = 0;
+	grow_axis(tree, parameters.depth, parameters, generator, counter);
+	return tree;
+}
+
+/*---------------------------------------------------------------------------*/
+
+enum eOperation { eModuleMatch, eRightMatch, eLeftMatch };
+
+/// Apply the operation on each position of the tree until MeasureDuration is reached.
+static bp::dict measure(eOperation operation, const AxialTree& tree, const PatternString& pattern)
+{
+	const PatternModule& patternmodule = *pattern.const_begin();
+	size_t calls = 0, matches = 0;
+	Clock::time_point start = Clock::now();
+	double duration = 0;
+	do {
+		for (AxialTree::const_iterator it = tree.const_begin(); it != tree.const_end(); ++it) {
+			ArgList args;
+			bool matched = false;
+			switch (operation) {
+				case eModuleMatch:
+					matched = MatchingEngine::module_match(*it, patternmodule, args);
+					break;
+				case eRightMatch: {
+					// as for a right context, it starts after a predecessor that is the last matched module.
+					AxialTree::const_iterator last_matched = it, matching_end;
+					matched = MatchingEngine::right_match(it+1, tree.const_begin(), tree.const_end(),
+														  pattern.const_begin(), pattern.const_end(),
+														  last_matched, matching_end, args);
+					break;
+				}
+				case eLeftMatch: {
+					// as for a left context, it ends before the predecessor at it.
+					AxialTree::const_iterator matching_end;
+					matched = MatchingEngine::left_match(it, tree.const_begin(), tree.const_end(),
+														 pattern.const_rbegin(), pattern.const_rend(),
+														 matching_end, args);
+					break;
+				}
+			}
+			++calls;
+			if (matched) ++matches;
+		}
+		duration = seconds_since(start);
+	} while (duration < MeasureDuration);
+
+	bp::dict result;
+	result["calls"] = calls;
+	result["matches"] = matches;
+	result["duration"] = duration;
+	result["callsPerSecond"] = calls / duration;
+	return result;
+}
+
+static bp::list benchmark_matching(const AxialTree& tree)
+{
+	static const char * ModuleMatchingNames[] = { "eMSimple", "eMWithStar", "eMWithStarNValueConstraint" };
+	static const char * StringMatchingNames[] = { "eString", "eAxialTree", "eMLevelAxialTree", "eMScaleAxialTree" };
+	static const char * FilterNames[] = { "none", "ignore I", "consider A" };
+
+	ConsiderFilterPtr filters[] = { ConsiderFilterPtr(), ConsiderFilter::ignore("I"), ConsiderFilter::consider("A") };
+	PatternString modulepattern("A(x)");
+	PatternString contextpattern("A(x)A(y)");
+
+	MatchingEngine::eModuleMatchingMethod modulemethod = MatchingEngine::getModuleMatchingMethod();
+	MatchingEngine::eStringMatchingMethod stringmethod = MatchingEngine::getStringMatchingMethod();
+
+	bp::list results;
+	for (int m = MatchingEngine::eMSimple; m <= MatchingEngine::eMWithStarNValueConstraint; ++m) {
+		MatchingEngine::setModuleMatchingMethod(MatchingEngine::eModuleMatchingMethod(m));
+		bp::dict result = measure(eModuleMatch, tree, modulepattern);
+		result["operation"] = "module_match";
+		result["moduleMatching"] = ModuleMatchingNames[m];
+		results.append(result);
+	}
+	MatchingEngine::setModuleMatchingMethod(modulemethod);
+
+	for (int s = MatchingEngine::eString; s <= MatchingEngine::eMScaleAxialTree; ++s) {
+		MatchingEngine::setStringMatchingMethod(MatchingEngine::eStringMatchingMethod(s));
+		for (int f = 0; f < 3; ++f) {
+			ConsiderFilterMaintainer filtermaintainer(filters[f]);
+			bp::dict result = measure(eRightMatch, tree, contextpattern);
+			result["operation"] = "right_match";
+			result["stringMatching"] = StringMatchingNames[s];
+			result["filter"] = FilterNames[f];
+			results.append(result);
+
+			result = measure(eLeftMatch, tree, contextpattern);
+			result["operation"] = "left_match";
+			result["stringMatching"] = StringMatchingNames[s];
+			result["filter"] = FilterNames[f];
+			results.append(result);
+		}
+	}
+	MatchingEngine::setStringMatchingMethod(stringmethod);
+	return results;
+}
+
+int main(int argc, char ** argv)
+{
+	TreeParameters parameters;
+	parameters.depth = (argc > 1 ? atoi(argv[1]) : 3);
+	parameters.branching = (argc > 2 ? atoi(argv[2]) : 2);
+	parameters.ignoredensity = (argc > 3 ? atof(argv[3]) : 0.3);
+	std::string output = (argc > 4 ? argv[4] : "");
+
+#if PY_VERSION_HEX >= 0x03000000
+	PyImport_AppendInittab("lpy", &PyInit_lpy);
+#else
+	PyImport_AppendInittab("lpy", &initlpy);
+#endif
+	Py_Initialize();
+	int status = 0;
+	try {
+		bp::import("lpy");
+		bp::object json = bp::import("json");
+
+		AxialTree tree = generate_tree(parameters);
+
+		bp::dict report;
+		report["depth"] = parameters.depth;
+		report["branching"] = parameters.branching;
+		report["ignoreDensity"] = parameters.ignoredensity;
+		report["length"] = tree.size();
+		report["results"] = benchmark_matching(tree);
+
+		bp::dict options;
+		options["indent"] = 2;
+		std::string text = extract<std::string>(json.attr("dumps")(*bp::make_tuple(report), **options))();
+		if (output.empty()) std::cout << text << std::endl;
+		else std::ofstream(output.c_str()) << text << std::endl;
+	}
+	catch (error_already_set) {
+		PyErr_Print();
+		status = 1;
+	}
+	return status;
+}
@@ -33,6 +33,7 @@
 #include <vector>
 #include <functional>
 #include "axialtree_manip.h"
+#include "tracker.h"
 #include <QtCore/QSharedData>
 
 LPY_BEGIN_NAMESPACE
@@ -82,16 +83,19 @@ private:
 	 typedef typename ModuleList::const_iterator const_iterator;
 
 	 LSInternal() : 
-		QSharedData(), m_string() {}
+		QSharedData(), m_string(), m_tracked(trackedBytes()) {}
 	 LSInternal(const LSInternal& other) : 
-		QSharedData(other), m_string(other.m_string) {}
+		QSharedData(other), m_string(other.m_string), m_tracked(trackedBytes()) {}
 	 LSInternal(const ModuleType& m): 
-		QSharedData(),m_string(1,m) {}
+		QSharedData(),m_string(1,m), m_tracked(trackedBytes()) {}
      LSInternal(const_iterator beg, const_iterator end) : 
-			QSharedData(), m_string(beg,end) {}
+			QSharedData(), m_string(beg,end), m_tracked(trackedBytes()) {}
      ~LSInternal() {}
 
+	 inline size_t trackedBytes() const { return sizeof(LSInternal) + m_string.capacity() * sizeof(ModuleType); }
+
      ModuleList m_string;
+	 mutable TrackedInstance<TrackedStringCategory<ModuleType>::value> m_tracked;
  };
 
 
@@ -105,6 +109,9 @@ protected:
  const ModuleList& string() const { return m_data->m_string; }
  ModuleList& string()  { return m_data->m_string; }
  void resetString()  { m_data = AbstractLStringInternalPtr(new AbstractLStringInternal()); }
+
+ /// update the memory accounting of the string storage (see Tracker).
+ void updateStringTracking() const { m_data->m_tracked.resize(m_data->trackedBytes()); }
  
 public:
 
@@ -141,6 +141,13 @@ AxialTree::~AxialTree()
 	DecTracker(AxialTree) 
 }
 
+void AxialTree::updateTracking() const
+{
+  updateStringTracking();
+  for(const_iterator _it = const_begin(); _it != const_end(); ++_it)
+	  _it->updateTracking();
+}
+
 std::string AxialTree::str_slice(const_iterator beg, const_iterator end) const{
   std::string str;
   for(ModuleList::const_iterator _it = beg; _it != end; _it++)
@@ -371,4 +378,123 @@ AxialTree::leftfind(const PatternString& a,
 }
 
 
+/*---------------------------------------------------------------------------*/
+
+static const char AXIALTREE_BINARY_MAGIC[4] = { 'L', 'P', 'Y', 'B' };
+static const uint32_t AXIALTREE_BINARY_VERSION = 1;
+
+template<class T>
+inline void write_binary(std::string& data, T value)
+{ data.append(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+template<class T>
+inline T read_binary(const std::string& data, size_t& pos)
+{
+	if (pos + sizeof(T) > data.size()) LsysError("Truncated binary AxialTree.");
+	T value;
+	memcpy(&value, data.data() + pos, sizeof(T));
+	pos += sizeof(T);
+	return value;
+}
+
+AxialTree 
+AxialTree::insertCuts(const std::vector<size_t>& positions) const{
+  std::vector<size_t> sortedpositions(positions);
+  std::sort(sortedpositions.begin(),sortedpositions.end());
+  AxialTree dest;
+  dest.reserve(size()+sortedpositions.size());
+  std::vector<size_t>::const_iterator itpos = sortedpositions.begin();
+  size_t i = 0;
+  for(const_iterator _it = const_begin(); _it != const_end(); ++_it, ++i){
+	bool cut = false;
+	while(itpos != sortedpositions.end() && *itpos == i) { cut = true; ++itpos; }
+	if(cut) dest.append(ParamModule(ModuleClass::Cut->getId()));
+	dest.push_back(_it);
+  }
+  return dest;
+}
+
+std::string AxialTree::toBinary() const
+{
+	std::string data(AXIALTREE_BINARY_MAGIC, 4);
+	write_binary<uint32_t>(data, AXIALTREE_BINARY_VERSION);
+
+	pgl_hash_map<size_t,uint32_t> classindex;
+	std::vector<ModuleClassPtr> classes;
+	for(const_iterator _it = const_begin(); _it != const_end(); ++_it){
+		if(classindex.find(_it->getClassId()) == classindex.end()){
+			classindex[_it->getClassId()] = classes.size();
+			classes.push_back(_it->getClass());
+		}
+	}
+	write_binary<uint32_t>(data, classes.size());
+	for(std::vector<ModuleClassPtr>::const_iterator _itc = classes.begin(); _itc != classes.end(); ++_itc){
+		const std::string& name = (*_itc)->name;
+		write_binary<uint32_t>(data, name.size());
+		data += name;
+	}
+
+	boost::python::list args;
+	write_binary<uint64_t>(data, size());
+	for(const_iterator _it = const_begin(); _it != const_end(); ++_it){
+		write_binary<uint32_t>(data, classindex[_it->getClassId()]);
+		write_binary<uint32_t>(data, _it->size());
+		for(size_t j = 0; j < _it->size(); ++j) args.append(_it->getAt(j));
+	}
+
+	boost::python::object pickled = boost::python::import("pickle").attr("dumps")(args, -1);
+	char * buffer; Py_ssize_t length;
+	if (PyBytes_AsStringAndSize(pickled.ptr(), &buffer, &length) == -1) boost::python::throw_error_already_set();
+	write_binary<uint64_t>(data, length);
+	data.append(buffer, length);
+	return data;
+}
+
+AxialTree AxialTree::fromBinary(const std::string& data)
+{
+	if (data.size() < 4 || data.compare(0, 4, AXIALTREE_BINARY_MAGIC, 4) != 0) LsysError("Invalid binary AxialTree.");
+	size_t pos = 4;
+	if (read_binary<uint32_t>(data, pos) != AXIALTREE_BINARY_VERSION) LsysError("Unsupported binary AxialTree version.");
+
+	uint32_t nbclasses = read_binary<uint32_t>(data, pos);
+	std::vector<ModuleClassPtr> classes;
+	for(uint32_t i = 0; i < nbclasses; ++i){
+		uint32_t length = read_binary<uint32_t>(data, pos);
+		if (length > data.size() - pos) LsysError("Truncated binary AxialTree.");
+		classes.push_back(ModuleClassTable::get().getClass(data.substr(pos, length)));
+		pos += length;
+	}
+
+	uint64_t nbmodules = read_binary<uint64_t>(data, pos);
+	// each module takes 8 bytes. checked before allocation to reject corrupted counts.
+	if (nbmodules > (data.size() - pos) / 8) LsysError("Truncated binary AxialTree.");
+	std::vector<std::pair<uint32_t,uint32_t> > modules;
+	modules.reserve(nbmodules);
+	for(uint64_t i = 0; i < nbmodules; ++i){
+		uint32_t classid = read_binary<uint32_t>(data, pos);
+		uint32_t nbargs = read_binary<uint32_t>(data, pos);
+		if (classid >= nbclasses) LsysError("Invalid binary AxialTree.");
+		modules.push_back(std::pair<uint32_t,uint32_t>(classid, nbargs));
+	}
+
+	uint64_t length = read_binary<uint64_t>(data, pos);
+	if (length > data.size() - pos) LsysError("Truncated binary AxialTree.");
+	boost::python::object pickled(boost::python::handle<>(PyBytes_FromStringAndSize(data.data() + pos, length)));
+	boost::python::list args = boost::python::extract<boost::python::list>(boost::python::import("pickle").attr("loads")(pickled))();
+
+	AxialTree result;
+	result.reserve(nbmodules);
+	size_t argpos = 0;
+	size_t nbargstotal = boost::python::len(args);
+	for(std::vector<std::pair<uint32_t,uint32_t> >::const_iterator _it = modules.begin(); _it != modules.end(); ++_it){
+		if (argpos + _it->second > nbargstotal) LsysError("Invalid binary AxialTree.");
+		ParamModule module(classes[_it->first]->getId());
+		for(uint32_t j = 0; j < _it->second; ++j, ++argpos) module.append(args[argpos]);
+		result.append(module);
+	}
+	return result;
+}
+
+/*---------------------------------------------------------------------------*/
+
 LPY_END_NAMESPACE
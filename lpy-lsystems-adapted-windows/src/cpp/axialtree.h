@@ -209,6 +209,18 @@ public:
 	AxialTree replace(const PatternModule&, const AxialTree&) const;
 	AxialTree replace(const PatternString&, const AxialTree&) const;
 
+	/** Return a copy with a cut module inserted before the modules at the given positions, so that 
+	    they are removed with the rest of their branch at the next derivation step. */
+	AxialTree insertCuts(const std::vector<size_t>& positions) const;
+
+	/** Binary representation: table of module names, class index and nb of 
+	    parameters of each module, then the parameters as a single pickle. */
+	std::string toBinary() const;
+	static AxialTree fromBinary(const std::string& data);
+
+	/// update the memory accounting of the string and of the arguments of its modules (see Tracker).
+	void updateTracking() const;
+
 };
 
 
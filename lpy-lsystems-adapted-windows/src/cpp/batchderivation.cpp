@@ -0,0 +1,310 @@
+/* ---------------------------------------------------------------------------
+ #
+ #       L-Py: L-systems in Python
+ #
+ #       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+ #
+ #       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+ #
+ # ---------------------------------------------------------------------------
+ #
+ #                      GNU General Public Licence
+ #
+ #       This program is free software; you can redistribute it and/or
+ #       modify it under the terms of the GNU General Public License as
+ #       published by the Free Software Foundation; either version 2 of
+ #       the License, or (at your option) any later version.
+ #
+ #       This program is distributed in the hope that it will be useful,
+ #       but WITHOUT ANY WARRANTY; without even the implied warranty of
+ #       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+ #       GNU General Public License for more details.
+ #
+ #       You should have received a copy of the GNU General Public
+ #       License along with this program; see the file COPYING. If not,
+ #       write to the Free Software Foundation, Inc., 59
+ #       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ #
+ # ---------------------------------------------------------------------------
+ */
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "batchderivation.h"
+#include "gilrelease.h"
+#include <sstream>
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#endif
+
+using namespace boost::python;
+LPY_USING_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/* Seed of the random stream of the context for a variant seed. Integers are used as is, 
+   other objects through a hash of their representation that is stable across processes. */
+static uint64_t contextSeed(const object& seed)
+{
+	if (PyLong_Check(seed.ptr())) {
+		uint64_t value = (uint64_t)PyLong_AsUnsignedLongLongMask(seed.ptr());
+		if (PyErr_Occurred()) throw_error_already_set();
+		return value;
+	}
+	std::string repr = extract<std::string>(str(seed))();
+	uint64_t value = 14695981039346656037ULL;
+	for(std::string::const_iterator it = repr.begin(); it != repr.end(); ++it)
+		value = (value ^ (unsigned char)*it) * 1099511628211ULL;
+	return value;
+}
+
+/* Derive a variant. Variants with parameters rebuild the lsystem from its source with them. 
+   rebuilt tells whether the lsystem is currently rebuilt for another variant, in which case 
+   a variant without parameters rebuilds it from its source first. The random seed is set back 
+   to seed after each variant. Return false in case of error, with result set to the error message. */
+static bool deriveVariant(Lsystem& lsystem, const DerivationVariant& variant, size_t nb_iter, std::string& result, bool& rebuilt, uint64_t seed)
+{
+	LsysContext * context = lsystem.context();
+	dict previous;
+	list added;
+	bool reparsed = false;
+	bool success = true;
+	try {
+		if (len(variant.parameters) > 0) {
+			// a failed rebuild leaves the lsystem partially built
+			bool wasrebuilt = rebuilt;
+			rebuilt = true;
+			reparsed = lsystem.rebuild(variant.parameters);
+			if (!reparsed) rebuilt = wasrebuilt;
+		}
+		else if (rebuilt) {
+			lsystem.rebuild(dict());
+			rebuilt = false;
+			reparsed = true;
+		}
+		// the rebuild resets the random seed of the context
+		if (reparsed) context->setRandomSeed(seed);
+		if (!reparsed) {
+			list keys = variant.parameters.keys();
+			for(size_t i = 0; i < (size_t)len(keys); ++i){
+				std::string key = extract<std::string>(keys[i])();
+				if (context->hasObject(key)) previous[key] = context->getObject(key);
+				else added.append(key);
+				context->setObject(key, variant.parameters[key]);
+			}
+		}
+		if (variant.seed != object()) {
+			// rules may draw from python random module or from lrandom and co.
+			import("random").attr("seed")(variant.seed);
+			context->setRandomSeed(contextSeed(variant.seed));
+		}
+		if (nb_iter == DerivationVariant::DerivationLength) nb_iter = lsystem.derivationLength();
+		result = lsystem.derive(lsystem.getAxiom(), 0, nb_iter).toBinary();
+	}
+	catch (error_already_set) {
+		PyObject * type, * value, * traceback;
+		PyErr_Fetch(&type, &value, &traceback);
+		object etype(handle<>(allow_null(type)));
+		object evalue(handle<>(allow_null(value)));
+		object etraceback(handle<>(allow_null(traceback)));
+		result = extract<std::string>(str(evalue != object() ? evalue : etype))();
+		success = false;
+	}
+	catch (std::exception& e) {
+		result = e.what();
+		success = false;
+	}
+	if (!reparsed) {
+		context->updateNamespace(previous);
+		for(size_t i = 0; i < (size_t)len(added); ++i) context->delObject(extract<std::string>(added[i])());
+	}
+	context->setRandomSeed(seed);
+	return success;
+}
+
+/* Rebuild the lsystem from its source if it was rebuilt for a variant and set back its random seed. */
+static void restoreLsystem(Lsystem& lsystem, bool rebuilt, uint64_t seed)
+{
+	if (rebuilt) lsystem.rebuild(dict());
+	lsystem.context()->setRandomSeed(seed);
+}
+
+static void raiseVariantError(size_t variant, const std::string& message)
+{
+	std::stringstream stream;
+	stream << "Derivation of variant " << variant << " failed : " << message;
+	LsysError(stream.str());
+}
+
+#ifndef _WIN32
+
+static bool writeAll(int fd, const char * data, size_t size)
+{
+	while (size > 0) {
+		ssize_t n = write(fd, data, size);
+		if (n < 0) { if (errno == EINTR) continue; return false; }
+		data += n; size -= n;
+	}
+	return true;
+}
+
+/* Message sent by a worker for each variant: index, status and payload. */
+struct VariantHeader {
+	uint64_t index;
+	uint64_t success;
+	uint64_t size;
+};
+
+/* Incremental reader of the messages of a worker. */
+struct WorkerChannel {
+	WorkerChannel() : pid(-1), fd(-1), open(false) {}
+	pid_t pid;
+	int fd;
+	bool open;
+	std::string buffer;
+};
+
+static void flushPythonStreams()
+{
+	try {
+		object sys = import("sys");
+		sys.attr("stdout").attr("flush")();
+		sys.attr("stderr").attr("flush")();
+	}
+	catch (error_already_set) { PyErr_Clear(); }
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+std::vector<std::string> LPY::deriveVariants(Lsystem& lsystem, 
+											 const DerivationVariantList& variants, 
+											 size_t nb_iter,
+											 size_t nbprocesses)
+{
+	std::vector<std::string> results(variants.size());
+	if (variants.empty()) return results;
+
+#ifdef _WIN32
+	bool rebuilt = false;
+	uint64_t seed = lsystem.context()->getRandomSeed();
+	for(size_t i = 0; i < variants.size(); ++i)
+		if (!deriveVariant(lsystem, variants[i], nb_iter, results[i], rebuilt, seed)) {
+			restoreLsystem(lsystem, rebuilt, seed);
+			raiseVariantError(i, results[i]);
+		}
+	restoreLsystem(lsystem, rebuilt, seed);
+	return results;
+#else
+	if (nbprocesses == 0) {
+		long nbcpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nbprocesses = (nbcpu > 0 ? nbcpu : 1);
+	}
+	if (nbprocesses > variants.size()) nbprocesses = variants.size();
+
+	flushPythonStreams();
+	std::vector<WorkerChannel> workers(nbprocesses);
+	std::string spawnerror;
+	for(size_t w = 0; w < nbprocesses; ++w){
+		int fds[2];
+		if (pipe(fds) != 0) { spawnerror = std::string("Cannot create pipe for derivation workers : ") + strerror(errno); break; }
+#if PY_VERSION_HEX >= 0x03070000
+		PyOS_BeforeFork();
+#endif
+		pid_t pid = fork();
+		int forkerrno = errno;
+		if (pid == 0) {
+#if PY_VERSION_HEX >= 0x03070000
+			PyOS_AfterFork_Child();
+#else
+			PyOS_AfterFork();
+#endif
+			close(fds[0]);
+			for(size_t prev = 0; prev < w; ++prev) if (workers[prev].open) close(workers[prev].fd);
+			bool ok = true;
+			// the worker exits after its last variant, so the lsystem is not restored.
+			bool rebuilt = false;
+			uint64_t seed = lsystem.context()->getRandomSeed();
+			for(size_t i = w; ok && i < variants.size(); i += nbprocesses){
+				std::string result;
+				VariantHeader header;
+				header.index = i;
+				header.success = deriveVariant(lsystem, variants[i], nb_iter, result, rebuilt, seed);
+				header.size = result.size();
+				ok = writeAll(fds[1], (const char *)&header, sizeof(header)) && writeAll(fds[1], result.data(), result.size());
+			}
+			flushPythonStreams();
+			close(fds[1]);
+			_exit(ok ? 0 : 1);
+		}
+#if PY_VERSION_HEX >= 0x03070000
+		PyOS_AfterFork_Parent();
+#endif
+		close(fds[1]);
+		if (pid < 0) { 
+			spawnerror = std::string("Cannot fork derivation worker : ") + strerror(forkerrno);
+			close(fds[0]); 
+			break; 
+		}
+		workers[w].pid = pid;
+		workers[w].fd = fds[0];
+		workers[w].open = true;
+	}
+
+	std::vector<bool> received(variants.size(), false);
+	std::vector<bool> failed(variants.size(), false);
+	{
+		GilFreeSection nogil;
+		std::vector<struct pollfd> pollfds;
+		std::vector<size_t> pollworkers;
+		char chunk[65536];
+		while (true) {
+			pollfds.clear(); pollworkers.clear();
+			for(size_t w = 0; w < workers.size(); ++w){
+				if (!workers[w].open) continue;
+				struct pollfd p; p.fd = workers[w].fd; p.events = POLLIN; p.revents = 0;
+				pollfds.push_back(p); pollworkers.push_back(w);
+			}
+			if (pollfds.empty()) break;
+			if (poll(&pollfds[0], pollfds.size(), -1) < 0) { if (errno == EINTR) continue; break; }
+			for(size_t p = 0; p < pollfds.size(); ++p){
+				if (pollfds[p].revents == 0) continue;
+				WorkerChannel& worker = workers[pollworkers[p]];
+				ssize_t n = read(worker.fd, chunk, sizeof(chunk));
+				if (n < 0 && errno == EINTR) continue;
+				if (n <= 0) { close(worker.fd); worker.open = false; continue; }
+				worker.buffer.append(chunk, n);
+				size_t pos = 0;
+				while (worker.buffer.size() - pos >= sizeof(VariantHeader)) {
+					VariantHeader header;
+					memcpy(&header, worker.buffer.data() + pos, sizeof(header));
+					if (worker.buffer.size() - pos - sizeof(header) < header.size) break;
+					std::string payload = worker.buffer.substr(pos + sizeof(header), header.size);
+					pos += sizeof(header) + header.size;
+					if (header.index >= variants.size()) continue;
+					received[header.index] = true;
+					failed[header.index] = !header.success;
+					results[header.index].swap(payload);
+				}
+				worker.buffer.erase(0, pos);
+			}
+		}
+		for(size_t w = 0; w < workers.size(); ++w)
+			if (workers[w].pid > 0) { int status; while (waitpid(workers[w].pid, &status, 0) < 0 && errno == EINTR); }
+	}
+
+	if (!spawnerror.empty()) LsysError(spawnerror);
+	for(size_t i = 0; i < variants.size(); ++i){
+		if (!received[i]) raiseVariantError(i, "worker process terminated unexpectedly.");
+		if (failed[i]) raiseVariantError(i, results[i]);
+	}
+	return results;
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,76 @@
+/* ---------------------------------------------------------------------------
+ #
+ #       L-Py: L-systems in Python
+ #
+ #       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+ #
+ #       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+ #
+ # ---------------------------------------------------------------------------
+ #
+ #                      GNU General Public Licence
+ #
+ #       This program is free software; you can redistribute it and/or
+ #       modify it under the terms of the GNU General Public License as
+ #       published by the Free Software Foundation; either version 2 of
+ #       the License, or (at your option) any later version.
+ #
+ #       This program is distributed in the hope that it will be useful,
+ #       but WITHOUT ANY WARRANTY; without even the implied warranty of
+ #       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+ #       GNU General Public License for more details.
+ #
+ #       You should have received a copy of the GNU General Public
+ #       License along with this program; see the file COPYING. If not,
+ #       write to the Free Software Foundation, Inc., 59
+ #       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ #
+ # ---------------------------------------------------------------------------
+ */
+
+
+#pragma once
+
+#include "lsystem.h"
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/** A variant of a derivation: a seed for the python random module and 
+    the random stream of the context (None to keep the current state) 
+	and parameters of the Lsystem. 
+	If the Lsystem was built from code, it is rebuilt with the parameters
+	so that the axiom, the derivation length and the rule probabilities 
+	see them. Otherwise the parameters are only set in its namespace. */
+struct LPY_API DerivationVariant {
+	/// Number of iterations meaning the derivation length of each variant.
+	static const size_t DerivationLength = (size_t)-1;
+
+	DerivationVariant(const boost::python::object& _seed = boost::python::object(), 
+					  const boost::python::dict& _parameters = boost::python::dict()) :
+		seed(_seed), parameters(_parameters) {}
+
+	boost::python::object seed;
+	boost::python::dict parameters;
+};
+
+typedef std::vector<DerivationVariant> DerivationVariantList;
+
+/** Derive all the variants of an already compiled Lsystem.
+	On posix systems, the variants are distributed over nbprocesses forked 
+	workers (the number of cpus if 0) and each result is sent back to the 
+	caller as a binary AxialTree (see AxialTree::toBinary). Elsewhere, the 
+	variants are derived one after the other in the calling process.
+	Changes made to the Lsystem by the rules in a worker are not seen by 
+	the caller. No other thread should use python during the fork. 
+	If nb_iter is DerivationVariant::DerivationLength, each variant is 
+	derived for its own derivation length. */
+LPY_API std::vector<std::string> deriveVariants(Lsystem& lsystem, 
+											   const DerivationVariantList& variants, 
+											   size_t nb_iter,
+											   size_t nbprocesses = 0);
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
@@ -0,0 +1,495 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#include "bvh.h"
+#include "error.h"
+#include "../plantgl/math/util_math.h"
+#include <algorithm>
+#include <math.h>
+
+LPY_USING_NAMESPACE
+
+typedef TOOLS(Vector3) Vector3;
+
+/*---------------------------------------------------------------------------*/
+
+static inline real_t clamp01(real_t v) { return v < 0 ? 0 : (v > 1 ? 1 : v); }
+
+/// Squared distance between point p and segment [a,b].
+static real_t sqdistance_point_segment(const Vector3& p, const Vector3& a, const Vector3& b)
+{
+	Vector3 ab = b - a;
+	real_t l = normSquared(ab);
+	real_t t = (l > 0 ? clamp01(dot(p - a, ab) / l) : 0);
+	return normSquared(p - (a + ab * t));
+}
+
+/// Squared distance between segments [p1,q1] and [p2,q2].
+static real_t sqdistance_segment_segment(const Vector3& p1, const Vector3& q1, const Vector3& p2, const Vector3& q2)
+{
+	Vector3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+	real_t a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+	real_t s, t;
+	if (a <= 0 && e <= 0) return normSquared(r);
+	if (a <= 0) { s = 0; t = clamp01(f / e); }
+	else {
+		real_t c = dot(d1, r);
+		if (e <= 0) { t = 0; s = clamp01(-c / a); }
+		else {
+			real_t b = dot(d1, d2), denom = a * e - b * b;
+			s = (denom > 0 ? clamp01((b * f - c * e) / denom) : 0);
+			t = (b * s + f) / e;
+			if (t < 0) { t = 0; s = clamp01(-c / a); }
+			else if (t > 1) { t = 1; s = clamp01((b - c) / a); }
+		}
+	}
+	return normSquared((p1 + d1 * s) - (p2 + d2 * t));
+}
+
+/// Tolerance of the intersection tests, relative to the size of the primitives.
+static const real_t RELATIVE_EPSILON = 1e-9;
+
+enum eLineCrossing { eNoCrossing, eCrossing, eEdgeCrossing, eInPlane };
+
+/** Intersection of the line origin + t * direction with a triangle, with t its parameter and 
+	(u,v) its barycentric coordinates. An edge crossing passes within tolerance of an edge. */
+static eLineCrossing cross_line_triangle(const Vector3& origin, const Vector3& direction, 
+										 const Vector3& a, const Vector3& b, const Vector3& c, real_t& t)
+{
+	Vector3 e1 = b - a, e2 = c - a;
+	Vector3 h = cross(direction, e2);
+	real_t det = dot(e1, h);
+	// det scales with the lengths of the direction and of the edges.
+	if (fabs(det) <= RELATIVE_EPSILON * norm(direction) * norm(e1) * norm(e2)) {
+		Vector3 n = cross(e1, e2);
+		real_t area = norm(n);
+		if (area > 0 && fabs(dot(origin - a, n)) <= RELATIVE_EPSILON * area * std::max(norm(e1), norm(e2))) return eInPlane;
+		return eNoCrossing;
+	}
+	real_t inv = 1 / det;
+	Vector3 s = origin - a;
+	real_t u = inv * dot(s, h);
+	if (u < -RELATIVE_EPSILON || u > 1 + RELATIVE_EPSILON) return eNoCrossing;
+	Vector3 q = cross(s, e1);
+	real_t v = inv * dot(direction, q);
+	if (v < -RELATIVE_EPSILON || u + v > 1 + RELATIVE_EPSILON) return eNoCrossing;
+	t = inv * dot(e2, q);
+	if (u <= RELATIVE_EPSILON || v <= RELATIVE_EPSILON || u + v >= 1 - RELATIVE_EPSILON) return eEdgeCrossing;
+	return eCrossing;
+}
+
+/// Parameter t of the intersection of the line origin + t * direction with a triangle, if any.
+static inline bool intersect_line_triangle(const Vector3& origin, const Vector3& direction, 
+										   const Vector3& a, const Vector3& b, const Vector3& c, real_t& t)
+{
+	eLineCrossing crossing = cross_line_triangle(origin, direction, a, b, c, t);
+	return crossing == eCrossing || crossing == eEdgeCrossing;
+}
+
+static inline bool intersect_segment_triangle(const Vector3& p, const Vector3& q, 
+											  const Vector3& a, const Vector3& b, const Vector3& c)
+{
+	real_t t;
+	return intersect_line_triangle(p, q - p, a, b, c, t) && t >= 0 && t <= 1;
+}
+
+/// Closest point of triangle abc to p.
+static Vector3 closest_point_triangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c)
+{
+	Vector3 ab = b - a, ac = c - a, ap = p - a;
+	real_t d1 = dot(ab, ap), d2 = dot(ac, ap);
+	if (d1 <= 0 && d2 <= 0) return a;
+	Vector3 bp = p - b;
+	real_t d3 = dot(ab, bp), d4 = dot(ac, bp);
+	if (d3 >= 0 && d4 <= d3) return b;
+	real_t vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+	Vector3 cp = p - c;
+	real_t d5 = dot(ab, cp), d6 = dot(ac, cp);
+	if (d6 >= 0 && d5 <= d6) return c;
+	real_t vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+	real_t va = d3 * d6 - d5 * d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	real_t denom = 1 / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+/// Test if segment [p,q] intersects the box, with the slab method.
+static bool intersect_segment_box(const Vector3& p, const Vector3& q, const Vector3& lower, const Vector3& upper)
+{
+	real_t tmin = 0, tmax = 1;
+	Vector3 d = q - p;
+	for (int i = 0; i < 3; ++i) {
+		if (fabs(d[i]) < 1e-12) {
+			if (p[i] < lower[i] || p[i] > upper[i]) return false;
+		}
+		else {
+			real_t t1 = (lower[i] - p[i]) / d[i], t2 = (upper[i] - p[i]) / d[i];
+			if (t1 > t2) std::swap(t1, t2);
+			tmin = std::max(tmin, t1);
+			tmax = std::min(tmax, t2);
+			if (tmin > tmax) return false;
+		}
+	}
+	return true;
+}
+
+/// Test if triangle abc intersects the box, with the separating axis theorem.
+static bool intersect_triangle_box(const Vector3& a, const Vector3& b, const Vector3& c, const Vector3& lower, const Vector3& upper)
+{
+	Vector3 center = (lower + upper) * 0.5, half = (upper - lower) * 0.5;
+	Vector3 v[3] = { a - center, b - center, c - center };
+	// axes of the box
+	for (int i = 0; i < 3; ++i) {
+		if (std::min(v[0][i], std::min(v[1][i], v[2][i])) > half[i]) return false;
+		if (std::max(v[0][i], std::max(v[1][i], v[2][i])) < -half[i]) return false;
+	}
+	// normal of the triangle
+	Vector3 n = cross(v[1] - v[0], v[2] - v[0]);
+	real_t r = half.x() * fabs(n.x()) + half.y() * fabs(n.y()) + half.z() * fabs(n.z());
+	if (fabs(dot(n, v[0])) > r) return false;
+	// cross products of the edges with the axes of the box. Degenerated axes do not separate.
+	for (int e = 0; e < 3; ++e) {
+		Vector3 edge = v[(e+1)%3] - v[e];
+		for (int i = 0; i < 3; ++i) {
+			Vector3 unit(0, 0, 0);
+			unit[i] = 1;
+			Vector3 axis = cross(unit, edge);
+			real_t p0 = dot(v[0], axis), p1 = dot(v[1], axis), p2 = dot(v[2], axis);
+			r = half.x() * fabs(axis.x()) + half.y() * fabs(axis.y()) + half.z() * fabs(axis.z());
+			if (std::min(p0, std::min(p1, p2)) > r || std::max(p0, std::max(p1, p2)) < -r) return false;
+		}
+	}
+	return true;
+}
+
+/// Solid angle of triangle abc seen from p, signed by the orientation of the triangle.
+static real_t solid_angle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c)
+{
+	Vector3 pa = a - p, pb = b - p, pc = c - p;
+	real_t la = norm(pa), lb = norm(pb), lc = norm(pc);
+	real_t numerator = dot(pa, cross(pb, pc));
+	real_t denominator = la * lb * lc + dot(pa, pb) * lc + dot(pa, pc) * lb + dot(pb, pc) * la;
+	return 2 * atan2(numerator, denominator);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void BVH::Box::set(const Primitive& p)
+{
+	size_t nbpoints = (p.type == eSegment ? 2 : 3);
+	lower = upper = p.points[0];
+	for (size_t i = 1; i < nbpoints; ++i)
+		for (int a = 0; a < 3; ++a) {
+			lower[a] = std::min(lower[a], p.points[i][a]);
+			upper[a] = std::max(upper[a], p.points[i][a]);
+		}
+	if (p.type == eSegment) {
+		Vector3 r(p.radius, p.radius, p.radius);
+		lower -= r; upper += r;
+	}
+}
+
+void BVH::Box::merge(const Box& other)
+{
+	for (int a = 0; a < 3; ++a) {
+		lower[a] = std::min(lower[a], other.lower[a]);
+		upper[a] = std::max(upper[a], other.upper[a]);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+
+BVH::BVH(): m_rebuild(false), m_refit(false) {}
+
+void BVH::clear()
+{
+	m_primitives.clear();
+	m_boxes.clear();
+	m_order.clear();
+	m_nodes.clear();
+	m_rebuild = m_refit = false;
+}
+
+size_t BVH::addSegment(const Vector3& start, const Vector3& end, real_t radius, long id)
+{
+	Primitive p;
+	p.type = eSegment;
+	p.points[0] = start; p.points[1] = end; p.points[2] = end;
+	p.radius = radius;
+	p.id = id;
+	m_primitives.push_back(p);
+	m_rebuild = true;
+	return m_primitives.size() - 1;
+}
+
+size_t BVH::addTriangle(const Vector3& a, const Vector3& b, const Vector3& c, long id)
+{
+	Primitive p;
+	p.type = eTriangle;
+	p.points[0] = a; p.points[1] = b; p.points[2] = c;
+	p.radius = 0;
+	p.id = id;
+	m_primitives.push_back(p);
+	m_rebuild = true;
+	return m_primitives.size() - 1;
+}
+
+void BVH::setSegment(size_t index, const Vector3& start, const Vector3& end, real_t radius)
+{
+	if (index >= m_primitives.size() || m_primitives[index].type != eSegment) 
+		LsysError("BVH: invalid segment index.");
+	Primitive& p = m_primitives[index];
+	p.points[0] = start; p.points[1] = end; p.points[2] = end;
+	p.radius = radius;
+	m_refit = true;
+}
+
+void BVH::update() const
+{
+	// the hierarchy is a cache of the primitives and is updated lazily by the queries.
+	BVH * self = const_cast<BVH *>(this);
+	if (m_rebuild) {
+		self->m_boxes.resize(m_primitives.size());
+		for (size_t i = 0; i < m_primitives.size(); ++i) self->m_boxes[i].set(m_primitives[i]);
+		self->m_order.resize(m_primitives.size());
+		for (size_t i = 0; i < m_order.size(); ++i) self->m_order[i] = i;
+		self->m_nodes.clear();
+		if (!m_primitives.empty()) self->build(0, m_primitives.size());
+		self->m_rebuild = self->m_refit = false;
+	}
+	else if (m_refit) {
+		self->refit();
+		self->m_refit = false;
+	}
+}
+
+size_t BVH::build(size_t begin, size_t end)
+{
+	size_t id = m_nodes.size();
+	m_nodes.push_back(Node());
+	Node node;
+	node.begin = begin; node.end = end;
+	node.left = node.right = 0;
+	node.box = m_boxes[m_order[begin]];
+	for (size_t i = begin+1; i < end; ++i) node.box.merge(m_boxes[m_order[i]]);
+	if (end - begin > LeafSize) {
+		// median split of the box centers along the largest extent
+		Vector3 extent = node.box.upper - node.box.lower;
+		int axis = (extent.x() >= extent.y() ? (extent.x() >= extent.z() ? 0 : 2) : (extent.y() >= extent.z() ? 1 : 2));
+		size_t mid = (begin + end) / 2;
+		const std::vector<Box>& boxes = m_boxes;
+		std::nth_element(m_order.begin()+begin, m_order.begin()+mid, m_order.begin()+end,
+						 [&boxes, axis](size_t a, size_t b) 
+						 { return boxes[a].lower[axis] + boxes[a].upper[axis] < boxes[b].lower[axis] + boxes[b].upper[axis]; });
+		node.left = build(begin, mid);
+		node.right = build(mid, end);
+	}
+	m_nodes[id] = node;
+	return id;
+}
+
+void BVH::refit()
+{
+	for (size_t i = 0; i < m_primitives.size(); ++i) m_boxes[i].set(m_primitives[i]);
+	// children are always stored after their parent.
+	for (std::vector<Node>::reverse_iterator it = m_nodes.rbegin(); it != m_nodes.rend(); ++it) {
+		if (it->left == 0) {
+			it->box = m_boxes[m_order[it->begin]];
+			for (size_t i = it->begin+1; i < it->end; ++i) it->box.merge(m_boxes[m_order[i]]);
+		}
+		else {
+			it->box = m_nodes[it->left].box;
+			it->box.merge(m_nodes[it->right].box);
+		}
+	}
+}
+
+template<class BoxTest, class PrimitiveTest>
+void BVH::query(const BoxTest& boxtest, const PrimitiveTest& primitivetest, IdList& result) const
+{
+	update();
+	if (m_nodes.empty()) return;
+	std::vector<size_t> stack(1, 0);
+	while (!stack.empty()) {
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+		if (!boxtest(node.box)) continue;
+		if (node.left == 0) {
+			for (size_t i = node.begin; i < node.end; ++i) {
+				const Primitive& p = m_primitives[m_order[i]];
+				if (boxtest(m_boxes[m_order[i]]) && primitivetest(p)) result.push_back(p.id);
+			}
+		}
+		else {
+			stack.push_back(node.right);
+			stack.push_back(node.left);
+		}
+	}
+}
+
+static inline void unique_ids(BVH::IdList& ids)
+{
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+BVH::IdList BVH::intersectBox(const Vector3& lower, const Vector3& upper) const
+{
+	Box box = { lower, upper };
+	IdList result;
+	query([&box](const Box& b) { return box.overlaps(b); },
+		  [&box](const Primitive& p) {
+			  if (p.type == eSegment) {
+				  Vector3 r(p.radius, p.radius, p.radius);
+				  return intersect_segment_box(p.points[0], p.points[1], box.lower - r, box.upper + r);
+			  }
+			  return intersect_triangle_box(p.points[0], p.points[1], p.points[2], box.lower, box.upper);
+		  }, result);
+	unique_ids(result);
+	return result;
+}
+
+BVH::IdList BVH::intersectSphere(const Vector3& center, real_t radius) const
+{
+	Vector3 r(radius, radius, radius);
+	Box box = { center - r, center + r };
+	IdList result;
+	query([&box](const Box& b) { return box.overlaps(b); },
+		  [&center, radius](const Primitive& p) {
+			  if (p.type == eSegment) {
+				  real_t d = radius + p.radius;
+				  return sqdistance_point_segment(center, p.points[0], p.points[1]) <= d * d;
+			  }
+			  return normSquared(closest_point_triangle(center, p.points[0], p.points[1], p.points[2]) - center) <= radius * radius;
+		  }, result);
+	unique_ids(result);
+	return result;
+}
+
+bool BVH::intersects(const Primitive& a, const Primitive& b) const
+{
+	if (a.type == eSegment && b.type == eSegment) {
+		real_t d = a.radius + b.radius;
+		return sqdistance_segment_segment(a.points[0], a.points[1], b.points[0], b.points[1]) <= d * d;
+	}
+	if (a.type == eSegment) return intersect_segment_triangle(a.points[0], a.points[1], b.points[0], b.points[1], b.points[2]);
+	if (b.type == eSegment) return intersect_segment_triangle(b.points[0], b.points[1], a.points[0], a.points[1], a.points[2]);
+	// two triangles intersect if an edge of one crosses the other
+	for (int i = 0; i < 3; ++i) {
+		if (intersect_segment_triangle(a.points[i], a.points[(i+1)%3], b.points[0], b.points[1], b.points[2])) return true;
+		if (intersect_segment_triangle(b.points[i], b.points[(i+1)%3], a.points[0], a.points[1], a.points[2])) return true;
+	}
+	return false;
+}
+
+BVH::IdList BVH::intersect(const BVH& other) const
+{
+	update();
+	IdList result;
+	for (size_t i = 0; i < m_primitives.size(); ++i) {
+		const Primitive& p = m_primitives[i];
+		const Box& box = m_boxes[i];
+		IdList hits;
+		other.query([&box](const Box& b) { return box.overlaps(b); },
+					[this, &p](const Primitive& o) { return intersects(p, o); }, hits);
+		if (!hits.empty()) result.push_back(p.id);
+	}
+	unique_ids(result);
+	return result;
+}
+
+size_t BVH::crossings(const Vector3& origin, bool& ambiguous) const
+{
+	// directions not aligned with the axes. A ray passing near an edge or a vertex, that could be counted 
+	// once per adjacent triangle or not at all, is cast again in the next direction.
+	static const Vector3 directions[] = { Vector3(1, 0.000123456, 0.000234567), 
+										  Vector3(0.000345678, 1, 0.000456789), 
+										  Vector3(0.000567891, 0.000678912, 1),
+										  Vector3(-0.577350269, 0.577451837, 0.577248694) };
+	static const size_t nbdirections = sizeof(directions) / sizeof(Vector3);
+	// the rays are clipped out of the root box.
+	const Box& root = m_nodes[0].box;
+	real_t length = norm(root.upper - root.lower) + norm(origin - root.lower) + 1;
+	size_t count = 0;
+	for (size_t i = 0; i < nbdirections; ++i) {
+		const Vector3& direction = directions[i];
+		Vector3 end = origin + direction * (length / norm(direction));
+		ambiguous = false;
+		count = 0;
+		IdList hits;
+		query([&origin, &end](const Box& b) { return intersect_segment_box(origin, end, b.lower, b.upper); },
+			  [&origin, &direction, &count, &ambiguous](const Primitive& p) {
+				  real_t t = 0;
+				  if (p.type == eTriangle) {
+					  eLineCrossing crossing = cross_line_triangle(origin, direction, p.points[0], p.points[1], p.points[2], t);
+					  if (crossing == eInPlane || (crossing == eEdgeCrossing && t >= 0)) ambiguous = true;
+					  else if (crossing == eCrossing && t > 0) ++count;
+				  }
+				  return false;
+			  }, hits);
+		if (!ambiguous) break;
+	}
+	return count;
+}
+
+bool BVH::isInside(const Vector3& point) const
+{
+	update();
+	if (m_nodes.empty()) return false;
+	bool ambiguous = false;
+	size_t count = crossings(point, ambiguous);
+	if (!ambiguous) return count % 2 == 1;
+	// every ray passes near an edge or lies in the plane of a triangle, which happens for points 
+	// on or very close to the mesh: the winding number of the mesh around the point decides.
+	return fabs(windingNumber(point)) >= 0.5;
+}
+
+real_t BVH::windingNumber(const Vector3& point) const
+{
+	real_t angle = 0;
+	for (std::vector<Primitive>::const_iterator it = m_primitives.begin(); it != m_primitives.end(); ++it)
+		if (it->type == eTriangle) angle += solid_angle(point, it->points[0], it->points[1], it->points[2]);
+	return angle / (4 * GEOM_PI);
+}
+
+BVH::IdList BVH::outside(const BVH& other) const
+{
+	other.update();
+	IdList result;
+	for (std::vector<Primitive>::const_iterator it = m_primitives.begin(); it != m_primitives.end(); ++it)
+		if (it->type == eSegment && (!other.isInside(it->points[0]) || !other.isInside(it->points[1])))
+			result.push_back(it->id);
+	unique_ids(result);
+	return result;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,135 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "lpy_config.h"
+#include "../plantgl/math/util_vector.h"
+#include "../plantgl/tool/rcobject.h"
+#include <vector>
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/** 
+	Bounding volume hierarchy over segments with a radius, such as the interpreted 
+	internodes of a plant, and triangles, such as obstacle meshes. Each primitive 
+	has an id, for instance the position of its module in the lstring. 
+	Adding primitives marks the hierarchy for a rebuild while updating existing 
+	ones only refits the bounding boxes, which is done lazily at the next query.
+*/
+class LPY_API BVH : public TOOLS(RefCountObject) {
+public:
+	typedef TOOLS(Vector3) Vector3;
+	typedef std::vector<long> IdList;
+
+	BVH();
+
+	void clear();
+	inline size_t size() const { return m_primitives.size(); }
+
+	/// Add a primitive and return its index.
+	size_t addSegment(const Vector3& start, const Vector3& end, real_t radius, long id = -1);
+	size_t addTriangle(const Vector3& a, const Vector3& b, const Vector3& c, long id = -1);
+
+	/// Update the geometry of the segment of given index.
+	void setSegment(size_t index, const Vector3& start, const Vector3& end, real_t radius);
+
+	/** Ids of the primitives intersecting a box. Segments are tested against the box expanded by their radius 
+		and triangles with the separating axis theorem. */
+	IdList intersectBox(const Vector3& lower, const Vector3& upper) const;
+	/// Ids of the primitives intersecting a sphere.
+	IdList intersectSphere(const Vector3& center, real_t radius) const;
+	/// Ids of the primitives intersecting the primitives of other. The radius of segments is ignored against triangles.
+	IdList intersect(const BVH& other) const;
+
+	/** Test if point is inside the closed triangle mesh of the hierarchy, by the parity of the crossings of a ray. 
+		If the rays of all the tried directions pass near an edge, the winding number of the mesh is used. 
+		Points on the mesh may be found either inside or outside. */
+	bool isInside(const Vector3& point) const;
+	/// Ids of the segments with an end outside of the closed triangle mesh of other.
+	IdList outside(const BVH& other) const;
+
+protected:
+	enum ePrimitiveType { eSegment, eTriangle };
+
+	struct Primitive {
+		ePrimitiveType type;
+		Vector3 points[3];
+		real_t radius;
+		long id;
+	};
+
+	struct Box {
+		Vector3 lower, upper;
+		void set(const Primitive& p);
+		void merge(const Box& other);
+		inline bool overlaps(const Box& other) const {
+			return lower.x() <= other.upper.x() && other.lower.x() <= upper.x() &&
+				   lower.y() <= other.upper.y() && other.lower.y() <= upper.y() &&
+				   lower.z() <= other.upper.z() && other.lower.z() <= upper.z();
+		}
+	};
+
+	struct Node {
+		Box box;
+		size_t begin, end;  // range of m_order
+		size_t left, right; // children, 0 for a leaf
+	};
+
+	void update() const;
+	size_t build(size_t begin, size_t end);
+	void refit();
+
+	template<class BoxTest, class PrimitiveTest>
+	void query(const BoxTest& boxtest, const PrimitiveTest& primitivetest, IdList& result) const;
+
+	bool intersects(const Primitive& a, const Primitive& b) const;
+	/// Number of triangles crossed by a ray from origin. ambiguous is set if all the tried rays pass near an edge.
+	size_t crossings(const Vector3& origin, bool& ambiguous) const;
+	/// Sum of the solid angles of the triangles seen from point divided by 4 pi. About 1 inside a closed mesh, 0 outside.
+	real_t windingNumber(const Vector3& point) const;
+
+	std::vector<Primitive> m_primitives;
+	std::vector<Box> m_boxes;
+	std::vector<size_t> m_order;
+	std::vector<Node> m_nodes;
+	bool m_rebuild;
+	bool m_refit;
+
+	static const size_t LeafSize = 4;
+};
+
+typedef TOOLS(RefCountPtr)<BVH> BVHPtr;
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
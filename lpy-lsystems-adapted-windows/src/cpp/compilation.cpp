@@ -31,9 +31,27 @@
 #define BOOST_PYTHON_STATIC_LIB
 #include "compilation.h"
 #include "error.h"
+#include "gilrelease.h"
 #include <boost/python.hpp>
 #include "../plantgl/tool/util_string.h"
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QStringList>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QRegularExpression>
+#include <marshal.h>
 #include <fstream>
+#include <set>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <signal.h>
+#include <errno.h>
+#endif
 
 #define bp boost::python
 
@@ -41,17 +59,28 @@ LPY_USING_NAMESPACE
 
 /*---------------------------------------------------------------------------*/
 
+// Compilation options of the context current on this thread.
+static thread_local Compilation::eCompiler Compiler = Compilation::eDefaultCompiler;
+static thread_local const char * TmpExtension = "py";
+static thread_local Compilation::eCacheMode CacheMode = Compilation::eMemoryCache;
+
 void Compilation::setCompiler(eCompiler compiler) {
 	if (!cythonAvailable && compiler == eCython) Compiler = eDefaultCompiler;
 	else Compiler = compiler;
 	if(compiler == eCython){
-		tmp_extension = "pyx";
+		TmpExtension = "pyx";
 	}
 	else {
-		tmp_extension = "py";
+		TmpExtension = "py";
 	}
 }
 
+Compilation::eCompiler Compilation::getCompiler() { return Compiler; }
+
+void Compilation::setCacheMode(eCacheMode mode) { CacheMode = mode; }
+
+Compilation::eCacheMode Compilation::getCacheMode() { return CacheMode; }
+
 void Compilation::setPythonExec(const std::string& path)
 {
 	python_exec = path;
@@ -70,18 +99,134 @@ void Compilation::compile(const std::string& code, PyObject * globals, PyObject
 }
 
 
-Compilation::eCompiler Compilation::Compiler = Compilation::eDefaultCompiler;
 bool Compilation::cythonAvailable = true;
 
-std::string Compilation::tmp_extension = "py";
 std::string Compilation::python_exec = "python";
 
 void Compilation::py_string_compile(const std::string& code, PyObject * globals, PyObject * locals)
 {
-	bp::exec(bp::str(code.c_str()),bp::object(bp::handle<>(bp::borrowed(globals))),bp::object(bp::handle<>(bp::borrowed(locals))));
+	if (CacheMode != eNoCache) {
+		bp::object codeobject(bp::handle<>(cached_code_object(code)));
+#if PY_VERSION_HEX >= 0x03020000
+		bp::handle<>(PyEval_EvalCode(codeobject.ptr(),globals,locals));
+#else
+		bp::handle<>(PyEval_EvalCode((PyCodeObject *)codeobject.ptr(),globals,locals));
+#endif
+	}
+	else bp::exec(bp::str(code.c_str()),bp::object(bp::handle<>(bp::borrowed(globals))),bp::object(bp::handle<>(bp::borrowed(locals))));
 	// bp::handle<>( PyRun_String(code.c_str(),Py_file_input,globals,locals) );
 }
 
+/*---------------------------------------------------------------------------*/
+
+bool Compilation::cacheDirectoryInitialized = false;
+std::string Compilation::cacheDirectory;
+
+// code objects by hash. Never released since it may outlive the python interpreter.
+static PyObject * CODE_CACHE = NULL;
+static const size_t CODE_CACHE_MAX_SIZE = 512;
+// code objects stored on disk. The directory is trimmed at the first store of the process and then periodically.
+static const size_t CODE_CACHE_MAX_FILES = 1024;
+static const size_t CODE_CACHE_TRIM_PERIOD = 128;
+static size_t CODE_CACHE_STORES = 0;
+
+std::string Compilation::hash(const std::string& text)
+{
+	bp::object data(bp::handle<>(PyBytes_FromStringAndSize(text.data(),text.size())));
+	return bp::extract<std::string>(bp::import("hashlib").attr("sha1")(data).attr("hexdigest")())();
+}
+
+void Compilation::trimCacheDirectory(const std::string& directory, const std::string& pattern, size_t maxentries)
+{
+	QFileInfoList entries = QDir(QString(directory.c_str())).entryInfoList(QStringList(QString(pattern.c_str())), 
+																		   QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDir::Time);
+	for (int i = (int)maxentries; i < entries.size(); ++i) {
+		if (entries[i].isDir()) QDir(entries[i].filePath()).removeRecursively();
+		else QFile::remove(entries[i].filePath());
+	}
+}
+
+void Compilation::setCacheDirectory(const std::string& path)
+{
+	cacheDirectory = path;
+	cacheDirectoryInitialized = true;
+}
+
+std::string Compilation::getCacheDirectory()
+{
+	if (!cacheDirectoryInitialized) {
+		cacheDirectoryInitialized = true;
+		const char * dir = getenv("LPY_CACHE_DIR");
+		if (dir != NULL) cacheDirectory = dir;
+		else {
+#ifdef _WIN32
+			const char * base = getenv("LOCALAPPDATA");
+			if (base != NULL) cacheDirectory = std::string(base) + "/lpy/cache";
+#else
+			const char * base = getenv("XDG_CACHE_HOME");
+			if (base != NULL) cacheDirectory = std::string(base) + "/lpy";
+			else if ((base = getenv("HOME")) != NULL) cacheDirectory = std::string(base) + "/.cache/lpy";
+#endif
+		}
+	}
+	return cacheDirectory;
+}
+
+void Compilation::clearMemoryCache()
+{
+	if (CODE_CACHE) PyDict_Clear(CODE_CACHE);
+}
+
+PyObject * Compilation::cached_code_object(const std::string& code)
+{
+	if (CODE_CACHE == NULL) CODE_CACHE = PyDict_New();
+
+	std::stringstream keystream;
+	// the optimization level changes the compiled code (asserts, docstrings).
+	int optimize = bp::extract<int>(bp::import("sys").attr("flags").attr("optimize"))();
+	keystream << "code:" << PY_VERSION_HEX << ':' << optimize << ':' << code;
+	std::string key = hash(keystream.str());
+	bp::object pykey(key);
+
+	PyObject * codeobject = PyDict_GetItem(CODE_CACHE, pykey.ptr());
+	if (codeobject) { Py_INCREF(codeobject); return codeobject; }
+
+	std::string directory = (CacheMode == eDiskCache ? getCacheDirectory() : std::string());
+	std::string filename = directory.empty() ? "" : directory + "/" + key + ".lpyc";
+	if (!filename.empty()) {
+		std::ifstream stream(filename.c_str(), std::ios::in | std::ios::binary);
+		if (stream) {
+			std::string data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+			codeobject = PyMarshal_ReadObjectFromString(const_cast<char *>(data.data()), data.size());
+			if (codeobject && !PyCode_Check(codeobject)) { Py_DECREF(codeobject); codeobject = NULL; }
+			if (!codeobject) PyErr_Clear();
+		}
+	}
+
+	if (!codeobject) {
+		codeobject = Py_CompileString(code.c_str(), "<string>", Py_file_input);
+		if (!codeobject) bp::throw_error_already_set();
+		if (!filename.empty() && QDir().mkpath(QString(directory.c_str()))) {
+			PyObject * data = PyMarshal_WriteObjectToString(codeobject, Py_MARSHAL_VERSION);
+			if (data) {
+				std::string tmpfilename = filename + "." + TOOLS(number)(size_t(QCoreApplication::applicationPid())) + ".tmp";
+				{
+					std::ofstream stream(tmpfilename.c_str(), std::ios::out | std::ios::binary);
+					stream.write(PyBytes_AS_STRING(data), PyBytes_GET_SIZE(data));
+				}
+				if (std::rename(tmpfilename.c_str(), filename.c_str()) != 0) std::remove(tmpfilename.c_str());
+				else if (CODE_CACHE_STORES++ % CODE_CACHE_TRIM_PERIOD == 0) trimCacheDirectory(directory, "*.lpyc", CODE_CACHE_MAX_FILES);
+				Py_DECREF(data);
+			}
+			else PyErr_Clear();
+		}
+	}
+
+	if (PyDict_Size(CODE_CACHE) >= (Py_ssize_t)CODE_CACHE_MAX_SIZE) PyDict_Clear(CODE_CACHE);
+	PyDict_SetItem(CODE_CACHE, pykey.ptr(), codeobject);
+	return codeobject;
+}
+
 std::string Compilation::generate_fname(const std::string& fname)
 {
 	static size_t tmpid = 0;
@@ -103,26 +248,156 @@ void Compilation::py_file_remove(const std::string& fname)
 	remove(fname.c_str());
 }
 
-void Compilation::py_file_import(const std::string& fname, 
+void Compilation::py_file_import(const std::string& modulename, 
+								 const std::string& filename, 
 								 PyObject * globals,
 							     PyObject * locals)
 {
-	bp::object module = bp::import(fname.c_str());
+	// the module is not shared through sys.modules, so each lsystem gets its own globals.
+	bp::object util = bp::import("importlib.util");
+	bp::object spec = util.attr("spec_from_file_location")(modulename, filename);
+	if (spec == bp::object()) LsysError("Cannot load module '"+filename+"'");
+	bp::object module = util.attr("module_from_spec")(spec);
+	spec.attr("loader").attr("exec_module")(module);
 	bp::handle<> moduledict(bp::borrowed(PyModule_GetDict(module.ptr())));
 	if(!moduledict)LsysError("Cannot import module dict");
 	PyDict_Update(locals,moduledict.get());	
 }
 
+// names of the native modules already loaded from the cython directory.
+static std::set<std::string> LOADED_NATIVE_MODULES;
+
+/* Check whether the process pid is still running. */
+static bool isProcessRunning(qint64 pid)
+{
+#ifdef _WIN32
+	HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(pid));
+	if (process == NULL) return GetLastError() == ERROR_ACCESS_DENIED;
+	DWORD status = 0;
+	bool running = GetExitCodeProcess(process, &status) && status == STILL_ACTIVE;
+	CloseHandle(process);
+	return running;
+#else
+	return kill(pid_t(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+/* Remove the module copies and the build directories left in directory by processes 
+   that ended before removing them. Their names contain the pid of their process. */
+static void removeStaleNativeFiles(const std::string& directory)
+{
+	static const QRegularExpression owned("^(?:lpy_[0-9a-f]+\\.|build_)(\\d+)_");
+	qint64 self = QCoreApplication::applicationPid();
+	QFileInfoList entries = QDir(QString(directory.c_str())).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+	for (QFileInfoList::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+		QRegularExpressionMatch match = owned.match(it->fileName());
+		if (!match.hasMatch()) continue;
+		qint64 pid = match.captured(1).toLongLong();
+		if (pid == self || isProcessRunning(pid)) continue;
+		if (it->isDir()) QDir(it->filePath()).removeRecursively();
+		else QFile::remove(it->filePath());
+	}
+}
+
+std::string Compilation::cython_directory()
+{
+	static bool cleaned = false;
+	std::string directory = getCacheDirectory();
+	if (directory.empty()) return ".";
+	directory += "/cython";
+	QDir().mkpath(QString(directory.c_str()));
+	if (!cleaned) {
+		cleaned = true;
+		removeStaleNativeFiles(directory);
+	}
+	return directory;
+}
+
+std::string Compilation::cython_module_file(const std::string& directory, const std::string& modulename)
+{
+	bp::list suffixes(bp::import("importlib.machinery").attr("EXTENSION_SUFFIXES"));
+	for (size_t i = 0; i < (size_t)bp::len(suffixes); ++i) {
+		std::string filename = directory + "/" + modulename + bp::extract<std::string>(suffixes[i])();
+		if (std::ifstream(filename.c_str())) return filename;
+	}
+	return std::string();
+}
+
 void Compilation::pyx_file_compile(const std::string& code,
 								  const std::string& fname, 
 								  PyObject * globals,
 							      PyObject * locals)
 {
-	std::string lfname = generate_fname(fname);
-	std::string clfname = lfname+"."+tmp_extension;
-	py_file_write(code,clfname);
-	py_file_import(lfname,globals,locals);
-	py_file_remove(clfname);
+	// the native module is addressed by the hash of its code so that it can be reused by later loadings.
+	std::stringstream keystream;
+	keystream << "cython:" << PY_VERSION_HEX << ':' << code;
+	std::string modulename = "lpy_" + hash(keystream.str());
+	std::string directory = cython_directory();
+
+	std::string modulefile = cython_module_file(directory, modulename);
+	if (!modulefile.empty() && CacheMode == eNoCache && LOADED_NATIVE_MODULES.find(modulename) == LOADED_NATIVE_MODULES.end()) {
+		py_file_remove(modulefile);
+		modulefile.clear();
+	}
+	if (modulefile.empty()) {
+		// the module is built in a directory of this process and then renamed in the cache directory,
+		// so that processes building the same module do not share their intermediate files.
+		std::string pid = TOOLS(number)(size_t(QCoreApplication::applicationPid()));
+		QTemporaryDir builddir(QString((directory + "/build_" + pid + "_XXXXXX").c_str()));
+		if (builddir.isValid()) {
+			std::string buildpath = builddir.path().toStdString();
+			py_file_write(code,buildpath + "/" + modulename + ".pyx");
+#ifdef _WIN32
+			std::string cmd = "cd /d \""+buildpath+"\" && ";
+#else
+			std::string cmd = "cd \""+buildpath+"\" && ";
+#endif
+			cmd += "\""+python_exec+"\" -m Cython.Build.Cythonize -i -q -3 "+modulename+".pyx";
+			int status = 0;
+			{
+				GilFreeSection nogil;
+				status = system(cmd.c_str());
+			}
+			std::string builtfile = cython_module_file(buildpath, modulename);
+			// On windows, the rename fails if another process published the module first. Its module is used.
+			if (status == 0 && !builtfile.empty()) 
+				std::rename(builtfile.c_str(), (directory + builtfile.substr(buildpath.size())).c_str());
+		}
+		modulefile = cython_module_file(directory, modulename);
+		if (modulefile.empty()) {
+			LsysWarning("Cannot build native module with Cython. Python compiler is used instead.");
+			py_string_compile(code, globals, locals);
+			return;
+		}
+	}
+
+	if (LOADED_NATIVE_MODULES.insert(modulename).second) {
+		py_file_import(modulename,modulefile,globals,locals);
+		return;
+	}
+	// a native module file is initialized only once per process. A copy is loaded to get a new module.
+	static size_t instanceid = 0;
+	std::string instancefile = modulefile.substr(0, directory.size() + 1 + modulename.size()) + "." + 
+							   TOOLS(number)(size_t(QCoreApplication::applicationPid())) + "_" + TOOLS(number)(++instanceid) + 
+							   modulefile.substr(directory.size() + 1 + modulename.size());
+	{
+		std::ifstream source(modulefile.c_str(), std::ios::in | std::ios::binary);
+		std::ofstream target(instancefile.c_str(), std::ios::out | std::ios::binary);
+		target << source.rdbuf();
+		if (!target) {
+			py_file_remove(instancefile);
+			LsysError("Cannot copy native module '"+modulefile+"'");
+		}
+	}
+	try {
+		py_file_import(modulename,instancefile,globals,locals);
+	}
+	catch (...) {
+		py_file_remove(instancefile);
+		throw;
+	}
+	// the file is no longer needed once loaded. This fails silently where loaded libraries are locked.
+	py_file_remove(instancefile);
 }
 
 void Compilation::py_file_compile(const std::string& code,
@@ -131,11 +406,11 @@ void Compilation::py_file_compile(const std::string& code,
 							      PyObject * locals)
 {
 	std::string lfname = generate_fname(fname);
-	std::string clfname = lfname+"."+tmp_extension;
+	std::string clfname = lfname+"."+TmpExtension;
 	py_file_write(code,clfname);
 	std::string cmd = python_exec+" -OO "+lfname+".py";
 	system(cmd.c_str());
-	py_file_import(lfname,globals,locals);
+	py_file_import(lfname,clfname,globals,locals);
 	py_file_remove(clfname);
 }
 /*---------------------------------------------------------------------------*/
@@ -47,8 +47,15 @@ public:
 		eDefaultCompiler = ePythonStr
 	};
 
+	enum eCacheMode {
+		eNoCache,
+		eMemoryCache,
+		eDiskCache
+	};
+
+	/// The compiler and the cache activation are options of the current context and are set per thread.
 	static void setCompiler(eCompiler);
-	static inline eCompiler getCompiler() { return Compiler; }
+	static eCompiler getCompiler();
 
 	static void setPythonExec(const std::string& path);
 	static inline void setCythonAvailable(bool available) { cythonAvailable = available; }
@@ -56,11 +63,35 @@ public:
 
 	static void compile(const std::string& code, PyObject * globals, PyObject * locals, const std::string& fname ="");
 
+	/** Cache of translated L-Py sources (see Lsystem::set) and of compiled python code objects. 
+	    Both are kept in memory. With eDiskCache, code objects are also marshalled in the cache 
+	    directory, addressed by a hash of the code, python version and optimization level. 
+	    Only the most recent files are kept in the cache directory. */
+	static void setCacheMode(eCacheMode mode);
+	static eCacheMode getCacheMode();
+	static inline bool isCacheEnabled() { return getCacheMode() != eNoCache; }
+
+	/// Set the cache directory. An empty path disables the storage on disk.
+	static void setCacheDirectory(const std::string& path);
+	/// Cache directory. Default is $LPY_CACHE_DIR or the lpy directory of the user cache.
+	static std::string getCacheDirectory();
+
+	static void clearMemoryCache();
+
+	/// Hexadecimal digest of a text used to address cached data.
+	static std::string hash(const std::string& text);
+
+	/// Remove the oldest entries of directory matching pattern so that at most maxentries remain.
+	static void trimCacheDirectory(const std::string& directory, const std::string& pattern, size_t maxentries);
+
 protected:
-	static eCompiler Compiler;
 	static bool cythonAvailable;
+	static bool cacheDirectoryInitialized;
+	static std::string cacheDirectory;
+
+	// Return the code object of code, from the cache if possible.
+	static PyObject * cached_code_object(const std::string& code);
 
-	static std::string tmp_extension;
 	static std::string python_exec;
 
 	// Compile the code using local and global dict
@@ -71,13 +102,19 @@ protected:
 	static void py_file_compile(const std::string& code, const std::string& fname, 
 								PyObject * globals, PyObject * locals);
 
+	// Build the code as a native module with Cython in the cache directory and import it
 	static void pyx_file_compile(const std::string& code, const std::string& fname, 
 								PyObject * globals, PyObject * locals);
 
+	static std::string cython_directory();
+	// Return the native module file of modulename in directory or an empty string
+	static std::string cython_module_file(const std::string& directory, const std::string& modulename);
+
 	static std::string generate_fname(const std::string& fname);
 
 	static void py_file_write(const std::string& code, const std::string& fname);
-	static void py_file_import(const std::string& fname, PyObject * globals, PyObject * locals);
+	// Load a new module named modulename from filename, without registering it in sys.modules
+	static void py_file_import(const std::string& modulename, const std::string& filename, PyObject * globals, PyObject * locals);
 	static void py_file_remove(const std::string& fname);
 
 };
@@ -0,0 +1,117 @@
+/* ---------------------------------------------------------------------------
+ #
+ #       L-Py: L-systems in Python
+ #
+ #       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+ #
+ #       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+ #
+ # ---------------------------------------------------------------------------
+ #
+ #                      GNU General Public Licence
+ #
+ #       This program is free software; you can redistribute it and/or
+ #       modify it under the terms of the GNU General Public License as
+ #       published by the Free Software Foundation; either version 2 of
+ #       the License, or (at your option) any later version.
+ #
+ #       This program is distributed in the hope that it will be useful,
+ #       but WITHOUT ANY WARRANTY; without even the implied warranty of
+ #       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+ #       GNU General Public License for more details.
+ #
+ #       You should have received a copy of the GNU General Public
+ #       License along with this program; see the file COPYING. If not,
+ #       write to the Free Software Foundation, Inc., 59
+ #       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ #
+ # ---------------------------------------------------------------------------
+ */
+
+#pragma once
+
+#include "lpy_config.h"
+#include "error.h"
+#include <atomic>
+#include <queue>
+#include <QtCore/QMutex>
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/*
+  Table of pointers indexed by small integer ids with a lock-free read path.
+  Entries are stored in fixed size blocks that are never moved once allocated,
+  so a lookup only performs atomic loads. Insertions and removals are
+  serialized by a mutex and reuse the ids of removed entries.
+*/
+template<class T>
+class ConcurrentIdTable {
+public:
+	ConcurrentIdTable() : m_size(0)
+	{ for(size_t i = 0; i < MaxBlocks; ++i) m_blocks[i].store(NULL,std::memory_order_relaxed); }
+
+	~ConcurrentIdTable()
+	{ for(size_t i = 0; i < MaxBlocks; ++i) delete m_blocks[i].load(std::memory_order_relaxed); }
+
+	/// return the entry with given id or NULL
+	inline T * get(size_t id) const {
+		if (id >= m_size.load(std::memory_order_acquire)) return NULL;
+		return m_blocks[id >> BlockBits].load(std::memory_order_acquire)->entries[id & BlockMask].load(std::memory_order_acquire);
+	}
+
+	inline size_t size() const { return m_size.load(std::memory_order_acquire); }
+
+	/// store value and return its id
+	size_t insert(T * value) {
+		QMutexLocker locker(&m_mutex);
+		size_t id;
+		if (m_free_indices.empty()) {
+			id = m_size.load(std::memory_order_relaxed);
+			if ((id >> BlockBits) >= MaxBlocks) LsysError("Too many entries in concurrent table.");
+			if ((id & BlockMask) == 0) m_blocks[id >> BlockBits].store(new Block(),std::memory_order_release);
+			entry(id).store(value,std::memory_order_release);
+			m_size.store(id+1,std::memory_order_release);
+		}
+		else {
+			id = m_free_indices.front();
+			m_free_indices.pop();
+			entry(id).store(value,std::memory_order_release);
+		}
+		return id;
+	}
+
+	/// clear the entry with given id and return its previous value
+	T * remove(size_t id) {
+		QMutexLocker locker(&m_mutex);
+		if (id >= m_size.load(std::memory_order_relaxed)) return NULL;
+		T * value = entry(id).exchange(NULL,std::memory_order_acq_rel);
+		if (value != NULL) m_free_indices.push(id);
+		return value;
+	}
+
+protected:
+	enum { BlockBits = 8, BlockSize = 1 << BlockBits, BlockMask = BlockSize - 1, MaxBlocks = 4096 };
+
+	struct Block {
+		std::atomic<T *> entries[BlockSize];
+		Block() { for(size_t i = 0; i < BlockSize; ++i) entries[i].store(NULL,std::memory_order_relaxed); }
+	};
+
+	inline std::atomic<T *>& entry(size_t id)
+	{ return m_blocks[id >> BlockBits].load(std::memory_order_relaxed)->entries[id & BlockMask]; }
+
+	std::atomic<Block *> m_blocks[MaxBlocks];
+	std::atomic<size_t> m_size;
+	std::queue<size_t> m_free_indices;
+	QMutex m_mutex;
+
+private:
+	ConcurrentIdTable(const ConcurrentIdTable&);
+	ConcurrentIdTable& operator=(const ConcurrentIdTable&);
+};
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
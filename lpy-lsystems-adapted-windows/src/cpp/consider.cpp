@@ -36,24 +36,30 @@ LPY_USING_NAMESPACE
 
 /*---------------------------------------------------------------------------*/
 
+// The filters are activated per thread (see LsysContext::current).
+// Module::isIgnored and isConsidered are called from the axial tree traversal and matching 
+// templates, which take no context argument. They read the thread-local filter on each call
+// instead of receiving it explicitly.
+static thread_local std::stack<ConsiderFilterPtr> CONSIDERFILTER_STACK;
+static thread_local ConsiderFilterPtr CURRENT_CONSIDERFILTER = NULL;
+
 bool Module::isConsidered() const
 { 
-	if(is_null_ptr(ConsiderFilter::current())) return true;
-	return ConsiderFilter::current()->isConsidered(*this); 
+	const ConsiderFilter * filter = CURRENT_CONSIDERFILTER.get();
+	if(filter == NULL) return true;
+	return filter->isConsidered(*this); 
 }
 
 bool Module::isIgnored() const
 { 
-	if(is_null_ptr(ConsiderFilter::current())) return false;
-	return ConsiderFilter::current()->isIgnored(*this); 
+	const ConsiderFilter * filter = CURRENT_CONSIDERFILTER.get();
+	if(filter == NULL) return false;
+	return filter->isIgnored(*this); 
 }
 
 
 /*---------------------------------------------------------------------------*/
 
-static std::stack<ConsiderFilterPtr> CONSIDERFILTER_STACK;
-static ConsiderFilterPtr CURRENT_CONSIDERFILTER = NULL;
-
 ConsiderFilterPtr 
 ConsiderFilter::current() { return CURRENT_CONSIDERFILTER; }
 
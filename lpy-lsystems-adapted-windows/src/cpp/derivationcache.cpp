@@ -0,0 +1,173 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "derivationcache.h"
+#include "compilation.h"
+#include "../plantgl/tool/util_string.h"
+#include <QtCore/QDir>
+#include <QtCore/QCoreApplication>
+#include <fstream>
+#include <cstdio>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <utime.h>
+#endif
+
+#define bp boost::python
+
+LPY_USING_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+static const char DERIVATION_MAGIC[] = "LPYD";
+
+size_t DerivationCache::MaxDerivations = 64;
+
+std::string DerivationCache::directory()
+{
+	std::string directory = Compilation::getCacheDirectory();
+	if (directory.empty()) return directory;
+	return directory + "/derivations";
+}
+
+void DerivationCache::clear()
+{
+	std::string dir = directory();
+	if (!dir.empty()) QDir(QString(dir.c_str())).removeRecursively();
+}
+
+/* Set the modification time of path, a file or a directory, to now. */
+static void touch(const std::string& path)
+{
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 
+								NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if (handle == INVALID_HANDLE_VALUE) return;
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	SetFileTime(handle, NULL, NULL, &now);
+	CloseHandle(handle);
+#else
+	utime(path.c_str(), NULL);
+#endif
+}
+
+DerivationCache::DerivationCache(const std::string& key):
+	m_trimmed(false)
+{
+	std::string dir = directory();
+	if (!dir.empty() && QDir().mkpath(QString((dir + "/" + key).c_str())))
+		m_directory = dir + "/" + key;
+}
+
+std::string DerivationCache::filename(size_t iteration) const
+{
+	return m_directory + "/" + TOOLS(number)(iteration) + ".lpyd";
+}
+
+size_t DerivationCache::lastIteration(size_t maxiteration) const
+{
+	if (!isValid()) return 0;
+	for (size_t iteration = maxiteration; iteration > 0; --iteration)
+		if (std::ifstream(filename(iteration).c_str())) return iteration;
+	return 0;
+}
+
+bool DerivationCache::load(size_t iteration, AxialTree& result, std::string& randomstate) const
+{
+	if (!isValid()) return false;
+	std::ifstream stream(filename(iteration).c_str(), std::ios::in | std::ios::binary);
+	if (!stream) return false;
+	std::string data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	if (data.size() < 8 || data.compare(0,4,DERIVATION_MAGIC) != 0) return false;
+	uint32_t statesize = 0;
+	for (int i = 3; i >= 0; --i) statesize = (statesize << 8) | (unsigned char)data[4+i];
+	if (data.size() < 8 + statesize) return false;
+	randomstate = data.substr(8, statesize);
+	try {
+		result = AxialTree::fromBinary(data.substr(8 + statesize));
+	}
+	catch (bp::error_already_set) {
+		// stored by an incompatible version. It will be derived again.
+		PyErr_Clear();
+		return false;
+	}
+	// the trimming keeps the most recent derivations.
+	touch(m_directory);
+	return true;
+}
+
+bool DerivationCache::store(size_t iteration, const AxialTree& result, const std::string& randomstate) const
+{
+	if (!isValid()) return false;
+	std::string data(DERIVATION_MAGIC);
+	uint32_t statesize = randomstate.size();
+	for (int i = 0; i < 4; ++i) data += char((statesize >> (8*i)) & 0xff);
+	data += randomstate;
+	try {
+		data += result.toBinary();
+	}
+	catch (bp::error_already_set) {
+		// parameters that cannot be pickled.
+		PyErr_Clear();
+		return false;
+	}
+
+	std::string fname = filename(iteration);
+	std::string tmpfname = fname + "." + TOOLS(number)(size_t(QCoreApplication::applicationPid())) + ".tmp";
+	{
+		std::ofstream stream(tmpfname.c_str(), std::ios::out | std::ios::binary);
+		stream.write(data.data(), data.size());
+	}
+	if (std::rename(tmpfname.c_str(), fname.c_str()) != 0) { std::remove(tmpfname.c_str()); return false; }
+	if (!m_trimmed) {
+		// this derivation is the most recent entry and is kept.
+		m_trimmed = true;
+		Compilation::trimCacheDirectory(directory(), "*", MaxDerivations > 0 ? MaxDerivations : 1);
+	}
+	return true;
+}
+
+std::string DerivationCache::randomState()
+{
+	bp::object state = bp::import("random").attr("getstate")();
+	bp::object data = bp::import("pickle").attr("dumps")(state, 2);
+	return std::string(PyBytes_AsString(data.ptr()), PyBytes_Size(data.ptr()));
+}
+
+void DerivationCache::setRandomState(const std::string& state)
+{
+	bp::object data(bp::handle<>(PyBytes_FromStringAndSize(state.data(), state.size())));
+	bp::import("random").attr("setstate")(bp::import("pickle").attr("loads")(data));
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,81 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "axialtree.h"
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/** 
+	Iterations of a derivation stored in the derivations directory of the cache 
+	(see Compilation::getCacheDirectory). A derivation is addressed by a key that
+	should identify its code, parameters, initial string and random state. 
+	Each iteration stores the resulting string and the state of the python random module.
+	Only the MaxDerivations most recently used derivations are kept. The oldest ones are removed 
+	when a new derivation is stored.
+*/
+class LPY_API DerivationCache {
+public:
+	DerivationCache(const std::string& key);
+
+	/// False if no cache directory is available.
+	inline bool isValid() const { return !m_directory.empty(); }
+
+	/// Return the last stored iteration not greater than maxiteration, 0 if none.
+	size_t lastIteration(size_t maxiteration) const;
+
+	/// Load the given iteration. The derivation is then marked as recently used.
+	bool load(size_t iteration, AxialTree& result, std::string& randomstate) const;
+	/// Return false if the result cannot be stored, for instance if its parameters cannot be pickled.
+	bool store(size_t iteration, const AxialTree& result, const std::string& randomstate) const;
+
+	static size_t MaxDerivations;
+
+	static std::string directory();
+	/// Remove all the stored derivations.
+	static void clear();
+
+	/// Pickled state of the python random module.
+	static std::string randomState();
+	static void setRandomState(const std::string& state);
+
+protected:
+	std::string filename(size_t iteration) const;
+
+	std::string m_directory;
+	mutable bool m_trimmed;
+};
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
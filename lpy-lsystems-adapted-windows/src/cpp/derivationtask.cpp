@@ -0,0 +1,159 @@
+/* ---------------------------------------------------------------------------
+ #
+ #       L-Py: L-systems in Python
+ #
+ #       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+ #
+ #       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+ #
+ # ---------------------------------------------------------------------------
+ #
+ #                      GNU General Public Licence
+ #
+ #       This program is free software; you can redistribute it and/or
+ #       modify it under the terms of the GNU General Public License as
+ #       published by the Free Software Foundation; either version 2 of
+ #       the License, or (at your option) any later version.
+ #
+ #       This program is distributed in the hope that it will be useful,
+ #       but WITHOUT ANY WARRANTY; without even the implied warranty of
+ #       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+ #       GNU General Public License for more details.
+ #
+ #       You should have received a copy of the GNU General Public
+ #       License along with this program; see the file COPYING. If not,
+ #       write to the Free Software Foundation, Inc., 59
+ #       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ #
+ # ---------------------------------------------------------------------------
+ */
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "derivationtask.h"
+#include "gilrelease.h"
+#include "../plantgl/python/pyinterpreter.h"
+#include <climits>
+
+using namespace boost::python;
+LPY_USING_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+DerivationTask::DerivationTask(Lsystem * lsystem, 
+							   const AxialTree& workstring, 
+							   size_t starting_iter, 
+							   size_t nb_iter,
+							   boost::python::object progress,
+							   boost::python::object owner):
+	m_lsystem(lsystem),
+	m_axiom(workstring),
+	m_starting_iter(starting_iter),
+	m_nb_iter(nb_iter),
+	m_progress(progress),
+	m_owner(owner),
+	m_mutex(),
+	m_current(workstring),
+	m_iteration(starting_iter),
+	m_state(eWaiting),
+	m_cancel(false),
+	m_worker(this)
+{
+}
+
+DerivationTask::~DerivationTask()
+{
+	cancel();
+	wait();
+}
+
+void DerivationTask::start()
+{
+	if (state() != eWaiting) LsysError("Derivation task already started.");
+	if (m_lsystem->hasDerivationObserver()) LsysError("Lsystem is already deriving.");
+	m_lsystem->setDerivationObserver(this);
+	m_lsystem->setBusyThread(&m_worker);
+	m_state = eRunning;
+	m_worker.start();
+}
+
+void DerivationTask::cancel()
+{
+	m_cancel = true;
+}
+
+bool DerivationTask::wait(long timeout)
+{
+	if (state() == eWaiting) return true;
+	GilFreeSection nogil;
+	return m_worker.wait(timeout < 0 ? ULONG_MAX : (unsigned long)timeout);
+}
+
+size_t DerivationTask::iterationNb() const
+{
+	QMutexLocker ml(&m_mutex);
+	return m_iteration;
+}
+
+AxialTree DerivationTask::currentString() const
+{
+	QMutexLocker ml(&m_mutex);
+	return m_current;
+}
+
+AxialTree DerivationTask::result()
+{
+	wait();
+	if (state() == eFailed) {
+		PyErr_Restore(incref(m_error_type.ptr()),
+			          incref(m_error_value.ptr()),
+					  m_error_traceback.ptr() == Py_None ? NULL : incref(m_error_traceback.ptr()));
+		throw_error_already_set();
+	}
+	return currentString();
+}
+
+bool DerivationTask::iterationDone(size_t iteration, const AxialTree& lstring)
+{
+	{
+		QMutexLocker ml(&m_mutex);
+		m_iteration = iteration;
+		m_current = lstring;
+	}
+	if (m_progress != object()) m_progress(iteration, lstring);
+	return !m_cancel;
+}
+
+void DerivationTask::run()
+{
+	PythonInterpreterAcquirer py;
+	eState endstate = eFinished;
+	if (!m_cancel) {
+		try {
+			AxialTree res = m_lsystem->derive(m_axiom, m_starting_iter, m_nb_iter);
+			QMutexLocker ml(&m_mutex);
+			m_current = res;
+		}
+		catch (error_already_set) {
+			endstate = eFailed;
+		}
+		catch (std::exception& e) {
+			PyErr_SetString(PyExc_RuntimeError, e.what());
+			endstate = eFailed;
+		}
+		if (endstate == eFailed) {
+			if (!PyErr_Occurred()) PyErr_SetString(PyExc_RuntimeError, "Derivation failed.");
+			PyObject * type, * value, * traceback;
+			PyErr_Fetch(&type, &value, &traceback);
+			PyErr_NormalizeException(&type, &value, &traceback);
+			m_error_type = object(handle<>(allow_null(type)));
+			m_error_value = object(handle<>(allow_null(value)));
+			m_error_traceback = object(handle<>(allow_null(traceback)));
+		}
+	}
+	if (endstate == eFinished && m_cancel) endstate = eCancelled;
+	m_lsystem->setDerivationObserver(NULL);
+	m_lsystem->setBusyThread(NULL);
+	m_state = endstate;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,136 @@
+/* ---------------------------------------------------------------------------
+ #
+ #       L-Py: L-systems in Python
+ #
+ #       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+ #
+ #       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+ #
+ # ---------------------------------------------------------------------------
+ #
+ #                      GNU General Public Licence
+ #
+ #       This program is free software; you can redistribute it and/or
+ #       modify it under the terms of the GNU General Public License as
+ #       published by the Free Software Foundation; either version 2 of
+ #       the License, or (at your option) any later version.
+ #
+ #       This program is distributed in the hope that it will be useful,
+ #       but WITHOUT ANY WARRANTY; without even the implied warranty of
+ #       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+ #       GNU General Public License for more details.
+ #
+ #       You should have received a copy of the GNU General Public
+ #       License along with this program; see the file COPYING. If not,
+ #       write to the Free Software Foundation, Inc., 59
+ #       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ #
+ # ---------------------------------------------------------------------------
+ */
+
+
+#pragma once
+
+#include "lsystem.h"
+#include <atomic>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/*
+  Derivation of an Lsystem run in a background thread.
+  The worker thread takes the GIL to derive and the GIL is released in the 
+  native phases of the derivation, so the calling thread can keep running python.
+  Cancellation is cooperative and takes effect at the end of the current iteration.
+  While the task is running, the Lsystem is busy: its derive, set and clear 
+  methods raise an error when called from other threads.
+*/
+class LPY_API DerivationTask : public TOOLS(RefCountObject), public Lsystem::DerivationObserver {
+public:
+	enum eState {
+		eWaiting,
+		eRunning,
+		eFinished,
+		eCancelled,
+		eFailed
+	};
+
+	DerivationTask(Lsystem * lsystem, 
+				   const AxialTree& workstring, 
+				   size_t starting_iter, 
+				   size_t nb_iter,
+				   boost::python::object progress = boost::python::object(),
+				   boost::python::object owner = boost::python::object());
+
+	/// cancel the derivation and wait for its termination.
+	virtual ~DerivationTask();
+
+	/// start the derivation in a new thread.
+	void start();
+
+	/// request the derivation to stop at the end of the current iteration.
+	void cancel();
+
+	/// wait for the end of the derivation. timeout in ms, negative for no timeout. Return true if done.
+	bool wait(long timeout = -1);
+
+	eState state() const { return eState(m_state.load()); }
+	bool isRunning() const { return state() == eRunning; }
+	bool isDone() const { eState s = state(); return s != eWaiting && s != eRunning; }
+	bool isCancelled() const { return state() == eCancelled; }
+
+	/// number of the last completed iteration.
+	size_t iterationNb() const;
+
+	/// string obtained at the last completed iteration.
+	AxialTree currentString() const;
+
+	/// wait for the end of the derivation and return its result or raise its error.
+	AxialTree result();
+
+	virtual bool iterationDone(size_t iteration, const AxialTree& lstring);
+
+protected:
+	void run();
+
+	class Worker : public QThread {
+	public:
+		Worker(DerivationTask * task) : m_task(task) {}
+	protected:
+		virtual void run() { m_task->run(); }
+		DerivationTask * m_task;
+	};
+
+	Lsystem * m_lsystem;
+	AxialTree m_axiom;
+	size_t m_starting_iter;
+	size_t m_nb_iter;
+	boost::python::object m_progress;
+	boost::python::object m_owner;
+
+	mutable QMutex m_mutex;
+	AxialTree m_current;
+	size_t m_iteration;
+
+	std::atomic<int> m_state;
+	std::atomic<bool> m_cancel;
+
+	boost::python::object m_error_type;
+	boost::python::object m_error_value;
+	boost::python::object m_error_traceback;
+
+	Worker m_worker;
+
+private:
+	DerivationTask(const DerivationTask&);
+	DerivationTask& operator=(const DerivationTask&);
+};
+
+typedef RCPtr<DerivationTask> DerivationTaskPtr;
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
@@ -0,0 +1,103 @@
+/* ---------------------------------------------------------------------------
+ #
+ #       L-Py: L-systems in Python
+ #
+ #       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+ #
+ #       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+ #
+ # ---------------------------------------------------------------------------
+ #
+ #                      GNU General Public Licence
+ #
+ #       This program is free software; you can redistribute it and/or
+ #       modify it under the terms of the GNU General Public License as
+ #       published by the Free Software Foundation; either version 2 of
+ #       the License, or (at your option) any later version.
+ #
+ #       This program is distributed in the hope that it will be useful,
+ #       but WITHOUT ANY WARRANTY; without even the implied warranty of
+ #       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+ #       GNU General Public License for more details.
+ #
+ #       You should have received a copy of the GNU General Public
+ #       License along with this program; see the file COPYING. If not,
+ #       write to the Free Software Foundation, Inc., 59
+ #       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ #
+ # ---------------------------------------------------------------------------
+ */
+
+
+#pragma once
+
+#include "lpy_config.h"
+#include <Python.h>
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/*
+  Scoped release of the Python GIL for native phases of a derivation.
+  The GIL is only released after a given number of consecutive calls to
+  native(), so that short native runs between two python rule calls do not
+  pay the cost of a GIL switch. python() takes the GIL back before any
+  python object is touched. The GIL is always held again on destruction.
+*/
+class GilReleaser {
+public:
+	GilReleaser(size_t threshold = DefaultThreshold) : 
+		m_state(NULL), m_count(0), m_threshold(threshold),
+		m_enabled(Py_IsInitialized() && PyGILState_Check()) {}
+
+	~GilReleaser() { python(); }
+
+	/// signal a native operation. Release the GIL once enough of them occured in a row.
+	inline void native() {
+		if (m_state == NULL && m_enabled && ++m_count >= m_threshold) 
+			m_state = PyEval_SaveThread();
+	}
+
+	/// release the GIL immediatly.
+	inline void release() {
+		if (m_state == NULL && m_enabled) m_state = PyEval_SaveThread();
+	}
+
+	/// get the GIL back before a python call.
+	inline void python() {
+		m_count = 0;
+		if (m_state != NULL) { PyEval_RestoreThread(m_state); m_state = NULL; }
+	}
+
+	inline bool released() const { return m_state != NULL; }
+
+	static const size_t DefaultThreshold = 64;
+
+protected:
+	PyThreadState * m_state;
+	size_t m_count;
+	size_t m_threshold;
+	bool m_enabled;
+
+private:
+	GilReleaser(const GilReleaser&);
+	GilReleaser& operator=(const GilReleaser&);
+};
+
+/*---------------------------------------------------------------------------*/
+
+/*
+  Scoped release of the GIL around a block that never touches python objects.
+*/
+class GilFreeSection {
+public:
+	GilFreeSection() { m_releaser.release(); }
+
+protected:
+	GilReleaser m_releaser;
+};
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
@@ -0,0 +1,99 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#include "homomorphismiterator.h"
+
+LPY_USING_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+HomomorphismIterator::HomomorphismIterator(Lsystem * lsystem, const AxialTree& lstring):
+	m_lsystem(lsystem), m_current(NULL)
+{
+	if (lstring.empty()) return;
+	// same cases as Lsystem::homomorphism
+	if (lsystem->m_rules.empty() || 
+		( lsystem->group(0).interpretation.empty() &&
+		 (lsystem->group(lsystem->m_currentGroup).interpretation.empty() ||
+		  lsystem->m_rules.size() < lsystem->m_currentGroup))) 
+		push(lstring,0);
+	else {
+		m_rules = lsystem->getRules(Lsystem::eInterpretation,lsystem->m_currentGroup,eForward);
+		if (m_rules.empty()) return;
+		push(lstring,std::max<size_t>(lsystem->m_interpretation_max_depth,1));
+	}
+	next();
+}
+
+void HomomorphismIterator::push(const AxialTree& lstring, size_t depth)
+{
+	m_stack.push_back(Frame(lstring,depth));
+	Frame& frame = m_stack.back();
+	frame.pos = frame.lstring.const_begin();
+	frame.end = frame.lstring.const_end();
+}
+
+void HomomorphismIterator::next()
+{
+	m_current = NULL;
+	if (m_stack.empty()) return;
+	ContextMaintainer c(&m_lsystem->m_context);
+	DerivationProfiler * profiler = m_lsystem->activeProfiler();
+	while (!m_stack.empty()) {
+		Frame& frame = m_stack.back();
+		if (frame.pos == frame.end) { m_stack.pop_back(); continue; }
+		if (frame.depth == 0) { m_current = &*frame.pos; ++frame.pos; return; }
+		if (frame.pos->isCut()) { frame.pos = frame.lstring.endBracket(frame.pos); continue; }
+
+		AxialTree production;
+		AxialTree::const_iterator endpos = frame.pos;
+		bool match = false;
+		const RulePtrSet& mruleset = m_rules[frame.pos->getClassId()];
+		StochasticSelection selection(m_lsystem->m_context.randomStream(), frame.pos - frame.lstring.const_begin());
+		for(RulePtrSet::const_iterator _it2 = mruleset.begin(); _it2 != mruleset.end(); _it2++){
+			if(!selection.isSelected(*_it2)) continue;
+			ArgList args;
+			if(profiler) profiler->matchAttempt(*_it2);
+			if((*_it2)->match(frame.lstring,frame.pos,production,endpos,args)){
+				RuleApplicationProbe probe(profiler,*_it2,production);
+				m_lsystem->m_context.randomStream().setAddress(frame.pos - frame.lstring.const_begin(), (*_it2)->getStreamId());
+				match = (*_it2)->applyTo(production,args);
+				probe.done(match,production);
+				if(match) break;
+			}
+		}
+		if (!match) { m_current = &*frame.pos; ++frame.pos; return; }
+		frame.pos = endpos;
+		// frame is invalidated by push
+		push(production, frame.depth > 1 ? frame.depth - 1 : 0);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
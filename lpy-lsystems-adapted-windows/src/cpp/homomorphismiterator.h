@@ -0,0 +1,80 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "lsystem.h"
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/**
+	Pull-based homomorphism of an lstring. Gives the modules of Lsystem::homomorphism one by one,
+	applying the interpretation rules on the fly. Nested applications are kept on an explicit stack
+	of productions, so the interpreted string is never materialized.
+	The current module is valid until the next call to next(). The rules of the lsystem should 
+	not be modified while iterating.
+*/
+class LPY_API HomomorphismIterator {
+public:
+	HomomorphismIterator(Lsystem * lsystem, const AxialTree& lstring);
+
+	inline bool atEnd() const { return m_current == NULL; }
+	inline const ParamModule& current() const { return *m_current; }
+
+	/// Go to the next interpreted module.
+	void next();
+
+	inline const ParamModule& operator*() const { return current(); }
+	inline const ParamModule * operator->() const { return m_current; }
+	inline HomomorphismIterator& operator++() { next(); return *this; }
+
+protected:
+	struct Frame {
+		Frame(const AxialTree& _lstring, size_t _depth) : lstring(_lstring), depth(_depth) {}
+		AxialTree lstring;
+		AxialTree::const_iterator pos;
+		AxialTree::const_iterator end;
+		/// remaining depth of rule application. 0 if modules are given as is.
+		size_t depth;
+	};
+
+	void push(const AxialTree& lstring, size_t depth);
+
+	Lsystem * m_lsystem;
+	RulePtrMap m_rules;
+	std::vector<Frame> m_stack;
+	const ParamModule * m_current;
+};
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
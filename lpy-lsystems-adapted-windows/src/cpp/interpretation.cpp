@@ -91,11 +91,12 @@ std::string LPY::helpTurtle() {
 		  pcat = ccat;
 	  }
 	  stream << m->name;
-	  if (!m->aliases.empty()){
+	  ModuleClass::AliasList aliases = m->getAliases();
+	  if (!aliases.empty()){
 		  stream << " ( ";
-		  for(std::vector<std::string>::const_iterator ita = m->aliases.begin();
-			  ita != m->aliases.end(); ++ita){
-			if (ita != m->aliases.begin()) stream << ", ";
+		  for(std::vector<std::string>::const_iterator ita = aliases.begin();
+			  ita != aliases.end(); ++ita){
+			if (ita != aliases.begin()) stream << ", ";
 			stream << *ita;
 		  }
 		  stream << " )";
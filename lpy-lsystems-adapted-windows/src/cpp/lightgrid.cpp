@@ -0,0 +1,166 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#include "lightgrid.h"
+#include "error.h"
+#include <algorithm>
+#include <math.h>
+
+LPY_USING_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+LightGrid::LightGrid(const Vector3& lower, const Vector3& upper, real_t voxelsize, real_t extinction):
+	m_lower(lower), m_voxelsize(voxelsize), m_extinction(extinction), m_intensity(0)
+{
+	if (voxelsize <= 0) LsysError("LightGrid: the voxel size should be positive.");
+	for (int a = 0; a < 3; ++a) {
+		if (upper[a] <= lower[a]) LsysError("LightGrid: the upper corner should be above the lower corner.");
+		m_dims[a] = std::max<size_t>(1, size_t(ceil((upper[a] - lower[a]) / voxelsize)));
+	}
+	m_area.assign(m_dims[0] * m_dims[1] * m_dims[2], 0);
+	m_light.assign(m_area.size(), 0);
+}
+
+void LightGrid::clear()
+{
+	std::fill(m_area.begin(), m_area.end(), 0);
+	m_modulevoxels.clear();
+	clearLight();
+}
+
+void LightGrid::clearLight()
+{
+	std::fill(m_light.begin(), m_light.end(), 0);
+	m_intensity = 0;
+}
+
+bool LightGrid::voxelIndex(const Vector3& position, size_t& index) const
+{
+	size_t coord[3];
+	for (int a = 0; a < 3; ++a) {
+		real_t c = floor((position[a] - m_lower[a]) / m_voxelsize);
+		if (c < 0 || c >= real_t(m_dims[a])) return false;
+		coord[a] = size_t(c);
+	}
+	index = (coord[2] * m_dims[1] + coord[1]) * m_dims[0] + coord[0];
+	return true;
+}
+
+LightGrid::Vector3 LightGrid::voxelCenter(size_t index) const
+{
+	size_t x = index % m_dims[0];
+	size_t y = (index / m_dims[0]) % m_dims[1];
+	size_t z = index / (m_dims[0] * m_dims[1]);
+	return m_lower + Vector3(x + 0.5, y + 0.5, z + 0.5) * m_voxelsize;
+}
+
+void LightGrid::deposit(const Vector3& position, real_t area, long id)
+{
+	size_t index;
+	if (!voxelIndex(position, index)) return;
+	m_area[index] += area;
+	if (id >= 0) {
+		std::vector<size_t>& voxels = m_modulevoxels[id];
+		if (voxels.empty() || voxels.back() != index) voxels.push_back(index);
+	}
+}
+
+void LightGrid::addSegment(const Vector3& start, const Vector3& end, real_t width, long id)
+{
+	// sample the segment at half the voxel size so that each crossed voxel receives its part of the area.
+	Vector3 segment = end - start;
+	real_t length = norm(segment);
+	size_t nbsamples = std::max<size_t>(1, size_t(ceil(2 * length / m_voxelsize)));
+	real_t area = length * width / nbsamples;
+	for (size_t i = 0; i < nbsamples; ++i)
+		deposit(start + segment * ((i + 0.5) / nbsamples), area, id);
+}
+
+void LightGrid::addArea(const Vector3& position, real_t area, long id)
+{
+	deposit(position, area, id);
+}
+
+void LightGrid::propagate(const Vector3& _direction, real_t intensity)
+{
+	Vector3 direction = _direction;
+	if (direction.normalize() == 0) LsysError("LightGrid: null light direction.");
+
+	// voxels are processed from upstream to downstream so that the upstream voxel of each one is already computed.
+	std::vector<real_t> projection(m_area.size());
+	std::vector<size_t> order(m_area.size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+		projection[i] = dot(voxelCenter(i), direction);
+	}
+	std::sort(order.begin(), order.end(), [&projection](size_t a, size_t b) { return projection[a] < projection[b]; });
+
+	// attenuation of the light crossing a voxel of given area, with a path length of the voxel size.
+	real_t attenuation = m_extinction / (m_voxelsize * m_voxelsize);
+	std::vector<real_t> depth(m_area.size(), 0);
+	for (std::vector<size_t>::const_iterator it = order.begin(); it != order.end(); ++it) {
+		size_t upstream;
+		real_t d = 0;
+		if (voxelIndex(voxelCenter(*it) - direction * m_voxelsize, upstream))
+			d = depth[upstream] + attenuation * m_area[upstream];
+		depth[*it] = d;
+		// a voxel is half shaded by its own content.
+		m_light[*it] += intensity * exp(-d - 0.5 * attenuation * m_area[*it]);
+	}
+	m_intensity += intensity;
+}
+
+real_t LightGrid::light(const Vector3& position) const
+{
+	size_t index;
+	if (!voxelIndex(position, index)) return m_intensity;
+	return m_light[index];
+}
+
+real_t LightGrid::area(const Vector3& position) const
+{
+	size_t index;
+	if (!voxelIndex(position, index)) return 0;
+	return m_area[index];
+}
+
+bool LightGrid::moduleLight(long id, real_t& value) const
+{
+	std::unordered_map<long, std::vector<size_t> >::const_iterator it = m_modulevoxels.find(id);
+	if (it == m_modulevoxels.end()) return false;
+	real_t sum = 0;
+	for (std::vector<size_t>::const_iterator itv = it->second.begin(); itv != it->second.end(); ++itv)
+		sum += m_light[*itv];
+	value = sum / it->second.size();
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,102 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "lpy_config.h"
+#include "../plantgl/math/util_vector.h"
+#include "../plantgl/tool/rcobject.h"
+#include <vector>
+#include <unordered_map>
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/** 
+	Voxel grid estimating the light intercepted by a plant. The grid is filled with the 
+	leaf and stem area of the interpreted geometry, given as segments with a width or 
+	as areas at points, each one optionally associated to a module id. Light is then 
+	propagated from directions in a single sweep of the voxels ordered along the direction, 
+	the optical depth of a voxel being the one of its upstream voxel plus the attenuation 
+	of this one (Beer-Lambert law). Rules can then query the light received by a module.
+*/
+class LPY_API LightGrid : public TOOLS(RefCountObject) {
+public:
+	typedef TOOLS(Vector3) Vector3;
+
+	LightGrid(const Vector3& lower, const Vector3& upper, real_t voxelsize, real_t extinction = 0.5);
+
+	/// Remove geometry and light.
+	void clear();
+	/// Remove light only.
+	void clearLight();
+
+	/// Add the area length * width of a segment along it. 
+	void addSegment(const Vector3& start, const Vector3& end, real_t width, long id = -1);
+	void addArea(const Vector3& position, real_t area, long id = -1);
+
+	/// Propagate light traveling in direction with the given intensity. Light of several directions is summed.
+	void propagate(const Vector3& direction, real_t intensity = 1);
+
+	/// Light at position. The total intensity is returned outside of the grid.
+	real_t light(const Vector3& position) const;
+
+	/// Mean light of the voxels of the module id. Return false if no geometry was added for it.
+	bool moduleLight(long id, real_t& value) const;
+
+	inline real_t totalIntensity() const { return m_intensity; }
+	inline real_t voxelSize() const { return m_voxelsize; }
+	inline real_t extinction() const { return m_extinction; }
+	inline void setExtinction(real_t value) { m_extinction = value; }
+	inline size_t nbVoxels() const { return m_area.size(); }
+	/// Total area in the voxel of position.
+	real_t area(const Vector3& position) const;
+
+protected:
+	bool voxelIndex(const Vector3& position, size_t& index) const;
+	Vector3 voxelCenter(size_t index) const;
+	void deposit(const Vector3& position, real_t area, long id);
+
+	Vector3 m_lower;
+	real_t m_voxelsize;
+	real_t m_extinction;
+	size_t m_dims[3];
+	std::vector<real_t> m_area;
+	std::vector<real_t> m_light;
+	real_t m_intensity;
+	std::unordered_map<long, std::vector<size_t> > m_modulevoxels;
+};
+
+typedef TOOLS(RefCountPtr)<LightGrid> LightGridPtr;
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
@@ -31,9 +31,11 @@
 #include "lsystem.h"
 #include "matching.h"
 #include "lpy_parser.h"
+#include "compilation.h"
 #include "../plantgl/tool/util_string.h"
 #include "../plantgl/python/extract_list.h"
 #include <QtCore/QFileInfo>
+#include <set>
 
 using namespace boost::python;
 LPY_USING_NAMESPACE
@@ -254,6 +256,79 @@ float LpyParsing::getFormatVersion(std::string::const_iterator& it, std::string:
 
 #define WindowSpecificEndline 13
 
+/*---------------------------------------------------------------------------*/
+
+/* Module declaration of a source, replayed when its translation is reused. */
+struct ModuleDeclaration {
+	enum eKind { eDeclare, eAlias, eUndeclare };
+	ModuleDeclaration(eKind _kind, const std::string& _name, int _lineno) :
+		kind(_kind), name(_name), scale(ModuleClass::DEFAULT_SCALE), lineno(_lineno) {}
+	eKind kind;
+	std::string name;
+	/// aliased module of an alias
+	std::string target;
+	std::vector<std::string> parameters;
+	int scale;
+	ModuleClassList bases;
+	int lineno;
+};
+
+static void declareModule(LsysContext& context, const ModuleDeclaration& declaration, const std::string& filename)
+{
+	ModuleClassPtr mod;
+	switch(declaration.kind){
+	case ModuleDeclaration::eDeclare:
+		mod = ModuleClassTable::get().declare(declaration.name);
+		context.declare(mod);
+		// clean parameter set in case it has none declared but only some from inheritance
+		mod->setParameterNames(declaration.parameters);
+		break;
+	case ModuleDeclaration::eAlias:
+		mod = ModuleClassTable::get().find(declaration.target);
+		if (!mod) LsysError("Undefined module '"+declaration.target+"' for alias.","",declaration.lineno);
+		context.declareAlias(declaration.name,mod);
+		break;
+	case ModuleDeclaration::eUndeclare:
+		mod = ModuleClassTable::get().find(declaration.name);
+		if(mod)context.undeclare(mod);
+		else LsysError("Cannot undeclare a not declared module",filename,declaration.lineno);
+		return;
+	}
+	if(declaration.scale != ModuleClass::DEFAULT_SCALE)mod->setScale(declaration.scale);
+	if(!declaration.bases.empty())mod->setBases(declaration.bases);
+}
+
+/* Translation of a source: its python code, parsed rules, module declarations and the 
+   parametric productions referred to by the code. The rules and the code refer to module 
+   classes and productions by their id in the process, so translations are only kept in memory, 
+   while the table of module classes has no removal. They are accessed with the GIL held. */
+struct Translation {
+	struct Rule {
+		Rule(const LsysRule& _rule, int _type, size_t _group) : rule(_rule), type(_type), group(_group) {}
+		LsysRule rule;
+		int type;
+		size_t group;
+	};
+	std::string code;
+	std::vector<Rule> rules;
+	std::vector<ModuleDeclaration> declarations;
+	/// classes declared in the context by the parsing of the rules and of the axiom
+	ModuleClassList implicit;
+	/// classes only activated by the parsing
+	ModuleClassList activated;
+	ParametricProductionList productions;
+	size_t removals;
+	bool axiom_is_function;
+	int axiom_lineno;
+	int max_derivation_lineno;
+	int decomposition_max_depth_lineno;
+	int homomorphism_max_depth_lineno;
+};
+
+typedef pgl_hash_map_string<Translation> TranslationCache;
+static TranslationCache TRANSLATION_CACHE;
+static const size_t TRANSLATION_CACHE_MAX_SIZE = 64;
+
 size_t LsysContext::initialiseFrom(const std::string& _lcode)
 {
 	ContextMaintainer c(this);
@@ -271,6 +346,7 @@ size_t LsysContext::initialiseFrom(const std::string& _lcode)
 void 
 Lsystem::set( const std::string&   _rules , std::string * pycode, 
 			  const boost::python::dict& parameters){
+  checkNotBusy();
   ACQUIRE_RESSOURCE
   std::string filename = getFilename();
   clear();
@@ -325,6 +401,61 @@ Lsystem::set( const std::string&   _rules , std::string * pycode,
 
   if (initpos != std::string::npos) endpycode = rules.begin()+initpos;
 
+  // identify code and parameters for the translation and derivation caches
+  std::string sourcekey;
+  try {
+	  boost::python::list items(parameters.items());
+	  items.sort();
+	  object data = boost::python::import("pickle").attr("dumps")(items, 2);
+	  sourcekey = Compilation::hash(rules + ':' + std::string(PyBytes_AsString(data.ptr()), PyBytes_Size(data.ptr())));
+  }
+  catch(error_already_set const &) {
+	  PyErr_Clear();
+  }
+  // the translation also depends on the file, for relative paths, and on the optimization level.
+  std::string translationkey;
+  if (!sourcekey.empty() && Compilation::isCacheEnabled()) 
+	  translationkey = Compilation::hash(sourcekey + ':' + getFilename() + ':' + TOOLS(number)(m_context.optimizationLevel));
+  std::vector<ModuleDeclaration> declarations;
+  std::set<size_t> initialclasses;
+  TranslationCache::const_iterator translation = TRANSLATION_CACHE.end();
+  if (!translationkey.empty()) {
+	  translation = TRANSLATION_CACHE.find(translationkey);
+	  if (translation != TRANSLATION_CACHE.end() && translation->second.removals != ModuleClassTable::get().removals()) {
+		  TRANSLATION_CACHE.erase(translation);
+		  translation = TRANSLATION_CACHE.end();
+	  }
+  }
+  if (translation != TRANSLATION_CACHE.end()) {
+	  // the source is not parsed again: the effects of its parsing are replayed and the parsing loop is skipped.
+	  const Translation& t = translation->second;
+	  for(std::vector<ModuleDeclaration>::const_iterator itdecl = t.declarations.begin(); itdecl != t.declarations.end(); ++itdecl)
+		  declareModule(m_context, *itdecl, filename);
+	  for(ModuleClassList::const_iterator itcl = t.implicit.begin(); itcl != t.implicit.end(); ++itcl)
+		  if (!(*itcl)->isActive()) { 
+			  ModuleClassTable::get().declare((*itcl)->name); 
+			  m_context.declare(*itcl); 
+		  }
+	  for(ModuleClassList::const_iterator itcl = t.activated.begin(); itcl != t.activated.end(); ++itcl)
+		  if (!(*itcl)->isActive()) ModuleClassTable::get().getClass((*itcl)->name);
+	  m_context.add_pproductions(t.productions);
+	  for(std::vector<Translation::Rule>::const_iterator itr = t.rules.begin(); itr != t.rules.end(); ++itr)
+		  addRule(itr->rule, itr->type, itr->group);
+	  code = t.code;
+	  axiom_is_function = t.axiom_is_function;
+	  axiom_lineno = t.axiom_lineno;
+	  max_derivation_lineno = t.max_derivation_lineno;
+	  decomposition_max_depth_lineno = t.decomposition_max_depth_lineno;
+	  homomorphism_max_depth_lineno = t.homomorphism_max_depth_lineno;
+	  _it = beg = endpycode;
+	  translationkey.clear();
+  }
+  else if (!translationkey.empty()) {
+	  ModuleClassList classes = ModuleClassTable::get().getClasses();
+	  for(ModuleClassList::const_iterator itcl = classes.begin(); itcl != classes.end(); ++itcl)
+		  initialclasses.insert((*itcl)->getId());
+  }
+
   while(_it!=endpycode){
 	//printf("******'%c' %i\n",*_it,std::distance(begcode,_it));
 	switch(mode){
@@ -451,27 +582,22 @@ Lsystem::set( const std::string&   _rules , std::string * pycode,
 			}
 			for(LpyParsing::ModDeclarationList::const_iterator itmod = modules.first.begin(); 
 				 itmod != modules.first.end(); ++itmod){
-				ModuleClassPtr mod;
+				ModuleDeclaration declaration(itmod->alias ? ModuleDeclaration::eAlias : ModuleDeclaration::eDeclare, itmod->name, lineno);
 				if(!itmod->alias){
-					mod = ModuleClassTable::get().declare(itmod->name);
-				    m_context.declare(mod);
 					if(!itmod->parameters.empty()){
 						// printf("%s\n",itmod->parameters.c_str());
 						std::vector<std::string> args = LpyParsing::parse_arguments(itmod->parameters);
 						for(std::vector<std::string>::const_iterator itarg = args.begin(); itarg != args.end(); ++itarg){
 							if(!LpyParsing::isValidVariableName(*itarg))LsysError("Invalid parameter name '"+*itarg+"'","",lineno);
 						}
-						mod->setParameterNames(args);
+						declaration.parameters = args;
 					}
-					// clean parameter set in case it has none declared but only some from inheritance
-					else mod->setParameterNames(std::vector<std::string>());
-				}
-				else {
-					mod = ModuleClassTable::get().alias(itmod->name,itmod->parameters);
-					m_context.declareAlias(itmod->name,mod);
 				}
-				if(scale != ModuleClass::DEFAULT_SCALE)mod->setScale(scale);
-				if(!inheritance.empty())mod->setBases(inheritance);
+				else declaration.target = itmod->parameters;
+				declaration.scale = scale;
+				declaration.bases = inheritance;
+				declareModule(m_context, declaration, filename);
+				declarations.push_back(declaration);
 			}
             for(LpyParsing::ModDeclarationList::const_iterator itmod = modules.first.begin(); 
                  itmod != modules.first.end(); ++itmod){
@@ -506,9 +632,9 @@ Lsystem::set( const std::string&   _rules , std::string * pycode,
 			code+="# "+std::string(_it2,_it);
 			for(LpyParsing::ModNameList::const_iterator itmod = modules.begin(); 
 				 itmod != modules.end(); ++itmod){
-				ModuleClassPtr mod = ModuleClassTable::get().find(*itmod);
-				if(mod)m_context.undeclare(mod);
-				else LsysError("Cannot undeclare a not declared module",filename,lineno);
+				ModuleDeclaration declaration(ModuleDeclaration::eUndeclare, *itmod, lineno);
+				declareModule(m_context, declaration, filename);
+				declarations.push_back(declaration);
 			}
 			beg = _it;
 			toendlineA(_it,endpycode);
@@ -584,6 +710,8 @@ Lsystem::set( const std::string&   _rules , std::string * pycode,
                 if (notOnlySpace(beg,_it)){
 				  std::string modulename = LpyParsing::trim(std::string(beg,_it));
 				  addSubLsystem(modulename+".lpy");
+				  // the imported file may change independently of the source
+				  translationkey.clear();
 				}
 				else LsysParserSyntaxError("invalid module to import");
 			  }
@@ -978,6 +1106,41 @@ Lsystem::set( const std::string&   _rules , std::string * pycode,
    code.append(beg,_it);
   if (!addedcode.empty())
 	code+='\n'+addedcode;
+  if (!translationkey.empty()) {
+	  if (TRANSLATION_CACHE.size() >= TRANSLATION_CACHE_MAX_SIZE) TRANSLATION_CACHE.clear();
+	  Translation& t = TRANSLATION_CACHE[translationkey];
+	  t.code = code;
+	  size_t groupid = 0;
+	  for (RuleGroupList::const_iterator itg = m_rules.begin(); itg != m_rules.end(); ++itg, ++groupid) {
+		  for (RuleSet::const_iterator itr = itg->production.begin(); itr != itg->production.end(); ++itr)
+			  t.rules.push_back(Translation::Rule(*itr, 0, groupid));
+		  for (RuleSet::const_iterator itr = itg->decomposition.begin(); itr != itg->decomposition.end(); ++itr)
+			  t.rules.push_back(Translation::Rule(*itr, 1, groupid));
+		  for (RuleSet::const_iterator itr = itg->interpretation.begin(); itr != itg->interpretation.end(); ++itr)
+			  t.rules.push_back(Translation::Rule(*itr, 2, groupid));
+	  }
+	  t.declarations = declarations;
+	  std::set<size_t> declared;
+	  for(std::vector<ModuleDeclaration>::const_iterator itdecl = declarations.begin(); itdecl != declarations.end(); ++itdecl)
+		  if (itdecl->kind == ModuleDeclaration::eDeclare) {
+			  ModuleClassPtr mod = ModuleClassTable::get().find(itdecl->name);
+			  if (mod) declared.insert(mod->getId());
+		  }
+	  ModuleClassList classes = m_context.declaredModules();
+	  for(ModuleClassList::const_iterator itcl = classes.begin(); itcl != classes.end(); ++itcl)
+		  if (declared.insert((*itcl)->getId()).second) t.implicit.push_back(*itcl);
+	  classes = ModuleClassTable::get().getClasses();
+	  for(ModuleClassList::const_iterator itcl = classes.begin(); itcl != classes.end(); ++itcl)
+		  if (initialclasses.find((*itcl)->getId()) == initialclasses.end() && declared.find((*itcl)->getId()) == declared.end()) 
+			  t.activated.push_back(*itcl);
+	  t.productions = m_context.get_pproductions();
+	  t.removals = ModuleClassTable::get().removals();
+	  t.axiom_is_function = axiom_is_function;
+	  t.axiom_lineno = axiom_lineno;
+	  t.max_derivation_lineno = max_derivation_lineno;
+	  t.decomposition_max_depth_lineno = decomposition_max_depth_lineno;
+	  t.homomorphism_max_depth_lineno = homomorphism_max_depth_lineno;
+  }
   if(pycode) *pycode = code;
   //printf("CODE BEFORE COMPILATION:\n%s\n", code.c_str());
   m_context.compile(code);
@@ -1048,11 +1211,48 @@ Lsystem::set( const std::string&   _rules , std::string * pycode,
       }
   }
   m_context.check_init_functions();
+  m_sourcekey = sourcekey;
+  m_source = rules;
+  m_sourceparameters = boost::python::dict(parameters).copy();
   RELEASE_RESSOURCE
 }
 
+bool
+Lsystem::rebuild( const boost::python::dict& parameters ){
+  if (m_source.empty()) return false;
+  std::string source = m_source;
+  boost::python::dict sourceparameters = m_sourceparameters;
+  boost::python::dict merged = sourceparameters.copy();
+  merged.update(parameters);
+  try {
+	  set(source, NULL, merged);
+  }
+  catch (...) {
+	  m_source = source;
+	  m_sourceparameters = sourceparameters;
+	  throw;
+  }
+  m_sourceparameters = sourceparameters;
+  return true;
+}
+
 /*---------------------------------------------------------------------------*/
 
+/* Read the probability expression of a '@prob(' marker, starting at beg after its opening parenthesis. 
+   Return the position after the closing parenthesis. */
+static std::string::const_iterator parseProbabilityMarker(const std::string& rule, std::string::const_iterator beg, std::string& probability, int lineno)
+{
+	std::string::const_iterator endexpr = beg;
+	int depth = 1;
+	for(; endexpr != rule.end(); ++endexpr){
+		if (*endexpr == '(') ++depth;
+		else if (*endexpr == ')' && --depth == 0) break;
+	}
+	if (endexpr == rule.end()) LsysError("Ill-formed Rule : unclosed @prob( in "+rule,"",lineno);
+	probability = std::string(beg,endexpr);
+	return endexpr+1;
+}
+
 void LsysRule::set( const std::string& rule ){
   std::string::const_iterator endheader = rule.begin();
   std::string::const_iterator startcode = endheader;
@@ -1060,7 +1260,14 @@ void LsysRule::set( const std::string& rule ){
   bool arrow = false;
   std::string staticarrowtxt = "-static->";
   std::string staticmarkertxt = "@static";
+  std::string memoarrowtxt = "-memo->";
+  std::string memomarkertxt = "@memo";
+  std::string nativemarkertxt = "@native";
+  std::string probmarkertxt = "@prob(";
   bool staticrule = false;
+  bool memorule = false;
+  bool nativerule = false;
+  std::string probability;
   // count number of lines
   m_codelength = 0;
   for(std::string::const_iterator it = rule.begin(); it != rule.end(); ++it)
@@ -1070,11 +1277,27 @@ void LsysRule::set( const std::string& rule ){
 	  if(*endheader==':') { 
 		  foundendheader = true; 
 		  startcode = endheader+1; 
-		  std::string::const_iterator marker = startcode;
-		  while (marker!= rule.end() && (*marker == ' ' || *marker == '\t'))++marker;
-		  if(distance(marker,rule.end())>=staticmarkertxt.size() && std::string(marker,marker+staticmarkertxt.size()) == staticmarkertxt){
-			startcode = marker+staticmarkertxt.size();
-			staticrule = true;
+		  bool foundmarker = true;
+		  while(foundmarker){
+			  std::string::const_iterator marker = startcode;
+			  while (marker!= rule.end() && (*marker == ' ' || *marker == '\t'))++marker;
+			  if(distance(marker,rule.end())>=staticmarkertxt.size() && std::string(marker,marker+staticmarkertxt.size()) == staticmarkertxt){
+				startcode = marker+staticmarkertxt.size();
+				staticrule = true;
+			  }
+			  else if(distance(marker,rule.end())>=memomarkertxt.size() && std::string(marker,marker+memomarkertxt.size()) == memomarkertxt){
+				startcode = marker+memomarkertxt.size();
+				memorule = true;
+			  }
+			  else if(distance(marker,rule.end())>=probmarkertxt.size() && std::string(marker,marker+probmarkertxt.size()) == probmarkertxt){
+				startcode = parseProbabilityMarker(rule,marker+probmarkertxt.size(),probability,lineno);
+			  }
+			  else if(distance(marker,rule.end())>=nativemarkertxt.size() && std::string(marker,marker+nativemarkertxt.size()) == nativemarkertxt){
+				startcode = marker+nativemarkertxt.size();
+				nativerule = true;
+				foundmarker = false;
+			  }
+			  else foundmarker = false;
 		  }
 	  }
 	  else if(*endheader=='-' && (endheader==rule.begin()|| *(endheader-1)!='-' )){
@@ -1089,6 +1312,12 @@ void LsysRule::set( const std::string& rule ){
 			staticrule = true;
 			startcode = endheader+staticarrowtxt.size();
 		  }
+		  else if (distance(endheader,rule.end())>=memoarrowtxt.size() && std::string(endheader,endheader+memoarrowtxt.size()) == memoarrowtxt){
+			foundendheader = true;
+			arrow = true;
+			memorule = true;
+			startcode = endheader+memoarrowtxt.size();
+		  }
 		  else endheader++;
       } 
       else endheader++;
@@ -1096,21 +1325,68 @@ void LsysRule::set( const std::string& rule ){
   if(endheader == rule.end()){
 	LsysError("Ill-formed Rule : unfound delimiter ':' in "+rule,"",lineno);
   }
+  if(arrow){
+	  // the successor of an arrow rule may start with its probability
+	  std::string::const_iterator marker = startcode;
+	  while (marker!= rule.end() && (*marker == ' ' || *marker == '\t'))++marker;
+	  if(distance(marker,rule.end())>=probmarkertxt.size() && std::string(marker,marker+probmarkertxt.size()) == probmarkertxt)
+		startcode = parseProbabilityMarker(rule,marker+probmarkertxt.size(),probability,lineno);
+  }
   // identify successor code
   if (arrow)m_definition = " --> "+std::string(startcode,rule.end());
   else m_definition =  std::string(startcode,rule.end());
   // parse header
   std::string header(rule.begin(),endheader);
   parseHeader(header);
+  m_native = NULL;
+  if (nativerule) {
+	// the rest of the rule is the plugin symbol as 'library:symbol'. The library path may be quoted.
+	std::string::const_iterator beg = startcode, end = rule.end();
+	while (beg != end && isspace(*beg)) ++beg;
+	std::string::const_iterator startbinding = beg;
+	std::string library;
+	if (beg != end && (*beg == '"' || *beg == '\'')) {
+		std::string::const_iterator endquote = std::find(beg+1,end,*beg);
+		if (endquote == end) LsysError("Ill-formed native rule : unclosed quote after "+nativemarkertxt+" in "+rule,"",lineno);
+		library = std::string(beg+1,endquote);
+		beg = endquote+1;
+		while (beg != end && isspace(*beg)) ++beg;
+		if (beg == end || *beg != ':') LsysError("Ill-formed native rule : expected 'library:symbol' after "+nativemarkertxt+" in "+rule,"",lineno);
+	}
+	end = std::find(beg,end,'#');
+	while (beg != end && isspace(*(end-1))) --end;
+	std::string binding(beg,end);
+	size_t sep = binding.rfind(':');
+	if (library.empty()) library = binding.substr(0,sep == std::string::npos ? 0 : sep);
+	std::string symbol = (sep == std::string::npos ? std::string() : binding.substr(sep+1));
+	symbol.erase(0,symbol.find_first_not_of(" \t"));
+	if (sep == std::string::npos || library.empty() || symbol.empty() || symbol.find_first_of(" \t\n") != std::string::npos 
+		|| binding.substr(0,sep).find_first_of(" \t\n") != std::string::npos)
+		LsysError("Ill-formed native rule : expected 'library:symbol' after "+nativemarkertxt+" in "+rule,"",lineno);
+	if (staticrule) LsysError("A native rule cannot be static : "+rule,"",lineno);
+	// relative library paths are relative to the lsystem file
+	std::string directory;
+	LsysContext * context = LsysContext::currentContext();
+	if (context->hasObject("__file__")) 
+		directory = QFileInfo(QString(extract<std::string>(context->getObject("__file__"))().c_str())).dir().path().toStdString();
+	m_native = NativeRuleTable::get().find(library,symbol,directory);
+	if (!m_native->isCompatible(m_predecessor))
+		LsysError("Native rule '"+m_native->name()+"' is registered for '"+m_native->predecessor()+"' and not for '"+m_predecessor.str()+"'","",lineno);
+	// keep the line count of the rule for the alignment of the generated python code
+	m_definition = " "+nativemarkertxt+" "+std::string(startbinding,end)+std::string(std::count(startcode,rule.end(),'\n'),'\n');
+	memorule = false;
+  }
   m_hasquery = m_predecessor.hasRequestModule() 
 			|| m_newleftcontext.hasRequestModule()
 			|| m_leftcontext.hasRequestModule()
 			|| m_newrightcontext.hasRequestModule()
 			|| m_rightcontext.hasRequestModule();
+  setMemoized(memorule);
+  setProbability(probability);
   // check variables
   if(staticrule) setStatic();
   else {
-	if (LsysContext::current()->optimizationLevel >= 2)
+	if (LsysContext::current()->optimizationLevel >= 2 && !m_native)
 		keepOnlyRelevantVariables();
 	parseParameters();
   }
@@ -1120,6 +1396,12 @@ void LsysRule::set( const std::string& rule ){
 
 std::string 
 LsysRule::getCoreCode() {
+  if (m_native) {
+	// no python function. a comment keeps the lines of the code aligned with the lpy file.
+	std::string res = "# "+name()+" :"+m_definition;
+	if (res[res.size()-1] != '\n') res += '\n';
+	return res;
+  }
   std::stringstream res;
   int llineno = 0;
   std::string definition;
@@ -1765,12 +2047,12 @@ std::pair<std::string,std::string> LpyParsing::parse_variable(std::string::const
 															 int lineno)
 {
 	std::string::const_iterator it = beg;
-	while (it != end && *it == ' ' && *it == '\t')++it;
+	while (it != end && (*it == ' ' || *it == '\t'))++it;
 	std::string::const_iterator begname = it;
 	std::string::const_iterator begfilter = begname;
 	if(it == end)LsysError("Error parsing variable name (1)","",lineno);
 	if(*it == '-'){ ++it;  
-		while (it != end && *it == ' ' && *it == '\t')++it;
+		while (it != end && (*it == ' ' || *it == '\t'))++it;
 		if(it == end) return std::pair<std::string,std::string>("-","");
 		else LsysError("Error parsing variable name with '-' (3)","",lineno);
 	}
@@ -1781,10 +2063,11 @@ std::pair<std::string,std::string> LpyParsing::parse_variable(std::string::const
 	else LsysError("Error parsing variable name (2)","",lineno);
 	while(it != end && (isalnum(*it) || *it == '_'))++it;
 	std::string varname(begname,it);
-	while (it != end && *it == ' ' && *it == '\t')++it;
+	while (it != end && (*it == ' ' || *it == '\t'))++it;
 	if(it == end) return std::pair<std::string,std::string>(varname,"");
 	if (*it == 'i' && (++it) != end &&  *it == 'f'){
-		while (it != end && *it == ' ' && *it == '\t')++it;
+		++it;
+		while (it != end && (*it == ' ' || *it == '\t'))++it;
 		if(it == end)LsysError("Error parsing filter of variable","",lineno);
 		begfilter = it;
 	}
@@ -1821,3 +2104,21 @@ bool LpyParsing::isAConstant(std::string::const_iterator beg,
 	else if(std::distance(it,end) > 4 && std::string(it,end) == "None") return true;
 	return false;
 }
+
+/*---------------------------------------------------------------------------*/
+
+std::string LpyParsing::parse_comparison(const std::string& condition,
+										 std::string& lhs, std::string& rhs)
+{
+	size_t pos = condition.find_first_of("<>=!");
+	if (pos == std::string::npos) return std::string();
+	size_t oplength = (pos+1 < condition.size() && condition[pos+1] == '=' ? 2 : 1);
+	std::string op(condition,pos,oplength);
+	if (op == "=" || op == "!") return std::string();
+	// chained or multiple comparisons are left to python
+	if (condition.find_first_of("<>=!",pos+oplength) != std::string::npos) return std::string();
+	lhs = trim(std::string(condition,0,pos));
+	rhs = trim(std::string(condition,pos+oplength));
+	if (lhs.empty() || rhs.empty()) return std::string();
+	return op;
+}
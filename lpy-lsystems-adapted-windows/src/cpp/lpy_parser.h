@@ -154,6 +154,11 @@ public:
 	static bool isAConstant(std::string::const_iterator beg,
 			std::string::const_iterator end);
 
+	/// Split a condition of the form 'lhs op rhs' with op one of ==, !=, <, <=, >, >=.
+	/// Return the operator or an empty string if the condition is not a single comparison.
+	static std::string parse_comparison(const std::string& condition,
+										std::string& lhs, std::string& rhs);
+
 
 };
 
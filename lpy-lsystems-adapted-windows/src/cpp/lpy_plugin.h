@@ -0,0 +1,112 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+/**
+	Stable C interface of the native rule plugins.
+
+	A plugin is a shared library exporting an initialisation function named
+	LPY_PLUGIN_INIT_SYMBOL. It is called once when the library is loaded and registers
+	its native rules, each one under a symbol name and for a predecessor pattern.
+	A rule of a .lpy file is bound to a native rule with the marker
+
+		A(x,y) : @native library:symbol
+
+	The rule then receives a view on the values of its parameters (contexts first, as for
+	python rules) and appends its production through the builder. It returns a positive value
+	if a production was made, 0 if the rule does not apply and a negative value on error.
+	No python code is executed to apply such a rule: the function is called without the 
+	python GIL, so that it can run in parallel with the python code of other threads.
+	This header only depends on the C library and does not change with the L-Py version.
+*/
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define LPY_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define LPY_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LPY_PLUGIN_ABI_VERSION 1
+#define LPY_PLUGIN_INIT_SYMBOL "lpy_plugin_init"
+
+typedef enum {
+	LPY_ARG_NONE   = 0,
+	LPY_ARG_BOOL   = 1,
+	LPY_ARG_INT    = 2,
+	LPY_ARG_REAL   = 3,
+	LPY_ARG_OBJECT = 4
+} LpyArgType;
+
+/// Typed view on a parameter value. realValue is also set for bool and int values.
+typedef struct {
+	int type;
+	long long intValue;
+	double realValue;
+	const void * object; ///< opaque handle on the value, only valid during the call
+} LpyArgView;
+
+/// Appends modules to the production. All functions return 0 on success.
+typedef struct {
+	void * handle;
+	/// id of the module class of given name, declared if needed. -1 on error.
+	int (*moduleClass)(void * handle, const char * name);
+	/// start a new module. Next values are appended as its parameters.
+	int (*beginModule)(void * handle, int classid);
+	int (*addBool)(void * handle, int value);
+	int (*addInt)(void * handle, long long value);
+	int (*addReal)(void * handle, double value);
+	/// append the value viewed by arg, whatever its type.
+	int (*addArg)(void * handle, const LpyArgView * arg);
+	/// reproducible uniform draw in [0,1) of the current derivation.
+	double (*random)(void * handle);
+} LpyProductionBuilder;
+
+typedef int (*LpyNativeRule)(const LpyArgView * args, size_t nbargs, LpyProductionBuilder * builder, void * userdata);
+
+typedef struct {
+	int abiVersion;
+	void * handle;
+	/// register function under symbol for the given predecessor pattern (NULL for any). 0 on success.
+	int (*addRule)(void * handle, const char * symbol, const char * predecessor, LpyNativeRule function, void * userdata);
+} LpyPluginRegistry;
+
+/// returns 0 on success.
+typedef int (*LpyPluginInit)(LpyPluginRegistry * registry);
+
+#ifdef __cplusplus
+}
+#endif
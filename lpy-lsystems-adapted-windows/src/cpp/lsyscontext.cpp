@@ -58,12 +58,14 @@ const int LsysContext::DEFAULT_OPTIMIZATION_LEVEL(1);
 /*---------------------------------------------------------------------------*/
 
 static GlobalContext * GLOBAL_LSYSCONTEXT = NULL;
-
-
-static std::vector<LsysContext *> LSYSCONTEXT_STACK;
 static LsysContext * DEFAULT_LSYSCONTEXT = NULL;
+
+// The current context and the stack of activated ones are per thread. So is the state
+// a context sets when it becomes current (global options, activation of its module classes,
+// virtual tables and aliases), so that independent Lsystems can be derived concurrently.
+static thread_local std::vector<LsysContext *> LSYSCONTEXT_STACK;
 // static LsysContext * CURRENT_LSYSCONTEXT = LsysContext::globalContext();
-static LsysContext * CURRENT_LSYSCONTEXT = NULL;
+static thread_local LsysContext * CURRENT_LSYSCONTEXT = NULL;
 
 class ContextGarbageCollector
 {
@@ -171,21 +173,21 @@ void LsysContext::currentEvent()
 	for(LsysOptions::iterator it = options.begin(); it != options.end(); ++it)
 		(*it)->activateSelection();
 	for(ModuleClassList::const_iterator it = m_modules.begin(); it != m_modules.end(); ++it)
-		(*it)->activate();
+		(*it)->activateOnThread();
 	for(ModuleVTableList::const_iterator it = m_modulesvtables.begin(); it != m_modulesvtables.end(); ++it)
 		(*it)->activate();
 	for(AliasSet::const_iterator it = m_aliases.begin(); it != m_aliases.end(); ++it)
-	    { ModuleClassTable::get().alias(it->first,it->second); }
+	    { ModuleClassTable::get().activateAlias(it->first,it->second); }
 }
 
 void LsysContext::doneEvent()
 {
+	for(AliasSet::const_iterator it = m_aliases.begin(); it != m_aliases.end(); ++it)
+	    { ModuleClassTable::get().desactivateAlias(it->first); }
 	for(ModuleClassList::const_iterator it = m_modules.begin(); it != m_modules.end(); ++it)
-		(*it)->desactivate();
+		(*it)->activateOnThread(false);
 	for(ModuleVTableList::const_iterator it = m_modulesvtables.begin(); it != m_modulesvtables.end(); ++it)
 		(*it)->desactivate();
-	for(AliasSet::const_iterator it = m_aliases.begin(); it != m_aliases.end(); ++it)
-	    { ModuleClassTable::get().remove(it->first); }
 }
 
 void LsysContext::pushedEvent(LsysContext * newEvent)
@@ -207,6 +209,10 @@ m_selection_always_required(false),
 m_selection_requested(false),
 m_warn_with_sharp_module(true),
 return_if_no_matching(true),
+derivation_cache(false),
+incremental_decomposition(false),
+profiling(false),
+m_namespaceversion(0),
 optimizationLevel(DEFAULT_OPTIMIZATION_LEVEL),
 m_animation_step(DefaultAnimationTimeStep),
 m_animation_enabled(false),
@@ -231,10 +237,15 @@ LsysContext::LsysContext(const LsysContext& lsys):
   m_selection_requested(false),
   m_warn_with_sharp_module(lsys.m_warn_with_sharp_module),
   return_if_no_matching(lsys.return_if_no_matching),
+  derivation_cache(lsys.derivation_cache),
+  incremental_decomposition(lsys.incremental_decomposition),
+  profiling(lsys.profiling),
+  m_namespaceversion(0),
   optimizationLevel(lsys.optimizationLevel),
   m_animation_step(lsys.m_animation_step),
   m_animation_enabled(lsys.m_animation_enabled),
   m_iteration_nb(0),
+  m_random(lsys.m_random.getSeed()),
   m_nbargs_of_endeach(0),
   m_nbargs_of_end(0),
   m_nbargs_of_starteach(0),
@@ -254,6 +265,10 @@ m_selection_always_required(false),
 m_selection_requested(false),
 m_warn_with_sharp_module(true),
 return_if_no_matching(true),
+derivation_cache(false),
+incremental_decomposition(false),
+profiling(false),
+m_namespaceversion(0),
 optimizationLevel(DEFAULT_OPTIMIZATION_LEVEL),
 m_animation_step(DefaultAnimationTimeStep),
 m_animation_enabled(false),
@@ -280,9 +295,13 @@ LsysContext::operator=(const LsysContext& lsys)
   m_selection_requested = false;
   m_warn_with_sharp_module = lsys.m_warn_with_sharp_module;
   return_if_no_matching = lsys.return_if_no_matching;
+  derivation_cache = lsys.derivation_cache;
+  incremental_decomposition = lsys.incremental_decomposition;
+  profiling = lsys.profiling;
   optimizationLevel = lsys.optimizationLevel;
   m_animation_step =lsys.m_animation_step;
   m_animation_enabled =lsys.m_animation_enabled;
+  m_random.setSeed(lsys.m_random.getSeed());
   m_nbargs_of_endeach =lsys.m_nbargs_of_endeach;
   m_nbargs_of_end =lsys.m_nbargs_of_end;
   m_nbargs_of_starteach =lsys.m_nbargs_of_starteach;
@@ -304,7 +323,7 @@ LsysContext::importContext(const LsysContext& other)
 	bool iscurrent = isCurrent();
 	for(ModuleClassList::iterator it = m_modules.begin()+nb; it != m_modules.end(); ++it)
 	{
-		(*it)->activate(iscurrent);
+		(*it)->activateOnThread(iscurrent);
 	}
 
 	add_pproductions(other.get_pproductions());
@@ -341,6 +360,13 @@ void LsysContext::init_options()
 		option->addValue("Cython",&Compilation::setCompiler,Compilation::eCython,"Use Cython compiler.");
 	option->setDefault(Compilation::eDefaultCompiler);
 	option->setGlobal(true);
+	/** compilation cache option */
+	option = options.add("Compilation cache","Specify if the translation and the compiled code of a model are cached to speed up later loadings of the same code.","Compilation");
+	option->addValue("Disabled",&Compilation::setCacheMode,Compilation::eNoCache,"Always parse and compile the code.");
+	option->addValue("Memory",&Compilation::setCacheMode,Compilation::eMemoryCache,"Reuse the translations and compiled code of the process.");
+	option->addValue("Memory and disk",&Compilation::setCacheMode,Compilation::eDiskCache,"Also store compiled code in the cache directory for later processes.");
+	option->setDefault(1);
+	option->setGlobal(true);
 	/** optimization option */
 	option = options.add("Optimization","Specify the level of optimization to use","Compilation");
 	option->addValue("Level 0",this,&LsysContext::setOptimizationLevel,0,"Use Level 0.");
@@ -373,6 +399,21 @@ void LsysContext::init_options()
 	option->addValue("Disabled",this,&LsysContext::setReturnIfNoMatching,false,"Disable early return.");
 	option->addValue("Enabled",this,&LsysContext::setReturnIfNoMatching,true,"Enable early return.");
 	option->setDefault(0);
+	/** derivation cache option */
+	option = options.add("Derivation cache","Set whether the iterations of a derivation are stored on disk and reused when the same code is derived again with the same parameters, options, axiom and random state. Changes of the namespace after loading and external state read by the rules (e.g. the scene of the host application) are not detected: they should be described by the derivationCacheKey of the lsystem.","Processing");
+	option->addValue("Disabled",this,&LsysContext::setDerivationCacheEnabled,false,"Always derive.");
+	option->addValue("Enabled",this,&LsysContext::setDerivationCacheEnabled,true,"Reuse stored iterations.");
+	option->setDefault(0);
+	/** incremental decomposition option */
+	option = options.add("Incremental decomposition","Set whether decomposition passes after the first one only rescan the modules produced by the previous pass. Used only when all decomposition rules are deterministic, context-free and match a single module. Rules are assumed to give the same result when applied again on the same module.","Processing");
+	option->addValue("Disabled",this,&LsysContext::setIncrementalDecompositionEnabled,false,"Rescan the whole string at each pass.");
+	option->addValue("Enabled",this,&LsysContext::setIncrementalDecompositionEnabled,true,"Rescan only the produced modules.");
+	option->setDefault(0);
+	/** profiling option */
+	option = options.add("Profiling","Set whether the duration of each stage of the iterations and statistics on rules are recorded during derivation.","Processing");
+	option->addValue("Disabled",this,&LsysContext::setProfilingEnabled,false,"Disable profiling.");
+	option->addValue("Enabled",this,&LsysContext::setProfilingEnabled,true,"Enable profiling.");
+	option->setDefault(0);
 	
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
 #if (PGL_VERSION >= 0x020B00)
@@ -398,6 +439,7 @@ LsysContext::clear(){
   m_selection_always_required = false;
   m_selection_requested = false;
   m_iteration_nb = 0;
+  m_random = RandomStream();
   m_animation_enabled = false;
   m_nbargs_of_endeach = 0;
   m_nbargs_of_end = 0;
@@ -437,8 +479,12 @@ LsysContext::declare(const std::string& modules)
 			    mod->setParameterNames(args);
 			}
 		}
-		else mod = ModuleClassTable::get().alias(it->name,it->parameters);
-		mod->activate(iscurrent);
+		else {
+			mod = ModuleClassTable::get().find(it->parameters);
+			if (!mod) LsysError("Undefined module '"+it->parameters+"' for alias.");
+			declareAlias(it->name,mod);
+		}
+		mod->activateOnThread(iscurrent);
 	}
 }
 
@@ -448,7 +494,7 @@ void LsysContext::declareModules(const ModuleClassList& other) {
 	bool iscurrent = isCurrent();
 	for(ModuleClassList::iterator it = m_modules.begin()+nb; it != m_modules.end(); ++it)
 	{
-		(*it)->activate(iscurrent);
+		(*it)->activateOnThread(iscurrent);
 	}
 }
 
@@ -472,12 +518,12 @@ LsysContext::undeclare(ModuleClassPtr module)
 	if (it == m_modules.end()) LsysError("Cannot undeclare module '"+module->name+"'. Not declared in this scope.");
 	else { 
 			m_modules.erase(it); 
-			if(module->m_vtable){
+			if(module->getVTable()){
 				ModuleVTableList::iterator it = 
-					find(m_modulesvtables.begin(),m_modulesvtables.end(),module->m_vtable);
-				m_modulesvtables.erase(it);
+					find(m_modulesvtables.begin(),m_modulesvtables.end(),ModuleVTablePtr(module->getVTable()));
+				if (it != m_modulesvtables.end()) m_modulesvtables.erase(it);
 			}
-			if (isCurrent())module->desactivate(); 
+			if (isCurrent())module->activateOnThread(false); 
 		 }
 }
 
@@ -496,7 +542,10 @@ bool LsysContext::isDeclared(ModuleClassPtr module)
 }
 
 void LsysContext::declareAlias(const std::string& alias, ModuleClassPtr module)
-{ m_aliases[alias] = module; }
+{ 
+	m_aliases[alias] = module; 
+	if (isCurrent()) ModuleClassTable::get().activateAlias(alias,module);
+}
 
 void LsysContext::setModuleScale(const std::string& modules, int scale)
 {
@@ -538,6 +587,7 @@ LsysContext::setObject(const std::string& name,
 					   const boost::python::object& o)
 {
   m_locals[name] = o;
+  ++m_namespaceversion;
 }
 
 void 
@@ -547,12 +597,14 @@ LsysContext::setObjectToGlobals(const std::string& name,
   PyObject * _globals = globals();
   assert(_globals != NULL);
   PyDict_SetItemString(_globals,name.c_str(),o.ptr());
+  ++m_namespaceversion;
 }
 
 void 
 LsysContext::delObject(const std::string& name) {
   if (m_locals.has_key(name)) m_locals[name].del();
   else PyDict_DelItemString(globals(),name.c_str());
+  ++m_namespaceversion;
 }
 
 bool 
@@ -575,6 +627,7 @@ LsysContext::copyObjectToGlobals(const std::string& name, LsysContext * sourceCo
 	if (obj == NULL) obj = PyDict_GetItemString(sourceContext->globals(),name.c_str());
 	if (obj == NULL) return false;
 	PyDict_SetItemString(globals(),name.c_str(),obj);
+	++m_namespaceversion;
 	return true;
 }
 
@@ -583,6 +636,7 @@ LsysContext::copyObjectToGlobals(const std::string& name, LsysContext * sourceCo
 void
 LsysContext::updateNamespace(const boost::python::dict& d){
   PyDict_Update(locals().ptr(),d.ptr());
+  ++m_namespaceversion;
 }
 
 void 
@@ -590,6 +644,7 @@ LsysContext::updateFromContextNamespace(const LsysContext& other)
 {
   PyDict_Update(locals().ptr(),other.locals().ptr());
   PyDict_Update(globals(),other.globals());
+  ++m_namespaceversion;
 }
 
 void
@@ -603,6 +658,7 @@ LsysContext::clearNamespace() {
 	m_locals.clear();
 	// PyDict_Clear(globals());
 	namespaceInitialisation();
+	++m_namespaceversion;
 }
 
 void 
@@ -944,6 +1000,7 @@ void LsysContext::setIterationNb(size_t val)
 {
     QWriteLocker ml(&m_iteration_nb_lock);
     m_iteration_nb = val; 
+    m_random.setIteration(uint32_t(val));
 }
 
 /*---------------------------------------------------------------------------*/
@@ -1079,6 +1136,7 @@ void
 LocalContext::clearNamespace() {
   m_locals.clear();
   namespaceInitialisation();
+  ++m_namespaceversion;
 }
 
 
@@ -34,6 +34,7 @@
 #include "axialtree.h"
 #include "lsysoptions.h"
 #include "paramproduction.h"
+#include "randomstream.h"
 #include "../plantgl/tool/util_hashset.h"
 #include <QtCore/QReadWriteLock>
 
@@ -49,6 +50,8 @@ class LPY_API LsysContext {
 public:
   friend class Lsystem;
   friend class ModuleVTable;
+  friend class PipelinedDerivation;
+  friend class StreamingDerivation;
 
   /** string value of python variable containing lsystem informations. */
   static const std::string InitialisationFunctionName;
@@ -158,6 +161,9 @@ public:
   bool copyObject(const std::string& name, LsysContext * sourceContext) ;
   bool copyObjectToGlobals(const std::string& name, LsysContext * sourceContext) ;
 
+  /// Incremented by the namespace management functions above, to invalidate values computed from the namespace.
+  inline size_t namespaceVersion() const { return m_namespaceversion; }
+
   /// protected access to python namespace. To be redefined.
   virtual boost::python::dict locals()  const { return m_locals; };
   virtual PyObject * globals()  const { return NULL; };
@@ -167,7 +173,7 @@ public:
   bool isCurrent() const ;
   void done() ;
 
-  /** static functions to access context */
+  /** static functions to access context. The current context is specific to the calling thread. */
   static inline LsysContext * currentContext() { return current(); }
   static LsysContext * current();
   static LsysContext * globalContext(); 
@@ -290,6 +296,18 @@ public:
   bool return_if_no_matching;
   inline void setReturnIfNoMatching(bool enabled) { return_if_no_matching = enabled; }
 
+  /// reuse derivation results stored in the derivation cache
+  bool derivation_cache;
+  inline void setDerivationCacheEnabled(bool enabled) { derivation_cache = enabled; }
+
+  /// rescan only the modules produced by the previous decomposition pass
+  bool incremental_decomposition;
+  inline void setIncrementalDecompositionEnabled(bool enabled) { incremental_decomposition = enabled; }
+
+  /// record timings and rule statistics of derivations
+  bool profiling;
+  inline void setProfilingEnabled(bool enabled) { profiling = enabled; }
+
   /// optimization level
   static const int DEFAULT_OPTIMIZATION_LEVEL;
   int optimizationLevel;
@@ -317,8 +335,19 @@ public:
 protected:
   void setIterationNb(size_t) ;
 
+  /** Reproducible random draws. The address of the draws is set by Lsystem. */
+public:
+  inline void setRandomSeed(uint64_t seed) { m_random.setSeed(seed); }
+  inline uint64_t getRandomSeed() const { return m_random.getSeed(); }
+  inline RandomStream& randomStream() { return m_random; }
+
+  inline double random() { return m_random.random(); }
+  inline double uniform(double a, double b) { return m_random.uniform(a,b); }
+  inline int64_t randint(int64_t a, int64_t b) { return m_random.randint(a,b); }
+
 protected:
   boost::python::dict m_locals;
+  size_t m_namespaceversion;
 
   boost::python::object controlMethod(const std::string&, AxialTree&);
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
@@ -375,6 +404,9 @@ protected:
   size_t m_iteration_nb;
   QReadWriteLock m_iteration_nb_lock;
 
+  /// random stream of the derivation
+  RandomStream m_random;
+
   size_t m_nbargs_of_starteach;
   size_t m_nbargs_of_start;
   size_t m_nbargs_of_endeach;
@@ -467,6 +499,15 @@ inline bool LPY_API isSelectionAlwaysRequired()
 inline size_t LPY_API getIterationNb()
 { return LsysContext::currentContext()->getIterationNb(); }
 
+inline double LPY_API lrandom()
+{ return LsysContext::currentContext()->random(); }
+
+inline double LPY_API luniform(double a, double b)
+{ return LsysContext::currentContext()->uniform(a,b); }
+
+inline int64_t LPY_API lrandint(int64_t a, int64_t b)
+{ return LsysContext::currentContext()->randint(a,b); }
+
 inline void LPY_API declare(const std::string& modules)
 { LsysContext::currentContext()->declare(modules); }
 
@@ -36,6 +36,9 @@
 #include "argcollector_core.h"
 #include <boost/version.hpp>
 #include <sstream>
+#include <cstdlib>
+#include <map>
+#include <algorithm>
 
 using namespace boost::python;
 LPY_USING_NAMESPACE
@@ -72,7 +75,14 @@ m_function(other.m_function),
 lineno(other.lineno),
 m_codelength(other.m_codelength),
 m_consider(other.m_consider),
-m_lstringmatcher(){
+m_lstringmatcher(),
+m_memo(other.m_memo?new ProductionCache(other.m_memo->maxSize()):NULL),
+m_native(other.m_native),
+m_probability(other.m_probability),
+m_probabilityexpr(other.m_probabilityexpr),
+m_probabilityoffset(other.m_probabilityoffset),
+m_alternativegroup(other.m_alternativegroup),
+m_tracked(sizeof(LsysRule)){
   IncTracker(LsysRule)
 }
 
@@ -85,7 +95,12 @@ m_hasquery(false),
 m_isStatic(false),
 lineno(_lineno),
 m_codelength(0),
-m_lstringmatcher(){
+m_lstringmatcher(),
+m_native(NULL),
+m_probability(-1),
+m_probabilityoffset(0),
+m_alternativegroup(0),
+m_tracked(sizeof(LsysRule)){
   IncTracker(LsysRule)
 }
 
@@ -123,6 +138,12 @@ void LsysRule::clear(){
   m_codelength = 0;
   m_consider = ConsiderFilterPtr();
   m_lstringmatcher = LstringMatcherPtr();
+  m_memo = ProductionCachePtr();
+  m_native = NULL;
+  m_probability = -1;
+  m_probabilityexpr.clear();
+  m_probabilityoffset = 0;
+  m_alternativegroup = 0;
 }
 
 std::string LsysRule::str() const {
@@ -202,6 +223,16 @@ LsysRule::getCode() {
 }
 
 
+bool LsysRule::isPythonFree() const
+{
+	if (!m_isStatic || m_hasquery) return false;
+	const PatternString * patterns[] = { &m_leftcontext, &m_newleftcontext, &m_predecessor, &m_newrightcontext, &m_rightcontext };
+	for (size_t i = 0; i < 5; ++i)
+		for (PatternString::const_iterator it = patterns[i]->const_begin(); it != patterns[i]->const_end(); ++it)
+			if (it->size() > 0) return false;
+	return true;
+}
+
 void LsysRule::setStatic()
 {
   if(!m_isStatic){
@@ -224,17 +255,21 @@ void LsysRule::setStatic()
 
 std::string 
 LsysRule::getCallerCode() const{
+  if (m_native) return "";
   if (m_nbParams <= MAX_LRULE_DIRECT_ARITY) return "";
   std::stringstream res;
   res << "def " << callerFunctionName() << "(args=[]) : return " << functionName() << "(*args)\n";
   return res.str();
 }
 void LsysRule::compile(){
+	if (m_native) return;
 	if (!isCompiled()){ recompile(); }
 	else LsysWarning("Python code already imported.");
 }
 
 void LsysRule::recompile(){
+	initProbability();
+	if (m_native) return;
 	std::string fname = (m_nbParams<=MAX_LRULE_DIRECT_ARITY?functionName():callerFunctionName());
 	  m_function = LsysContext::currentContext()->compile(fname,getCode());
       // LsysContext::currentContext()->getObject(fname);
@@ -244,6 +279,8 @@ void LsysRule::recompile(){
 }
 
 void LsysRule::importPyFunction(){
+	initProbability();
+	if (m_native) return;
 	if (!isCompiled()){
       m_function = LsysContext::currentContext()->getObject(m_nbParams<=MAX_LRULE_DIRECT_ARITY?functionName():callerFunctionName());
       // m_function = LsysContext::currentContext()->getObject(functionName());
@@ -252,6 +289,78 @@ void LsysRule::importPyFunction(){
 	else LsysWarning("Python code already imported.");
 }
 
+void LsysRule::rebindPyFunction(){
+	initProbability();
+	if (!m_native && isCompiled())
+      m_function = LsysContext::currentContext()->getObject(m_nbParams<=MAX_LRULE_DIRECT_ARITY?functionName():callerFunctionName());
+}
+
+void LsysRule::setMemoized(bool enabled){
+  if (!enabled) m_memo = ProductionCachePtr();
+  else if (!m_memo) m_memo = ProductionCachePtr(new ProductionCache());
+}
+
+void LsysRule::setProbability(const std::string& expression){
+  m_probabilityexpr = expression;
+  if (expression.empty()) { m_probability = -1; return; }
+  // constant probabilities are known at once
+  char * end = NULL;
+  double value = strtod(expression.c_str(),&end);
+  while (end != NULL && isspace(*end)) ++end;
+  if (end != NULL && *end == '\0') setProbability(value);
+  else m_probability = 0;
+}
+
+void LsysRule::setProbability(double probability){
+  if (probability < 0 || probability > 1) {
+	  std::stringstream msg;
+	  msg << "Invalid probability " << probability << " for rule " << name() << ".";
+	  LsysError(msg.str(),"",lineno);
+  }
+  m_probability = probability;
+}
+
+void LsysRule::initProbability(){
+  if (m_probabilityexpr.empty()) return;
+  object value = LsysContext::currentContext()->evaluate(m_probabilityexpr);
+  if (PyErr_Occurred()) throw_error_already_set();
+  extract<double> probability(value);
+  if (!probability.check()) LsysError("Probability '"+m_probabilityexpr+"' of rule "+name()+" is not a number.","",lineno);
+  setProbability(probability());
+}
+
+/// Key of the alternatives of a rule: classes and arities of its predecessor and contexts.
+static void appendSignature(std::stringstream& key, const PatternString& pattern)
+{
+  for (PatternString::const_iterator it = pattern.const_begin(); it != pattern.const_end(); ++it)
+	  key << it->getClassId() << '/' << it->size() << ' ';
+  key << '|';
+}
+
+void LPY::setProbabilityIntervals(RuleSet& rules, uint32_t& nextgroup){
+  typedef std::map<std::string, std::pair<uint32_t, double> > GroupMap;
+  GroupMap groups;
+  for (RuleSet::iterator it = rules.begin(); it != rules.end(); ++it) {
+	  if (!it->isStochastic()) continue;
+	  std::stringstream key;
+	  appendSignature(key, it->leftContext());
+	  appendSignature(key, it->newLeftContext());
+	  appendSignature(key, it->predecessor());
+	  appendSignature(key, it->newRightContext());
+	  appendSignature(key, it->rightContext());
+	  GroupMap::iterator group = groups.find(key.str());
+	  if (group == groups.end()) group = groups.insert(GroupMap::value_type(key.str(), std::make_pair(nextgroup++, 0.0))).first;
+	  it->m_alternativegroup = group->second.first;
+	  it->m_probabilityoffset = group->second.second;
+	  group->second.second += it->getProbability();
+	  if (group->second.second > 1 + 1e-9) {
+		  std::stringstream msg;
+		  msg << "Probabilities of the alternatives of rule " << it->name() << " sum to " << group->second.second << ", more than 1.";
+		  LsysError(msg.str(),"",it->lineno);
+	  }
+  }
+}
+
 void LsysRule::initStaticProduction(){
   if(m_isStatic){
 	  m_isStatic = false;
@@ -288,27 +397,28 @@ void LsysRule::precall_function( size_t nbargs, const ArgList& args ) const
 
 AxialTree LsysRule::postcall_function( boost::python::object res, bool * isApplied ) const
 {
+  LsysContext * context = LsysContext::currentContext();
   if (res == object()) 
   { 
       // no production. look for nproduction
-      AxialTree nprod = LsysContext::currentContext()->get_nproduction(); 
+      AxialTree nprod = context->get_nproduction(); 
 	  if (nprod.empty()) {
 		  if(isApplied != NULL) *isApplied = false;
 		  return AxialTree();
 	  }
       else { 
 		  if(isApplied != NULL) *isApplied = true;
-          LsysContext::currentContext()->reset_nproduction(); // to avoid deep copy
+          context->reset_nproduction(); // to avoid deep copy
           return nprod;
       }
   }
   else {
 	 if(isApplied != NULL) *isApplied = true;
       // production. add nproduction if needed
-      AxialTree nprod = LsysContext::currentContext()->get_nproduction(); 
+      AxialTree nprod = context->get_nproduction(); 
       AxialTree pres = AxialTree(extract<boost::python::list>(res));
       if (!nprod.empty()){
-          LsysContext::currentContext()->reset_nproduction(); //  to avoid deep copy
+          context->reset_nproduction(); //  to avoid deep copy
           nprod += pres;
           return nprod;
       }
@@ -350,12 +460,30 @@ LsysRule::apply( const ArgList& args, bool * isApplied ) const
     if(isApplied) *isApplied = true;
 	return m_staticResult;
   }
+  if (m_native) return m_native->apply(args,isApplied);
   if (!isCompiled()) LsysError("Python code of rule not compiled");
 
+  object key;
+  if (m_memo) {
+	  key = ProductionCache::key(args);
+	  bool applied = false;
+	  AxialTree production;
+	  if (key != object() && m_memo->get(key,production,applied)) {
+		  if(isApplied) *isApplied = applied;
+		  return production;
+	  }
+  }
+
   LstringMatcherMaintainer m(m_lstringmatcher);
   size_t argsize = len(args);
   precall_function(argsize,args);
-  return postcall_function(call_function(argsize,args),isApplied); 
+  if (key == object()) return postcall_function(call_function(argsize,args),isApplied); 
+
+  bool applied = false;
+  AxialTree production = postcall_function(call_function(argsize,args),&applied);
+  m_memo->set(key,production,applied);
+  if(isApplied) *isApplied = applied;
+  return production;
 }
 
 
@@ -367,6 +495,7 @@ LsysRule::apply( bool * isApplied ) const
     if(isApplied) *isApplied = true;
 	return m_staticResult;
   }
+  if (m_native) return m_native->apply(ArgList(),isApplied);
   if (!isCompiled()) LsysError("Python code of rule not compiled");
 
   LstringMatcherMaintainer m(m_lstringmatcher);
@@ -460,9 +589,11 @@ void LsysRule::keepOnlyRelevantVariables()
 
 
 bool
-LsysRule::match(const AxialTree& src,
+LsysRule::match(AxialTree::const_iterator srcbeg,
+			   AxialTree::const_iterator srcend,
 			   AxialTree::const_iterator pos,
 			   const AxialTree& dest,
+			   size_t destsize,
 			   AxialTree::const_iterator& endpos,
                ArgList& args,
                eDirection direction) const 
@@ -475,24 +606,24 @@ LsysRule::match(const AxialTree& src,
 
   // strict predecessor
   if (direction == eForward){
-   if(!MatchingEngine::match(pos,src.const_begin(),src.const_end(),m_predecessor.const_begin(),m_predecessor.const_end(),endpos1,last_match,args_pred)){
+   if(!MatchingEngine::match(pos,srcbeg,srcend,m_predecessor.const_begin(),m_predecessor.const_end(),endpos1,last_match,args_pred)){
 	 return false;
    }
   }
   else{
     AxialTree::const_iterator tmp;
-    if(!MatchingEngine::reverse_match(pos,src.const_begin(),src.const_end(),
+    if(!MatchingEngine::reverse_match(pos,srcbeg,srcend,
 		                              m_predecessor.const_rbegin(),m_predecessor.const_rend(),
 									  tmp,args_pred))
  	   return false;
-    endpos1 = (pos == src.end()?pos:pos+1);
+    endpos1 = (pos == srcend?pos:pos+1);
     pos = tmp;
   }
 
   // left context
   AxialTree::const_iterator endposLeft = (direction == eForward?pos:pos+1);
   if(!m_leftcontext.empty()){
-      if(!MatchingEngine::left_match(endposLeft,src.const_begin(),src.const_end(),
+      if(!MatchingEngine::left_match(endposLeft,srcbeg,srcend,
 		                              m_leftcontext.const_rbegin(),m_leftcontext.const_rend(),
 									  endposLeft,args))
 	       return false;
@@ -505,7 +636,7 @@ LsysRule::match(const AxialTree& src,
     // Here we do a hack to add the current element to the new string to have scale information.
     AxialTree *dest2 = const_cast<AxialTree *>(&dest);
     dest2->push_back(pos);
-    if(!MatchingEngine::left_match(dest2->const_end()-1,dest2->const_begin(),dest2->const_end(),
+    if(!MatchingEngine::left_match(dest2->const_end()-1,dest2->const_end()-1-std::min(destsize,dest.size()-1),dest2->const_end(),
 		                          m_newleftcontext.const_rbegin(),m_newleftcontext.const_rend(),
 								  endposNewLeft,args_ncg)){
         dest2->erase(dest2->end()-1);
@@ -534,13 +665,13 @@ LsysRule::match(const AxialTree& src,
   AxialTree::const_iterator endposRightLastMatch = last_match;
   if(!m_rightcontext.empty()){
 	ArgList args_cd;
-    if(!MatchingEngine::right_match(endposRight,src.const_begin(),src.const_end(),
+    if(!MatchingEngine::right_match(endposRight,srcbeg,srcend,
 		                          m_rightcontext.const_begin(),m_rightcontext.const_end(),
 								  endposRightLastMatch,endposRight,args_cd))return false;
 	ArgsCollector::append_args(args,args_cd);
   }
-  const_cast<LsysRule *>(this)->m_lstringmatcher = LstringMatcherPtr(new LstringMatcher(src.const_begin(),	
-					   src.const_end(),
+  const_cast<LsysRule *>(this)->m_lstringmatcher = LstringMatcherPtr(new LstringMatcher(srcbeg,	
+					   srcend,
 					   endposLeft,
 					   // endposNewLeft,
 					   endposRight,
@@ -617,6 +748,13 @@ LsysRule::ignore(const std::string& modules)
 
 /*---------------------------------------------------------------------------*/
 
+static bool arePythonFree(const RulePtrSet& rules)
+{
+	for(RulePtrSet::const_iterator it = rules.begin(); it != rules.end(); ++it)
+		if (!(*it)->isPythonFree()) return false;
+	return true;
+}
+
 RulePtrMap::RulePtrMap(const RulePtrSet& rules, eDirection direction):
 	m_map(ModuleClass::getMaxId()), m_nbrules(rules.size()), m_maxsmb(0)
 {
@@ -654,10 +792,13 @@ RulePtrMap::RulePtrMap(const RulePtrSet& rules, eDirection direction):
 	}
 	// we check for now how much symbol are included
 	m_maxsmb = m_map.size();
+	m_pythonfree.resize(m_maxsmb);
+	for(size_t id = 0; id < m_maxsmb; ++id) m_pythonfree[id] = arePythonFree(m_map[id]);
+	m_defaultpythonfree = arePythonFree(m_defaultset);
 }
 
 RulePtrMap::RulePtrMap():
-	m_map(0), m_nbrules(0), m_maxsmb(0)
+	m_map(0), m_nbrules(0), m_maxsmb(0), m_defaultpythonfree(true)
 {
 }
 
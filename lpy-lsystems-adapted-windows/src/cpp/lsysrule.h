@@ -36,6 +36,9 @@
 #include "paramproduction.h"
 #include "lstringmatcher.h"
 #include "consider.h"
+#include "productioncache.h"
+#include "nativerule.h"
+#include "randomstream.h"
 
 LPY_BEGIN_NAMESPACE
 
@@ -63,14 +66,20 @@ public:
 	inline size_t getGroupId() const { return m_gid; }
 	inline void setGroupId(size_t id) { m_gid = id; }
 
+	/// identifier of the rule in the addresses of the random draws (see RandomStream).
+	inline uint32_t getStreamId() const 
+	{ return (uint32_t(m_prefix) << 24) ^ (uint32_t(m_gid) << 16) ^ uint32_t(m_id); }
+
 	AxialTree apply(bool * isApplied = NULL) const;
 	AxialTree apply( const ArgList& args, bool * isApplied = NULL ) const ;
 //	boost::python::object apply( const boost::python::tuple& args ) const;
 
-	inline bool isCompiled() const {  return m_function != boost::python::object(); }
+	inline bool isCompiled() const {  return m_native != NULL || m_function != boost::python::object(); }
 	void compile();
 	void recompile();
 	void importPyFunction();
+	/// replace the compiled function by the one of same name in the current namespace.
+	void rebindPyFunction();
 
 	void clear();
 	
@@ -118,11 +127,23 @@ public:
     inline bool isCompatible(eDirection direction) const 
         { return (direction == eForward? forwardCompatible() : backwardCompatible()); }
 
-	bool match(const AxialTree& src,
+	inline bool match(const AxialTree& src,
 			   AxialTree::const_iterator pos,
 			   const AxialTree& dest,
 			   AxialTree::const_iterator& endpos,
 			   ArgList& args,
+               eDirection direction = eForward) const 
+	{ return match(src.const_begin(),src.const_end(),pos,dest,dest.size(),endpos,args,direction); }
+
+	/** Match restricted to the modules of src in [srcbeg,srcend) and, for the new left context, 
+		to the last destsize modules of dest. Used to match on a window of a string. */
+	bool match(AxialTree::const_iterator srcbeg,
+			   AxialTree::const_iterator srcend,
+			   AxialTree::const_iterator pos,
+			   const AxialTree& dest,
+			   size_t destsize,
+			   AxialTree::const_iterator& endpos,
+			   ArgList& args,
                eDirection direction = eForward) const ;
 
     inline bool reverse_match(const AxialTree& src,
@@ -167,11 +188,41 @@ public:
 	inline bool isStatic() const { return m_isStatic; }
 	inline AxialTree getStaticProduction() const { return m_staticResult; }
 
+	/** A static rule whose patterns have no parameters is matched on module classes and
+	    applied by copying its production, without touching any python object. */
+	bool isPythonFree() const;
+
+	/// A memoized rule is assumed pure: its productions are cached by argument values.
+	void setMemoized(bool enabled);
+	inline bool isMemoized() const { return m_memo != NULL; }
+	inline ProductionCachePtr getProductionCache() const { return m_memo; }
+
+	/** A stochastic rule is selected with its probability among the stochastic rules with the same 
+		predecessor and contexts, in their order of declaration, before matching. The probability is 
+		a python expression evaluated when the code of the lsystem is imported. It is given as '@prob(expr)' 
+		after the ':' or the '-->' of the rule. The intervals of the alternatives are set by the owning 
+		Lsystem once its rules are built (see setProbabilityIntervals). */
+	void setProbability(const std::string& expression);
+	void setProbability(double probability);
+	inline bool isStochastic() const { return m_probability >= 0; }
+	inline double getProbability() const { return m_probability; }
+	inline const std::string& getProbabilityExpression() const { return m_probabilityexpr; }
+
+	/// The rule is selected if the draw of its alternatives falls in [offset, offset+probability).
+	inline double getProbabilityOffset() const { return m_probabilityoffset; }
+	/// Identifier of the draw shared by the rule and its alternatives.
+	inline uint32_t getAlternativeGroup() const { return m_alternativegroup; }
+
+	/// A native rule is bound to a function of a plugin library and has no python code.
+	inline bool isNative() const { return m_native != NULL; }
+	inline const NativeRule * nativeRule() const { return m_native; }
+
 protected:
 
 	void parseHeader( const std::string& name);
 	void parseParameters();
 	void initStaticProduction();
+	void initProbability();
 
 	size_t m_id;
 	size_t m_gid;
@@ -191,8 +242,17 @@ protected:
 	uint32_t m_codelength;
 	ConsiderFilterPtr m_consider;
 	LstringMatcherPtr m_lstringmatcher;
+	ProductionCachePtr m_memo;
+	const NativeRule * m_native;
+	double m_probability;
+	std::string m_probabilityexpr;
+	double m_probabilityoffset;
+	uint32_t m_alternativegroup;
+	TrackedInstance<Tracker::eLsysRule> m_tracked;
 
 private:
+	friend void setProbabilityIntervals(std::vector<LsysRule>& rules, uint32_t& nextgroup);
+
     void precall_function( size_t nbargs = 0 ) const;
     void precall_function( size_t nbargs,  const ArgList& obj ) const;
     boost::python::object call_function( size_t nbargs,  const ArgList& obj ) const;
@@ -205,6 +265,10 @@ private:
 typedef std::vector<LsysRule> RuleSet;
 typedef std::vector<const LsysRule *> RulePtrSet;
 
+/** Group the stochastic rules of rules by predecessor and contexts and set their probability intervals.
+	Groups are numbered from nextgroup. Raise an error if the probabilities of a group sum to more than 1. */
+void setProbabilityIntervals(RuleSet& rules, uint32_t& nextgroup);
+
 /*---------------------------------------------------------------------------*/
 
 class RulePtrMap {
@@ -219,12 +283,49 @@ public:
 	inline bool empty() const {  return m_nbrules == 0; }
 	inline size_t size() const { return m_nbrules; }
 
+	/// True if all the rules of a module class are python free, so that the GIL can be released.
+	inline bool isPythonFree(size_t id) const 
+	{ return (id < m_maxsmb?m_pythonfree[id]:m_defaultpythonfree); }
+
 protected:
 	RulePtrSetMap m_map;
 	RulePtrSet m_defaultset;
 	size_t m_nbrules;
 	size_t m_maxsmb;
+	std::vector<bool> m_pythonfree;
+	bool m_defaultpythonfree;
+
+};
+
+/*---------------------------------------------------------------------------*/
+
+/** 
+	Selection of the stochastic rule applied on a module. A single draw is made per module 
+	and group of alternatives (same predecessor and contexts), and falls in the probability 
+	interval of at most one rule of the group. Other rules of the group are skipped without 
+	being matched.
+*/
+class StochasticSelection {
+public:
+	StochasticSelection(const RandomStream& stream, size_t position) :
+		m_stream(stream), m_position(position), m_group(0), m_draw(-1) {}
+
+	inline bool isSelected(const LsysRule * rule) {
+		if (!rule->isStochastic()) return true;
+		// alternatives are usually consecutive in the rule set
+		if (m_draw < 0 || m_group != rule->getAlternativeGroup()) {
+			m_group = rule->getAlternativeGroup();
+			m_draw = m_stream.uniformAt(m_position, RandomStream::SelectionStream, m_group);
+		}
+		double low = rule->getProbabilityOffset();
+		return low <= m_draw && m_draw < low + rule->getProbability();
+	}
 
+protected:
+	const RandomStream& m_stream;
+	size_t m_position;
+	uint32_t m_group;
+	double m_draw;
 };
 
 /*---------------------------------------------------------------------------*/
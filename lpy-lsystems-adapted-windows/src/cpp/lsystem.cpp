@@ -31,6 +31,9 @@
 #define BOOST_PYTHON_STATIC_LIB
 #include "lsystem.h"
 #include "tracker.h"
+#include "gilrelease.h"
+#include "derivationcache.h"
+#include "compilation.h"
 #include <QtCore/QThread>
 #include <QtCore/QFileInfo>
 #include <QtCore/QDir>
@@ -141,7 +144,9 @@ m_decomposition_max_depth(1),
 m_interpretation_max_depth(1),
 m_currentGroup(0),
 m_context(),
-m_newrules(false)
+m_newrules(false),
+m_observer(NULL),
+m_busythread(NULL)
 #ifdef MULTI_THREADED_LSYSTEM
 ,m_ressource(new LsysRessource())
 #endif
@@ -157,7 +162,9 @@ m_max_derivation(1),
 m_decomposition_max_depth(1),
 m_interpretation_max_depth(1),
 m_context(),
-m_newrules(false)
+m_newrules(false),
+m_observer(NULL),
+m_busythread(NULL)
 #ifdef MULTI_THREADED_LSYSTEM
 ,m_ressource(new LsysRessource())
 #endif
@@ -173,7 +180,9 @@ m_max_derivation(1),
 m_decomposition_max_depth(1),
 m_interpretation_max_depth(1),
 m_context(),
-m_newrules(false)
+m_newrules(false),
+m_observer(NULL),
+m_busythread(NULL)
 #ifdef MULTI_THREADED_LSYSTEM
 ,m_ressource(new LsysRessource())
 #endif
@@ -189,7 +198,26 @@ m_max_derivation(lsys.m_max_derivation),
 m_decomposition_max_depth(lsys.m_decomposition_max_depth),
 m_interpretation_max_depth(lsys.m_interpretation_max_depth),
 m_context(lsys.m_context),
-m_newrules(lsys.m_newrules)
+m_newrules(lsys.m_newrules),
+m_observer(NULL),
+m_busythread(NULL)
+#ifdef MULTI_THREADED_LSYSTEM
+,m_ressource(new LsysRessource())
+#endif
+{
+  IncTracker(Lsystem)
+  PRINT_RESSOURCE("create")
+}
+
+Lsystem::Lsystem(const boost::python::dict& globals):
+m_max_derivation(1),
+m_decomposition_max_depth(1),
+m_interpretation_max_depth(1),
+m_currentGroup(0),
+m_context(globals),
+m_newrules(false),
+m_observer(NULL),
+m_busythread(NULL)
 #ifdef MULTI_THREADED_LSYSTEM
 ,m_ressource(new LsysRessource())
 #endif
@@ -208,6 +236,70 @@ Lsystem& Lsystem::operator=(const Lsystem& lsys)
     return *this;
 }
 
+/* Shallow copy of a namespace in which the functions defined in the namespace use the copy as globals. */
+static boost::python::dict copy_namespace(PyObject * source)
+{
+  boost::python::dict result(handle<>(PyDict_Copy(source)));
+  PyObject * key, * value;
+  Py_ssize_t pos = 0;
+  while (PyDict_Next(source, &pos, &key, &value)) {
+	  if (!PyFunction_Check(value) || PyFunction_GetGlobals(value) != source) continue;
+	  object function(handle<>(PyFunction_New(PyFunction_GetCode(value), result.ptr())));
+	  if (PyFunction_GetDefaults(value)) PyFunction_SetDefaults(function.ptr(), PyFunction_GetDefaults(value));
+	  if (PyFunction_GetClosure(value)) PyFunction_SetClosure(function.ptr(), PyFunction_GetClosure(value));
+#if PY_VERSION_HEX >= 0x03000000
+	  if (PyFunction_GetKwDefaults(value)) PyFunction_SetKwDefaults(function.ptr(), PyFunction_GetKwDefaults(value));
+#endif
+	  object original(handle<>(borrowed(value)));
+	  function.attr("__name__") = object(original.attr("__name__"));
+	  function.attr("__doc__") = object(original.attr("__doc__"));
+	  function.attr("__dict__").attr("update")(object(original.attr("__dict__")));
+	  result[object(handle<>(borrowed(key)))] = function;
+  }
+  return result;
+}
+
+Lsystem * 
+Lsystem::clone(bool isolatedNamespace) const
+{
+  boost::python::dict globals;
+  if (isolatedNamespace) globals = copy_namespace(m_context.globals());
+  else globals = boost::python::dict(handle<>(borrowed(m_context.globals())));
+
+  Lsystem * lsys = new Lsystem(globals);
+  lsys->m_axiom = m_axiom;
+  lsys->m_rules = m_rules;
+  lsys->m_max_derivation = m_max_derivation;
+  lsys->m_decomposition_max_depth = m_decomposition_max_depth;
+  lsys->m_interpretation_max_depth = m_interpretation_max_depth;
+  lsys->m_currentGroup = m_currentGroup;
+  lsys->m_newrules = m_newrules;
+  lsys->m_sourcekey = m_sourcekey;
+  lsys->m_derivationcachekey = m_derivationcachekey;
+  lsys->m_source = m_source;
+  lsys->m_sourceparameters = m_sourceparameters;
+
+  LsysContext& context = lsys->m_context;
+  static_cast<LsysContext&>(context) = m_context;
+  context.m_modules = m_context.m_modules;
+  context.m_modulesvtables = m_context.m_modulesvtables;
+  context.m_aliases = m_context.m_aliases;
+  for(LsysOptions::const_iterator src = m_context.options.begin(), dst = context.options.begin(); 
+	  src != m_context.options.end() && dst != context.options.end(); ++src, ++dst)
+	  (*dst)->setSelection((*src)->getCurrentValueId());
+
+  if (isolatedNamespace) {
+	  ContextMaintainer m(&context);
+	  for (RuleGroupList::iterator g = lsys->m_rules.begin(); g != lsys->m_rules.end(); ++g) {
+		  for (RuleSet::iterator i = g->production.begin(); i != g->production.end(); ++i) i->rebindPyFunction();
+		  for (RuleSet::iterator i = g->decomposition.begin(); i != g->decomposition.end(); ++i) i->rebindPyFunction();
+		  for (RuleSet::iterator i = g->interpretation.begin(); i != g->interpretation.end(); ++i) i->rebindPyFunction();
+	  }
+	  lsys->initProbabilityIntervals();
+  }
+  return lsys;
+}
+
 Lsystem::RuleGroup& Lsystem::group(size_t group_)
 {
     if (group_ >= m_rules.size()){
@@ -226,7 +318,11 @@ const Lsystem::RuleGroup& Lsystem::group(size_t group_) const
 Lsystem::~Lsystem()
 {
  DecTracker(Lsystem)
- clear();
+ {
+   // no busy check: the lsystem is going away in any case
+   ACQUIRE_RESSOURCE
+   clearLsys();
+ }
 #ifdef MULTI_THREADED_LSYSTEM
  delete m_ressource;
 #endif
@@ -234,8 +330,16 @@ Lsystem::~Lsystem()
  PRINT_RESSOURCE("delete")
 }
 
+void 
+Lsystem::checkNotBusy() const {
+  const QThread * thread = m_busythread.load();
+  if (thread != NULL && thread != QThread::currentThread())
+	LsysError("Lsystem is being derived by a DerivationTask. Wait for its end or cancel it first.");
+}
+
 void 
 Lsystem::clear(){
+  checkNotBusy();
   ACQUIRE_RESSOURCE
   clearLsys();
   RELEASE_RESSOURCE
@@ -243,6 +347,9 @@ Lsystem::clear(){
 void 
 Lsystem::clearLsys(){
   m_axiom.clear();
+  m_sourcekey.clear();
+  m_source.clear();
+  m_sourceparameters = boost::python::dict();
   m_rules.clear();
   m_max_derivation = 1;
   m_decomposition_max_depth = 1;
@@ -383,6 +490,7 @@ Lsystem::compile(){
       for (i = g->interpretation.begin();  i != g->interpretation.end(); ++i)
           i->compile();
   }
+  initProbabilityIntervals();
   RELEASE_RESSOURCE
 }
 
@@ -399,6 +507,18 @@ Lsystem::importPyFunctions(){
       for ( i = g->interpretation.begin();  i != g->interpretation.end(); ++i)
           i->importPyFunction();
   }
+  initProbabilityIntervals();
+}
+
+void 
+Lsystem::initProbabilityIntervals(){
+  uint32_t nextgroup = 0;
+  for (RuleGroupList::iterator g = m_rules.begin(); g != m_rules.end(); ++g)
+  {
+      setProbabilityIntervals(g->production, nextgroup);
+      setProbabilityIntervals(g->decomposition, nextgroup);
+      setProbabilityIntervals(g->interpretation, nextgroup);
+  }
 }
 
 #include <fstream>
@@ -518,6 +638,7 @@ Lsystem::addProductionRule( const std::string& code, size_t group_, const Consid
   ContextMaintainer m(&m_context);
   LsysRule& r = addProductionRule(code,group_,-1,filter);
   r.compile();
+  initProbabilityIntervals();
   // RELEASE_RESSOURCE
 }
 
@@ -527,6 +648,7 @@ Lsystem::addDecompositionRule( const std::string& code, size_t group_, const Con
   ContextMaintainer m(&m_context);
   LsysRule& r = addDecompositionRule(code,group_,-1,filter);
   r.compile();
+  initProbabilityIntervals();
   // RELEASE_RESSOURCE
 }
 
@@ -536,6 +658,7 @@ Lsystem::addInterpretationRule( const std::string& code, size_t group_, const Co
   ContextMaintainer m(&m_context);
   LsysRule& r = addInterpretationRule(code,group_,-1,filter);
   r.compile();
+  initProbabilityIntervals();
   // RELEASE_RESSOURCE
 }
 
@@ -556,14 +679,18 @@ Lsystem::addRule(  const LsysRule& rule, int type, size_t groupid){
     if (rule.hasQuery())group(groupid).m_prodhasquery = true;
 	break;
   }
+  initProbabilityIntervals();
   m_newrules = true;
 }
 
 void Lsystem::addRule( const std::string& rule, int type, size_t group_, const ConsiderFilterPtr filter ){
 	m_newrules = true;
+	m_sourcekey.clear();
+	m_source.clear();
     ContextMaintainer m(&m_context);
     LsysRule& r = addRule(rule,type,group_,-1,filter);
 	r.compile();
+	initProbabilityIntervals();
 }
 
 bool 
@@ -651,13 +778,31 @@ pgl_hash_map_string<std::string> Lsystem::get_rule_fonction_table() const
   return result;
 }
 
-RulePtrMap Lsystem::getRules(eRuleType type, size_t groupid, eDirection direction, bool * hasQuery)
+void Lsystem::clearProductionCaches()
+{
+  for(RuleGroupList::iterator it = m_rules.begin(); it != m_rules.end(); ++it)
+	{
+		for(RuleSet::iterator itr = it->production.begin(); itr != it->production.end(); ++itr)
+			if (itr->isMemoized()) itr->getProductionCache()->clear();
+		for(RuleSet::iterator itr = it->decomposition.begin(); itr != it->decomposition.end(); ++itr)
+			if (itr->isMemoized()) itr->getProductionCache()->clear();
+		for(RuleSet::iterator itr = it->interpretation.begin(); itr != it->interpretation.end(); ++itr)
+			if (itr->isMemoized()) itr->getProductionCache()->clear();
+	}
+}
+
+/// A rule is local if its application on a module depends only on this module.
+static inline bool isLocalRule(const LsysRule& rule)
+{ return rule.isContextFree() && rule.predecessor().size() == 1 && !rule.isStochastic() && !rule.hasQuery(); }
+
+RulePtrMap Lsystem::getRules(eRuleType type, size_t groupid, eDirection direction, bool * hasQuery, bool * isLocal)
 {
     if(hasQuery)*hasQuery = false;
+    if(isLocal)*isLocal = true;
  	size_t nbgroups = m_rules.size();
     if (groupid >= nbgroups) {
 		if (nbgroups == 0) return RulePtrMap();
-		else return getRules(type,0,direction,hasQuery);
+		else return getRules(type,0,direction,hasQuery,isLocal);
 	}
     RulePtrSet result;
     const RuleSet& rules = group(groupid).getGroup(type);
@@ -665,6 +810,7 @@ RulePtrMap Lsystem::getRules(eRuleType type, size_t groupid, eDirection directio
         if(itr->isCompatible(direction)){
             result.push_back(&(*itr));
             if(hasQuery && itr->hasQuery())*hasQuery = true;
+            if(isLocal && !isLocalRule(*itr))*isLocal = false;
         }
     if (groupid > 0)
     {
@@ -673,6 +819,7 @@ RulePtrMap Lsystem::getRules(eRuleType type, size_t groupid, eDirection directio
             if(itr->isCompatible(direction)){
                 result.push_back(&(*itr));
                 if(hasQuery && itr->hasQuery())*hasQuery = true;
+                if(isLocal && !isLocalRule(*itr))*isLocal = false;
             }
     }
     return RulePtrMap(result,direction);
@@ -704,12 +851,15 @@ AxialTree Lsystem::debugStep(AxialTree& workingstring,
           else{
               int match = 0;
 			  const RulePtrSet& mruleset = ruleset[_it->getClassId()];
+              StochasticSelection selection(m_context.randomStream(), _it - workingstring.const_begin());
               for(RulePtrSet::const_iterator _it2 = mruleset.begin();
                   _it2 != mruleset.end(); _it2++){
+					  if(!selection.isSelected(*_it2)) continue;
 					  ArgList args;
 					  size_t prodlength;
                       if((*_it2)->match(workingstring,_it,targetstring,_it3,args)){
 						  try {
+							m_context.randomStream().setAddress(_it - workingstring.const_begin(), (*_it2)->getStreamId());
 							match = (*_it2)->applyTo(targetstring,args,&prodlength);
 						  }catch(error_already_set){
 							  if(!debugger.error_match(_it,_it3,targetstring,*_it2,args)){
@@ -743,12 +893,15 @@ AxialTree Lsystem::debugStep(AxialTree& workingstring,
       while ( _it !=  _end) {
           bool match = false;
 		  const RulePtrSet& mruleset = ruleset[_it->getClassId()];
+          StochasticSelection selection(m_context.randomStream(), _it - workingstring.const_begin());
           for(RulePtrSet::const_iterator _it2 = mruleset.begin();
               _it2 != mruleset.end();  _it2++){
+				  if(!selection.isSelected(*_it2)) continue;
 				  ArgList args;
 				  size_t prodlength;
                   if((*_it2)->reverse_match(workingstring,_it,targetstring,_it3,args)){
 					  try {
+						m_context.randomStream().setAddress(_it - workingstring.const_begin(), (*_it2)->getStreamId());
 						match = (*_it2)->reverseApplyTo(targetstring,args,&prodlength);
 					  }catch(error_already_set){
 						if(!debugger.error_match(_it3==_end?_beg:_it3+1,_it+1,targetstring,*_it2,args))
@@ -791,22 +944,33 @@ Lsystem::step(AxialTree& workingstring,
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
   if ( query )turtle_interpretation(workingstring,m_context.envturtle);
 #endif
+  DerivationProfiler * profiler = activeProfiler();
+  GilReleaser gil;
   if ( direction == eForward){
       AxialTree::const_iterator _it = workingstring.begin();
       AxialTree::const_iterator _it3 = _it;
       AxialTree::const_iterator _endit = workingstring.end();
 
       while ( _it != _endit ) {
-          if ( _it->isCut() )
+          if ( _it->isCut() ){
+              gil.native();
               _it = workingstring.endBracket(_it);
+          }
           else{
               bool match = false;
 			  const RulePtrSet& mruleset = ruleset[_it->getClassId()];
+			  if (ruleset.isPythonFree(_it->getClassId())) gil.native(); else gil.python();
+              StochasticSelection selection(m_context.randomStream(), _it - workingstring.const_begin());
               for(RulePtrSet::const_iterator _it2 = mruleset.begin();
                   _it2 != mruleset.end(); _it2++){
+					  if(!selection.isSelected(*_it2)) continue;
 					  ArgList args;
+					  if(profiler) profiler->matchAttempt(*_it2);
                       if((*_it2)->match(workingstring,_it,targetstring,_it3,args)){
+						  RuleApplicationProbe probe(profiler,*_it2,targetstring);
+                          m_context.randomStream().setAddress(_it - workingstring.const_begin(), (*_it2)->getStreamId());
                           match = (*_it2)->applyTo(targetstring,args);
+						  probe.done(match,targetstring);
 						  if(match) { _it = _it3; break; }
                       }
               }
@@ -826,11 +990,18 @@ Lsystem::step(AxialTree& workingstring,
       while ( _it !=  _end) {
           bool match = false;
 		  const RulePtrSet& mruleset = ruleset[_it->getClassId()];
+		  if (ruleset.isPythonFree(_it->getClassId())) gil.native(); else gil.python();
+          StochasticSelection selection(m_context.randomStream(), _it - workingstring.const_begin());
           for(RulePtrSet::const_iterator _it2 = mruleset.begin();
               _it2 != mruleset.end();  _it2++){
+				  if(!selection.isSelected(*_it2)) continue;
 				  ArgList args;
+				  if(profiler) profiler->matchAttempt(*_it2);
                   if((*_it2)->reverse_match(workingstring,_it,targetstring,_it3,args)){
+					  RuleApplicationProbe probe(profiler,*_it2,targetstring);
+                      m_context.randomStream().setAddress(_it - workingstring.const_begin(), (*_it2)->getStreamId());
                       match = (*_it2)->reverseApplyTo(targetstring,args);
+					  probe.done(match,targetstring);
                       if(match) { _it = _it3; break; }
                   }
           }
@@ -845,6 +1016,74 @@ Lsystem::step(AxialTree& workingstring,
   return targetstring;
 }
 
+AxialTree 
+Lsystem::partialStep(AxialTree& workingstring,
+				const RulePtrMap& ruleset,
+				bool& matching,
+                RangeList& ranges){
+  ContextMaintainer c(&m_context);
+  matching = false;
+  RangeList newranges;
+  if( workingstring.empty() || ranges.empty()) { ranges.swap(newranges); return workingstring; }
+  AxialTree targetstring;
+  targetstring.reserve(workingstring.size());
+  DerivationProfiler * profiler = activeProfiler();
+  GilReleaser gil;
+  AxialTree::const_iterator _beg = workingstring.const_begin();
+  AxialTree::const_iterator _it = _beg;
+  AxialTree::const_iterator _it3 = _it;
+  AxialTree::const_iterator _endit = workingstring.const_end();
+  RangeList::const_iterator _range = ranges.begin();
+  size_t prodlength;
+
+  while ( _it != _endit ) {
+      size_t pos = _it - _beg;
+      while (_range != ranges.end() && _range->second <= pos) ++_range;
+      if (_range == ranges.end() || pos < _range->first) {
+          // no rule applied on these modules in the previous pass
+          gil.native();
+          AxialTree::const_iterator _next = (_range == ranges.end() ? _endit : _beg + _range->first);
+          targetstring.push_back(_it,_next);
+          _it = _next;
+      }
+      else if ( _it->isCut() ){
+          gil.native();
+          _it = workingstring.endBracket(_it);
+      }
+      else{
+          bool match = false;
+		  const RulePtrSet& mruleset = ruleset[_it->getClassId()];
+		  if (ruleset.isPythonFree(_it->getClassId())) gil.native(); else gil.python();
+          for(RulePtrSet::const_iterator _it2 = mruleset.begin();
+              _it2 != mruleset.end(); _it2++){
+				  ArgList args;
+				  if(profiler) profiler->matchAttempt(*_it2);
+                  if((*_it2)->match(workingstring,_it,targetstring,_it3,args)){
+					  RuleApplicationProbe probe(profiler,*_it2,targetstring);
+                      m_context.randomStream().setAddress(pos, (*_it2)->getStreamId());
+                      match = (*_it2)->applyTo(targetstring,args,&prodlength);
+					  probe.done(match,targetstring);
+					  if(match) { _it = _it3; break; }
+                  }
+          }
+          if (!match){
+             targetstring.push_back(_it);++_it;
+          }
+          else {
+             matching = true;
+             if (prodlength > 0) {
+                 size_t prodend = targetstring.size();
+                 if (!newranges.empty() && newranges.back().second == prodend - prodlength)
+                     newranges.back().second = prodend;
+                 else newranges.push_back(std::pair<size_t,size_t>(prodend - prodlength, prodend));
+             }
+          }
+      }
+  }
+  ranges.swap(newranges);
+  return targetstring;
+}
+
 AxialTree 
 Lsystem::stepWithMatching(AxialTree& workingstring,
 				const RulePtrMap& ruleset,
@@ -858,22 +1097,33 @@ Lsystem::stepWithMatching(AxialTree& workingstring,
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
   if ( query )LPY::turtle_interpretation(workingstring,m_context.turtle);
 #endif
+  DerivationProfiler * profiler = activeProfiler();
+  GilReleaser gil;
   AxialTree::const_iterator _it = workingstring.begin();
   AxialTree::const_iterator _it3 = _it;
   AxialTree::const_iterator _endit = workingstring.end();
   size_t prodlength;
   matching.clear();
   while ( _it != _endit ) {
-      if ( _it->isCut() )
+      if ( _it->isCut() ){
+          gil.native();
           _it = workingstring.endBracket(_it);
+      }
       else{
           bool match = false;
 		  const RulePtrSet& mruleset = ruleset[_it->getClassId()];
+		  if (ruleset.isPythonFree(_it->getClassId())) gil.native(); else gil.python();
+          StochasticSelection selection(m_context.randomStream(), _it - workingstring.const_begin());
           for(RulePtrSet::const_iterator _it2 = mruleset.begin();
               _it2 != mruleset.end();  _it2++){
+				  if(!selection.isSelected(*_it2)) continue;
 				  ArgList args;
+				  if(profiler) profiler->matchAttempt(*_it2);
                   if((*_it2)->match(workingstring,_it,targetstring,_it3,args)){
+					  RuleApplicationProbe probe(profiler,*_it2,targetstring);
+                      m_context.randomStream().setAddress(_it - workingstring.const_begin(), (*_it2)->getStreamId());
                       match = (*_it2)->applyTo(targetstring,args,&prodlength);
+					  probe.done(match,targetstring);
 					  if (match){
 						matching.append(distance(_it,_it3),prodlength);
 						_it = _it3;
@@ -902,23 +1152,36 @@ Lsystem::recursiveSteps(AxialTree& workingstring,
   AxialTree::const_iterator _endit = workingstring.end();
   AxialTree targetstring;
   targetstring.reserve(workingstring.size());
+  DerivationProfiler * profiler = activeProfiler();
+  GilReleaser gil;
   while ( _it != workingstring.end() ) {
-      if ( _it->isCut() )
+      if ( _it->isCut() ){
+          gil.native();
           _it = workingstring.endBracket(_it);
+      }
       else{
           AxialTree ltargetstring;
           bool match = false;
 		  const RulePtrSet& mruleset = ruleset[_it->getClassId()];
+		  if (ruleset.isPythonFree(_it->getClassId())) gil.native(); else gil.python();
+          StochasticSelection selection(m_context.randomStream(), _it - workingstring.const_begin());
           for(RulePtrSet::const_iterator _it2 = mruleset.begin();
               _it2 != mruleset.end(); _it2++){
+				if(!selection.isSelected(*_it2)) continue;
 				ArgList args;
+				if(profiler) profiler->matchAttempt(*_it2);
                 if((*_it2)->match(workingstring,_it,ltargetstring,_it3,args)){
+					  RuleApplicationProbe probe(profiler,*_it2,ltargetstring);
+                      m_context.randomStream().setAddress(_it - workingstring.const_begin(), (*_it2)->getStreamId());
                       match = (*_it2)->applyTo(ltargetstring,args);
+					  probe.done(match,ltargetstring);
 					  if(match) { _it = _it3; break; }
                   }
           }
           if (match){
               if(maxdepth >1) {
+                  // the nested steps hold the GIL only if it is held when they start
+                  gil.python();
                   targetstring += recursiveSteps(ltargetstring,ruleset,maxdepth-1);
               }
               else targetstring += ltargetstring;
@@ -935,11 +1198,13 @@ Lsystem::derive(  const AxialTree& wstring,
                   size_t starting_iter , 
                   size_t nb_iter , 
                   bool previouslyinterpreted ){
+  checkNotBusy();
   ACQUIRE_RESSOURCE
   enableEarlyReturn(false);
   if ( (m_rules.empty() || wstring.empty()) && m_context.return_if_no_matching )return wstring;
   ContextMaintainer c(&m_context);
-  AxialTree res = derive(starting_iter,nb_iter,wstring,previouslyinterpreted);
+  AxialTree res = (isDerivationCachable() ? cachedDerive(starting_iter,nb_iter,wstring,previouslyinterpreted) 
+										  : derive(starting_iter,nb_iter,wstring,previouslyinterpreted));
   enableEarlyReturn(false);
   return res;
   RELEASE_RESSOURCE
@@ -954,8 +1219,14 @@ Lsystem::derive( size_t starting_iter ,
                     bool previouslyinterpreted){
   m_context.frameDisplay(true);
   AxialTree workstring = wstring;
+  DerivationProfiler * profiler = activeProfiler();
+  // memoized productions depend on the namespace, that may have changed since the last derivation.
+  clearProductionCaches();
+  size_t namespaceversion = m_context.namespaceVersion();
   if(starting_iter == 0) {
+	if(profiler) { profiler->clear(); profiler->startIteration(0); }
 	m_context.setIterationNb(0);
+	StageProbe probe(profiler,DerivationProfiler::ePreProcess);
     apply_pre_process(workstring,false);
   }
   if ( (m_rules.empty() || workstring.empty()) && m_context.return_if_no_matching ){
@@ -976,6 +1247,7 @@ Lsystem::derive( size_t starting_iter ,
       bool productionHasQuery;
       RulePtrMap decomposition;
       bool decompositionHasQuery;
+      bool decompositionIsLocal;
 	  size_t i = 0;
       if(isEarlyReturnEnabled()) return workstring;
 	  for(; (matching||no_match_no_return) && i < nb_iter; ++i){
@@ -1005,7 +1277,15 @@ Lsystem::derive( size_t starting_iter ,
 #endif
 		  m_context.frameDisplay(i == (nb_iter -1));
 		  m_context.setIterationNb(starting_iter+i);
-          apply_pre_process(workstring,true);
+		  if (namespaceversion != m_context.namespaceVersion()) {
+			  clearProductionCaches();
+			  namespaceversion = m_context.namespaceVersion();
+		  }
+		  if(profiler && (i > 0 || starting_iter > 0)) profiler->startIteration(starting_iter+i);
+		  {
+			  StageProbe probe(profiler,DerivationProfiler::ePreProcess);
+			  apply_pre_process(workstring,true);
+		  }
 		  eDirection dir = getDirection();
 		  size_t group_ = m_context.getGroup();
 		  if (group_ > m_rules.size()) LsysWarning("Group not valid.");
@@ -1013,28 +1293,40 @@ Lsystem::derive( size_t starting_iter ,
 			  ndir = dir;
 			  m_currentGroup = group_;
 			  production = getRules(eProduction,group_,ndir,&productionHasQuery);
-			  decomposition = getRules(eDecomposition,group_,ndir,&decompositionHasQuery);
+			  decomposition = getRules(eDecomposition,group_,ndir,&decompositionHasQuery,&decompositionIsLocal);
 			  m_newrules = false;
 		  }
 		  if (!production.empty()){
+			  StageProbe probe(profiler,DerivationProfiler::eProduction);
 			  if(!hasDebugger())
 				  workstring = step(workstring,production,previouslyinterpreted?false:productionHasQuery,matching,dir);
 			  else workstring = debugStep(workstring,production,previouslyinterpreted?false:productionHasQuery,matching,dir,*m_debugger);
 			  previouslyinterpreted = false;
 		  }
 		  if(!decomposition.empty()){
+			  StageProbe probe(profiler,DerivationProfiler::eDecomposition);
 			  bool decmatching = true;
+			  // Modules on which no local rule applied are not rescanned in the following passes
+			  bool incremental = m_context.incremental_decomposition && decompositionIsLocal && dir == eForward && m_decomposition_max_depth > 1;
+			  RangeList produced(1,std::pair<size_t,size_t>(0,workstring.size()));
 			  for(size_t i = 0; decmatching && i < m_decomposition_max_depth; i++){
-				  workstring = step(workstring,decomposition,previouslyinterpreted?false:decompositionHasQuery,decmatching,dir);
+				  m_context.randomStream().setPass(uint32_t(i+1));
+				  if (incremental) workstring = partialStep(workstring,decomposition,decmatching,produced);
+				  else workstring = step(workstring,decomposition,previouslyinterpreted?false:decompositionHasQuery,decmatching,dir);
 				  previouslyinterpreted = false;
 				  if (decmatching) matching = true;
 			  }
 		  }
 		  // Call endeach function
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
-		  if(m_context.hasEndEachFunction())
+		  if(m_context.hasEndEachFunction()){
+			StageProbe probe(profiler,DerivationProfiler::ePostProcess);
 			m_lastcomputedscene = apply_post_process(workstring);
+		  }
 #endif
+		  if(profiler) profiler->endIteration(workstring.size());
+		  if(Tracker::isEnabled()) workstring.updateTracking();
+		  if(m_observer && !m_observer->iterationDone(starting_iter+i+1,workstring)) break;
 		  if(isEarlyReturnEnabled())  break;
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
 		  if( (i+1) <  nb_iter && m_context.isSelectionRequested()) {
@@ -1045,8 +1337,11 @@ Lsystem::derive( size_t starting_iter ,
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
 	  if(starting_iter+i == m_max_derivation) {
 		  // Call end function
-		  if(m_context.hasEndFunction())
+		  if(m_context.hasEndFunction()){
+			StageProbe probe(profiler,DerivationProfiler::ePostProcess);
 			m_lastcomputedscene = apply_post_process(workstring,false);
+			if(profiler) profiler->endIteration(workstring.size());
+		  }
 	  }
 #endif
 	}
@@ -1054,6 +1349,84 @@ Lsystem::derive( size_t starting_iter ,
   return workstring;
 }
 
+bool 
+Lsystem::isDerivationCachable() const
+{
+  return m_context.derivation_cache && !m_sourcekey.empty() && !hasDebugger() 
+	  && !m_context.isSelectionAlwaysRequired()
+	  && !m_context.hasStartFunction() && !m_context.hasStartEachFunction()
+	  && !m_context.hasEndFunction() && !m_context.hasEndEachFunction();
+}
+
+/* Store each iteration of a derivation in the cache and forward it to the previous observer. */
+class DerivationCacheRecorder : public Lsystem::DerivationObserver {
+public:
+  DerivationCacheRecorder(const DerivationCache& cache, size_t starting_iter, Lsystem::DerivationObserver * next):
+	m_cache(cache), m_starting_iter(starting_iter), m_next(next), m_recording(true) {}
+
+  virtual bool iterationDone(size_t iteration, const AxialTree& lstring) {
+	  // once an iteration cannot be stored, the following ones are derived without cache.
+	  if (m_recording) m_recording = m_cache.store(iteration-m_starting_iter, lstring, DerivationCache::randomState());
+	  return m_next == NULL || m_next->iterationDone(iteration,lstring);
+  }
+
+protected:
+  const DerivationCache& m_cache;
+  size_t m_starting_iter;
+  Lsystem::DerivationObserver * m_next;
+  bool m_recording;
+};
+
+AxialTree 
+Lsystem::cachedDerive( size_t starting_iter , 
+                    size_t nb_iter , 
+                    const AxialTree& wstring, 
+                    bool previouslyinterpreted){
+  std::stringstream key;
+  try {
+	  key << "derivation:" << m_sourcekey << ':' << m_derivationcachekey << ':';
+	  for (LsysOptions::const_iterator it = m_context.options.begin(); it != m_context.options.end(); ++it)
+		  key << (*it)->name << '=' << (*it)->currentValue() << ';';
+	  key << ':' << starting_iter << ':' << wstring.toBinary() << ':' << DerivationCache::randomState() << ':' << m_context.getRandomSeed();
+  }
+  catch(error_already_set const &) {
+	  // parameters of the string that cannot be pickled.
+	  PyErr_Clear();
+	  return derive(starting_iter,nb_iter,wstring,previouslyinterpreted);
+  }
+  DerivationCache cache(Compilation::hash(key.str()));
+  if (!cache.isValid()) return derive(starting_iter,nb_iter,wstring,previouslyinterpreted);
+
+  // restart from the last stored iteration
+  AxialTree workstring = wstring;
+  size_t done = cache.lastIteration(nb_iter);
+  std::string randomstate;
+  if (done > 0 && cache.load(done,workstring,randomstate)){
+	  DerivationCache::setRandomState(randomstate);
+	  m_context.setIterationNb(starting_iter+done);
+	  if (m_observer && !m_observer->iterationDone(starting_iter+done,workstring)) return workstring;
+	  if (done == nb_iter) return workstring;
+	  previouslyinterpreted = false;
+  }
+  else {
+	  workstring = wstring;
+	  done = 0;
+  }
+
+  DerivationObserver * observer = m_observer;
+  DerivationCacheRecorder recorder(cache, starting_iter, observer);
+  m_observer = &recorder;
+  try {
+	  workstring = derive(starting_iter+done,nb_iter-done,workstring,previouslyinterpreted);
+  }
+  catch(...) {
+	  m_observer = observer;
+	  throw;
+  }
+  m_observer = observer;
+  return workstring;
+}
+
 void 
 Lsystem::apply_pre_process(AxialTree& workstring, bool starteach)
 {
@@ -1142,10 +1515,13 @@ void Lsystem::gRecursiveInterpretation(AxialTree& workingstring,
           AxialTree ltargetstring;
           bool match = false;
 		  const RulePtrSet& mruleset = ruleset[_it->getClassId()];
+          StochasticSelection selection(m_context.randomStream(), _it - workingstring.const_begin());
           for(RulePtrSet::const_iterator _it2 = mruleset.begin();
               _it2 != mruleset.end(); _it2++){
+				  if(!selection.isSelected(*_it2)) continue;
 				  ArgList args;
                   if((*_it2)->match(workingstring,_it,ltargetstring,_it3,args)){
+                      m_context.randomStream().setAddress(_it - workingstring.const_begin(), (*_it2)->getStreamId());
                       match = (*_it2)->applyTo(ltargetstring,args);
 					  if (match) {
 						dist = distance(_it,_it3);
@@ -1330,12 +1706,15 @@ Lsystem::recursiveInterpretation(AxialTree& workingstring,
           AxialTree ltargetstring;
           bool match = false;
 		  const RulePtrSet& mruleset = ruleset[_it->getClassId()];
+          StochasticSelection selection(m_context.randomStream(), _it - workingstring.const_begin());
           for(RulePtrSet::const_iterator _it2 = mruleset.begin();
 
               _it2 != mruleset.end(); _it2++){
+				  if(!selection.isSelected(*_it2)) continue;
 				  ArgList args;
                   if((*_it2)->match(workingstring,_it,ltargetstring,_it3,args)){
 
+                      m_context.randomStream().setAddress(_it - workingstring.const_begin(), (*_it2)->getStreamId());
                       match = (*_it2)->applyTo(ltargetstring,args);
 					  if (match) {
 						dist = distance(_it,_it3);
@@ -1603,4 +1982,6 @@ Lsystem::forceRelease(){
 
 Lsystem::Debugger::~Debugger()  { }
 
+Lsystem::DerivationObserver::~DerivationObserver()  { }
+
 /*---------------------------------------------------------------------------*/
@@ -31,9 +31,12 @@
 #pragma once
 
 #include "lsysrule.h"
+#include "profiler.h"
 #include "lsyscontext.h"
 #include "stringmatching.h"
 #include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <atomic>
 
 LPY_BEGIN_NAMESPACE
 
@@ -56,6 +59,11 @@ public:
   Lsystem(const std::string& filename, const boost::python::dict& parameters);
   ~Lsystem();
 
+  /** Return a new Lsystem with the same rules, axiom, options and compiled functions, without re-parsing.
+      If isolatedNamespace, the python namespace is shallow copied and its functions are rebound to the copy.
+      Otherwise the namespace is shared with self. */
+  Lsystem * clone(bool isolatedNamespace = true) const;
+
   /** clear */
   void clear();
 
@@ -88,6 +96,13 @@ public:
 		    std::string * pycode = NULL, 
 			const boost::python::dict& parameters = boost::python::dict());
 
+  /** clear the productions memoized by the rules. */
+  void clearProductionCaches();
+
+  /** rebuild from the code given to set, with parameters overriding the ones given with it.
+      Return false if the lsystem was not built from code. */
+  bool rebuild( const boost::python::dict& parameters );
+
   /** set rules */
   void addRule( const LsysRule& rule, int type, size_t group );
 
@@ -324,8 +339,40 @@ public:
    inline bool hasDebugger() const { return is_valid_ptr(m_debugger); }
    inline void clearDebugger() { m_debugger = DebuggerPtr(); }
 
+   /** Observer notified at the end of each iteration of a derivation */
+   class LPY_API DerivationObserver {
+   public:
+	   virtual ~DerivationObserver();
+	   /// called with the string resulting from iteration. Return false to interrupt the derivation.
+	   virtual bool iterationDone(size_t iteration, const AxialTree& lstring) = 0;
+   };
+
+   inline void setDerivationObserver(DerivationObserver * observer) { m_observer = observer; }
+   inline DerivationObserver * getDerivationObserver() const { return m_observer; }
+   inline bool hasDerivationObserver() const { return m_observer != NULL; }
+
+   /** While a DerivationTask derives the lsystem in its thread, the lsystem is busy: 
+       derive, set and clear raise an error if called from another thread. */
+   inline void setBusyThread(const QThread * thread) { m_busythread = thread; }
+   inline bool isBusy() const { return m_busythread.load() != NULL; }
+
    pgl_hash_map_string<std::string> get_rule_fonction_table() const;
 
+   /** Derivations are reused from the derivation cache if the 'Derivation cache' option is enabled.
+       The cache is not used when the code has Start, StartEach, End or EndEach functions, 
+	   with a debugger or if rules have been added after loading the code. The key of a derivation 
+	   includes the current options but not the changes made to the namespace after loading, nor 
+	   external state read by the rules (e.g. a scene of the host application). Such state should be 
+	   described by the derivation cache key. */
+   bool isDerivationCachable() const;
+   inline void setDerivationCacheKey(const std::string& key) { m_derivationcachekey = key; }
+   inline const std::string& getDerivationCacheKey() const { return m_derivationcachekey; }
+
+   /** Profile of the last derivation, recorded if the 'Profiling' option is enabled. 
+	   A derivation starting at iteration 0 clears the previous profile. */
+   inline const DerivationProfiler& getProfiler() const { return m_profiler; }
+   inline void clearProfile() { m_profiler.clear(); }
+
 protected:
 
   struct RuleGroup {
@@ -352,9 +399,13 @@ protected:
   LsysRule& addInterpretationRule( const std::string& rule, size_t group,  int lineno = -1, const ConsiderFilterPtr filter = ConsiderFilterPtr() );
 
  void importPyFunctions();
+ /// Set the probability intervals of the stochastic rules. To be called once their probabilities are known.
+ void initProbabilityIntervals();
 
  Lsystem(const Lsystem& lsys);
  Lsystem& operator=(const Lsystem& lsys);
+ /// Lsystem using the given namespace.
+ Lsystem(const boost::python::dict& globals);
 
  AxialTree homomorphism(AxialTree& workstring);
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
@@ -365,6 +416,10 @@ protected:
                       size_t nb_iter , 
                       const AxialTree& workstring, 
                       bool previouslyinterpreted = false);
+ AxialTree cachedDerive( size_t starting_iter , 
+                      size_t nb_iter , 
+                      const AxialTree& workstring, 
+                      bool previouslyinterpreted = false);
 
  AxialTree step(AxialTree& workingstring,
 				   const RulePtrMap& ruleset,
@@ -373,6 +428,16 @@ protected:
  AxialTree debugStep(AxialTree& workingstring, const RulePtrMap& ruleset,
 					bool query, bool& matching, eDirection direction, Debugger& debugger);
 
+ /// Ranges [first,second) of module positions in a string.
+ typedef std::vector<std::pair<size_t,size_t> > RangeList;
+
+ /** Forward step that only scans the modules in ranges. Other modules are copied as is.
+     ranges is replaced by the ranges of the productions made in the resulting string. */
+ AxialTree partialStep(AxialTree& workingstring,
+				   const RulePtrMap& ruleset,
+				   bool& matching,
+                   RangeList& ranges);
+
  AxialTree stepWithMatching(AxialTree& workingstring,
 				              const RulePtrMap& ruleset,
 				              bool query,
@@ -400,7 +465,7 @@ protected:
                                 size_t maxdepth,
 								bool withid = true);
 
- RulePtrMap getRules(eRuleType type, size_t group, eDirection direction, bool * hasQuery = NULL);
+ RulePtrMap getRules(eRuleType type, size_t group, eDirection direction, bool * hasQuery = NULL, bool * isLocal = NULL);
 
  void apply_pre_process(AxialTree& workstring, bool starteach = true);
  
@@ -426,6 +491,24 @@ protected:
 
   DebuggerPtr m_debugger;
   bool m_newrules;
+  DerivationObserver * m_observer;
+  std::atomic<const QThread *> m_busythread;
+  /// raise an error if the lsystem is busy in another thread.
+  void checkNotBusy() const;
+  /// hash of the code and parameters used to build the lsystem. Empty if not cachable.
+  std::string m_sourcekey;
+  /// user key added to the key of the cached derivations. Kept when the code is set again.
+  std::string m_derivationcachekey;
+  /// code and parameters given to set, to rebuild the lsystem with other parameters.
+  std::string m_source;
+  boost::python::dict m_sourceparameters;
+
+  DerivationProfiler m_profiler;
+  inline DerivationProfiler * activeProfiler() { return m_context.profiling ? &m_profiler : NULL; }
+
+  friend class HomomorphismIterator;
+  friend class PipelinedDerivation;
+  friend class StreamingDerivation;
 
 private:
 #ifdef MULTI_THREADED_LSYSTEM
@@ -38,10 +38,11 @@
 LPY_BEGIN_NAMESPACE
 
 /*---------------------------------------------------------------------------*/
-MatchingEngine::eModuleMatchingMethod 
-MatchingEngine::ModuleMatchingMethod = MatchingEngine::eDefaultModuleMatching;
+// Matching methods of the context current on this thread.
+static thread_local MatchingEngine::eModuleMatchingMethod 
+ModuleMatchingMethod = MatchingEngine::eDefaultModuleMatching;
 
-MatchingEngine::ModuleMatchingFuncType MatchingEngine::ModuleMatchingFunc = &MatchingImplementation::module_matching_with_star_and_valueconstraints;
+static thread_local MatchingEngine::ModuleMatchingFuncType ModuleMatchingFunc = &MatchingImplementation::module_matching_with_star_and_valueconstraints;
 
 
 void MatchingEngine::setModuleMatchingMethod(MatchingEngine::eModuleMatchingMethod method)
@@ -61,11 +62,11 @@ MatchingEngine::eModuleMatchingMethod LPY::MatchingEngine::getModuleMatchingMeth
 { return ModuleMatchingMethod; }
 
 
-MatchingEngine::eStringMatchingMethod 
-MatchingEngine::StringMatchingMethod = MatchingEngine::eDefaultStringMatching;
+static thread_local MatchingEngine::eStringMatchingMethod 
+StringMatchingMethod = MatchingEngine::eDefaultStringMatching;
 
-MatchingEngine::RightMatchingFuncType MatchingEngine::RightMatchingFunc = &MatchingImplementation::tree_right_match;
-MatchingEngine::LeftMatchingFuncType MatchingEngine::LeftMatchingFunc   = &MatchingImplementation::tree_left_match;
+static thread_local MatchingEngine::RightMatchingFuncType RightMatchingFunc = &MatchingImplementation::tree_right_match;
+static thread_local MatchingEngine::LeftMatchingFuncType LeftMatchingFunc   = &MatchingImplementation::tree_left_match;
 
 void MatchingEngine::setStringMatchingMethod(MatchingEngine::eStringMatchingMethod method)
 { 
@@ -202,7 +203,7 @@ inline bool isinstance(const ParamModule& module, const PatternModule& pattern){
 }
 
 typedef bool (*COMPAREMODULE)(const ParamModule&, const PatternModule&);
-static COMPAREMODULE compatibleName = &same_name;
+static thread_local COMPAREMODULE compatibleName = &same_name;
 
 
 inline bool same_class(const ModuleClassPtr& module, const ModuleClassPtr& pattern){
@@ -215,9 +216,9 @@ inline bool issubclass(const ModuleClassPtr& module, const ModuleClassPtr& patte
 }
 
 typedef bool (*COMPAREMODULECLASS)(const ModuleClassPtr&, const ModuleClassPtr&);
-static COMPAREMODULECLASS compatibleClass = &same_class;
+static thread_local COMPAREMODULECLASS compatibleClass = &same_class;
 
-static bool INHERITEDCLASSCOMPARISON = false;
+static thread_local bool INHERITEDCLASSCOMPARISON = false;
 
 void MatchingEngine::setInheritanceModuleMatchingActivated(bool b)
 { 
@@ -65,24 +65,18 @@ public:
   static void setStringMatchingMethod(eStringMatchingMethod);
   static eStringMatchingMethod getStringMatchingMethod();
 
-private:
-  static eModuleMatchingMethod ModuleMatchingMethod;
-  static eStringMatchingMethod StringMatchingMethod;
+  /* The matching methods are options of the current context: they are set when a
+     context becomes current and are thus stored per thread (see matching.cpp). */
   typedef bool (*ModuleMatchingFuncType)(const ParamModule&, const PatternModule&, ArgList&);
-  static ModuleMatchingFuncType ModuleMatchingFunc;
 
   typedef bool (*RightMatchingFuncType)(AxialTree::const_iterator, AxialTree::const_iterator, AxialTree::const_iterator,
 										PatternString::const_iterator, PatternString::const_iterator,
 										AxialTree::const_iterator&, AxialTree::const_iterator&, ArgList&);
 
-  static RightMatchingFuncType RightMatchingFunc;
-
   typedef bool (*LeftMatchingFuncType)(AxialTree::const_iterator, AxialTree::const_iterator,
 									   AxialTree::const_iterator, PatternString::const_reverse_iterator,
 									   PatternString::const_reverse_iterator, AxialTree::const_iterator&, ArgList&);
 
-  static LeftMatchingFuncType LeftMatchingFunc;
-
 public:
 	static bool compatible_classes(const ModuleClassPtr& module, 
 							 const ModuleClassPtr& pattern) ;
@@ -32,11 +32,14 @@
 
 #include "error.h"
 #include <vector>
+#include <type_traits>
+#include <atomic>
 #include "../plantgl/tool/util_string.h"
 #include "../plantgl/math/util_vector.h"
 
 #include "moduleclass.h"
 #include "argcollector.h"
+#include "tracker.h"
 #include <QtCore/QSharedData>
 
 LPY_BEGIN_NAMESPACE
@@ -173,6 +176,9 @@ public:
     inline void delSliceItemAt(int i, int j)
 	{ size_t ri, rj; getValidIndices(i,j,ri,rj) ; return delSlice(ri,rj);  }
 
+	/// update the memory accounting of the arguments (see Tracker).
+	inline void updateTracking() const { m_argholder->updateTracking(); }
+
 	inline void append(const ParameterType& value)  { getArgs().push_back(value); }
 	inline void prepend(const ParameterType& value) { getArgs().insert(getArgs().begin(), value); }
 
@@ -285,11 +291,44 @@ protected:
 	 typedef PModule ParamModule;
 	 typedef typename ParamModule::ParameterList ParameterList;
 
-	 ParamListInternal() : QSharedData() {}
-	 ParamListInternal(const ParamListInternal& other) : QSharedData(), m_args(other.m_args) { }
-	 ~ParamListInternal() {}
+	 ParamListInternal() : QSharedData(), m_tracked(0) { track(); }
+	 ParamListInternal(const ParamListInternal& other) : QSharedData(), m_tracked(0), m_args(other.m_args) { track(); }
+	 ~ParamListInternal() {
+		 uint32_t tracked = m_tracked.load();
+		 if (tracked) {
+			 Tracker::release(Tracker::eArgumentBlock, bytes(tracked-1));
+			 Tracker::release(Tracker::eModuleArgument, 0, long(tracked-1));
+		 }
+	 }
+
+	 /// update the accounting of the arguments if they changed since the block was accounted.
+	 inline void updateTracking() const {
+		 // a shared block can be updated from several threads. Only the one that changes m_tracked accounts the difference.
+		 uint32_t tracked = m_tracked.load(std::memory_order_relaxed);
+		 uint32_t current = uint32_t(m_args.size()+1);
+		 if (tracked && tracked != current && m_tracked.compare_exchange_strong(tracked, current)) {
+			 long delta = long(current) - long(tracked);
+			 Tracker::resize(Tracker::eArgumentBlock, delta * long(sizeof(ParameterType)));
+			 if (delta > 0) Tracker::allocate(Tracker::eModuleArgument, 0, delta);
+			 else Tracker::release(Tracker::eModuleArgument, 0, -delta);
+		 }
+	 }
 
+	 // nb of accounted arguments + 1. 0 if not accounted. Declared before m_args to fit in the padding of QSharedData.
+	 mutable std::atomic<uint32_t> m_tracked;
      ParameterList m_args;
+
+ protected:
+	 static inline long bytes(size_t nbargs) { return long(sizeof(ParamListInternal) + nbargs * sizeof(ParameterType)); }
+
+	 // only the arguments of ParamModule, that hold python objects, are accounted.
+	 inline void track() {
+		 if (std::is_same<ParameterType,boost::python::object>::value && Tracker::isEnabled()) {
+			 m_tracked = uint32_t(m_args.size()+1);
+			 Tracker::allocate(Tracker::eArgumentBlock, bytes(m_args.size()));
+			 Tracker::allocate(Tracker::eModuleArgument, 0, long(m_args.size()));
+		 }
+	 }
  };
  
  typedef ParamListInternal<BaseType> ParamModuleInternal;
@@ -414,6 +453,9 @@ protected:
 
 };
 
+template<>
+struct TrackedStringCategory<ParamModule> { static const Tracker::eCategory value = Tracker::eAxialTree; };
+
 /*---------------------------------------------------------------------------*/
 
 inline bool is_lower_scale(int scale1, int scale2) { return scale1 < scale2; }
@@ -35,6 +35,7 @@
 #include "../plantgl/tool/util_string.h"
 #include <algorithm>
 #include <iostream>
+#include <cstdint>
 
 LPY_BEGIN_NAMESPACE
 
@@ -76,31 +77,124 @@ void ModuleClassTable::clearModuleClasses()
 
 /*---------------------------------------------------------------------------*/
 
-size_t ModuleClass::MAXID(0);
+std::atomic<size_t> ModuleClass::MAXID(0);
 int ModuleClass::DEFAULT_SCALE = INT_MAX;
 size_t ModuleClass::NOPOS = std::string::npos;
 
 /*---------------------------------------------------------------------------*/
 
+static std::atomic<uint64_t> ModuleClassSerial(0);
+
 ModuleClass::ModuleClass(const std::string& _name):
-TOOLS(RefCountObject)(), name(_name), onlyInPattern(false), id(MAXID), active(true) {MAXID++; IncTracker(ModuleClass) }
+TOOLS(RefCountObject)(), name(_name), onlyInPattern(false), id(MAXID++), active(true), m_serial(++ModuleClassSerial), m_aliases(new AliasList()) { IncTracker(ModuleClass) }
 
 ModuleClass::ModuleClass(const std::string& _name, const std::string& alias):
-TOOLS(RefCountObject)(), name(_name), onlyInPattern(false), id(MAXID), active(true) {
-	MAXID++; 
-	aliases.push_back(alias);
+TOOLS(RefCountObject)(), name(_name), onlyInPattern(false), id(MAXID++), active(true), m_serial(++ModuleClassSerial), m_aliases(new AliasList(1,alias)) {
 	IncTracker(ModuleClass)
 }
 
 ModuleClass::~ModuleClass()
 { 
 	// std::cerr << "Delete module class '" << name << "' with id " << id << " ... done." << std::endl;
-	if(ModuleClassTable::m_INSTANCE) 
-		ModuleClassTable::m_INSTANCE->remove(this);
-	if (id == MAXID-1) --MAXID;
+	// Declared classes are referenced by the module class table, so a deleted class is not in it anymore.
+	size_t lastid = id+1;
+	MAXID.compare_exchange_strong(lastid, id);
 	DecTracker(ModuleClass)
 }
 
+/*---------------------------------------------------------------------------*/
+
+/* States of the classes on a thread, indexed by class id. An entry belongs to the
+   class with the same serial: entries of deleted classes are ignored and reset 
+   when their id is reused. */
+struct ModuleClass::ThreadState {
+	uint64_t serial;
+	bool active;
+	ModuleVTablePtr vtable;
+	ThreadState() : serial(0), active(false) { }
+};
+
+std::vector<ModuleClass::ThreadState>& ModuleClass::getThreadStates()
+{
+	static thread_local std::vector<ThreadState> states;
+	return states;
+}
+
+ModuleClass::ThreadState * ModuleClass::getThreadState() const
+{
+	std::vector<ThreadState>& states = getThreadStates();
+	if (id >= states.size()) return NULL;
+	ThreadState * state = &states[id];
+	if (state->serial != m_serial) return NULL;
+	return state;
+}
+
+ModuleClass::ThreadState& ModuleClass::setThreadState()
+{
+	std::vector<ThreadState>& states = getThreadStates();
+	if (id >= states.size()) states.resize(id+1);
+	ThreadState& state = states[id];
+	if (state.serial != m_serial) {
+		state.serial = m_serial;
+		state.active = active.load(std::memory_order_acquire);
+		state.vtable = ModuleVTablePtr();
+	}
+	return state;
+}
+
+bool ModuleClass::isActive() const
+{
+	ThreadState * state = getThreadState();
+	if (state) return state->active;
+	return active.load(std::memory_order_acquire);
+}
+
+ModuleVTable * ModuleClass::getVTable() const
+{
+	ThreadState * state = getThreadState();
+	if (state) return state->vtable.get();
+	return NULL;
+}
+
+void ModuleClass::setVTable(ModuleVTable * vtable)
+{
+	setThreadState().vtable = ModuleVTablePtr(vtable);
+}
+
+/*---------------------------------------------------------------------------*/
+
+// Aliases activated on this thread (see ModuleClassTable::activateAlias).
+typedef pgl_hash_map_string<ModuleClassPtr> ThreadAliasMap;
+static thread_local ThreadAliasMap ThreadAliases;
+static thread_local size_t ThreadAliasMaxLength = 0;
+
+ModuleClass::AliasList ModuleClass::getAliases() const
+{
+	AliasList aliases = *std::atomic_load(&m_aliases);
+	for(ThreadAliasMap::const_iterator it = ThreadAliases.begin(); it != ThreadAliases.end(); ++it)
+		if (it->second.get() == this) aliases.push_back(it->first);
+	return aliases;
+}
+
+void ModuleClass::addAlias(const std::string& alias)
+{
+	AliasListPtr aliases = std::atomic_load(&m_aliases);
+	AliasList * newaliases = new AliasList(*aliases);
+	newaliases->push_back(alias);
+	std::atomic_store(&m_aliases, AliasListPtr(newaliases));
+}
+
+bool ModuleClass::removeAlias(const std::string& alias)
+{
+	AliasListPtr aliases = std::atomic_load(&m_aliases);
+	AliasList::const_iterator it = std::find(aliases->begin(),aliases->end(),alias);
+	if (it == aliases->end()) return false;
+	AliasList * newaliases = new AliasList(aliases->begin(),it);
+	newaliases->insert(newaliases->end(),it+1,aliases->end());
+	std::atomic_store(&m_aliases, AliasListPtr(newaliases));
+	return true;
+}
+
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
 void ModuleClass::interpret(ParamModule& m, PGL::Turtle& t) { 
 }
@@ -108,49 +202,65 @@ void ModuleClass::interpret(ParamModule& m, PGL::Turtle& t) {
 
 void ModuleClass::activate(bool value) 
 {	
-	active = value; 
-    if (!active)
-		if(m_vtable)m_vtable->desactivate(); 
-	else 
-		if (!ModuleClassTable::get().isDeclared(this))
+	// the shared flag is the default state for threads that never used the class
+	active.store(value, std::memory_order_release);
+	activateOnThread(value);
+}
+
+void ModuleClass::activateInCurrentContext()
+{
+	if (LsysContext::globalContext()->isCurrent()) activate();
+	else activateOnThread();
+}
+
+void ModuleClass::activateOnThread(bool value)
+{	
+	setThreadState().active = value;
+	if (!value) {
+		ModuleVTable * vtable = getVTable();
+		if(vtable)vtable->desactivate(); 
+		else if (!ModuleClassTable::get().isDeclared(this))
 			ModuleClassTable::get().declare(this);
+	}
 }
 
 void ModuleClass::create_vtable()
 {
-	m_vtable = new ModuleVTable(this);
+	setVTable(new ModuleVTable(this));
 }
 
 void ModuleClass::setProperty(ModulePropertyPtr prop)
 {
-	if(!m_vtable)create_vtable();
-	m_vtable->setProperty(prop);
+	if(!getVTable())create_vtable();
+	getVTable()->setProperty(prop);
 }
 
 bool ModuleClass::removeProperty(const std::string& name)
 {
-	if(m_vtable)return m_vtable->removeProperty(name);
+	ModuleVTable * vtable = getVTable();
+	if(vtable)return vtable->removeProperty(name);
 	else return false;
 }
 
 void ModuleClass::setBases(const ModuleClassList& bases)
 {
-	if(!m_vtable)create_vtable();
-	m_vtable->setBases(bases);
+	if(!getVTable())create_vtable();
+	getVTable()->setBases(bases);
 }
 
 ModuleClassList ModuleClass::getBases() const
 {
-	if(!m_vtable) return ModuleClassList();
-	else return m_vtable->getBases();
+	ModuleVTable * vtable = getVTable();
+	if(!vtable) return ModuleClassList();
+	else return vtable->getBases();
 }
 
 
 
 void ModuleClass::setScale(int scale)
 {
-	if(!m_vtable)create_vtable();
-	m_vtable->scale = scale;
+	if(!getVTable())create_vtable();
+	getVTable()->scale = scale;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -187,8 +297,119 @@ size_t ModuleClass::getParameterPosition(const std::string& name) const{
 
 /*---------------------------------------------------------------------------*/
 
+/* Reader slots of the module class table. Each thread owns a slot, in which it
+   announces the table epoch at which its outermost read section started (0 when
+   it is not reading). Slots are never freed: a slot released at thread exit is
+   reused by the next thread that reads the table. */
+struct ReaderSlot {
+	alignas(64) std::atomic<uint64_t> epoch;
+	size_t depth;
+	std::atomic<bool> used;
+	ReaderSlot * next;
+	ReaderSlot() : epoch(0), depth(0), used(true), next(NULL) { }
+};
+
+static std::atomic<ReaderSlot *> ReaderSlots(NULL);
+
+struct ThreadReaderSlot {
+	ReaderSlot * slot;
+
+	ThreadReaderSlot() : slot(NULL) {
+		for(ReaderSlot * it = ReaderSlots.load(std::memory_order_acquire); it != NULL; it = it->next){
+			bool unused = false;
+			if (it->used.compare_exchange_strong(unused, true)) { slot = it; return; }
+		}
+		slot = new ReaderSlot();
+		slot->next = ReaderSlots.load(std::memory_order_relaxed);
+		while(!ReaderSlots.compare_exchange_weak(slot->next, slot));
+	}
+
+	~ThreadReaderSlot() {
+		slot->epoch.store(0, std::memory_order_release);
+		slot->depth = 0;
+		slot->used.store(false, std::memory_order_release);
+	}
+};
+
+static inline ReaderSlot& threadReaderSlot() {
+	static thread_local ThreadReaderSlot slot;
+	return *slot.slot;
+}
+
+/* Read access to the tables of ModuleClassTable. The outermost section of a thread
+   announces the current epoch before loading the published snapshot. A snapshot 
+   retired at epoch e can only be loaded by sections that announced an epoch <= e,
+   so it is deleted once every announced epoch is greater than e. */
+class ModuleClassTable::ReadSection {
+public:
+	ReadSection(const ModuleClassTable& table) : m_slot(threadReaderSlot())
+	{
+		if (m_slot.depth++ == 0) m_slot.epoch.store(table.m_epoch.load());
+		m_tables = table.m_snapshot.load();
+	}
+
+	~ReadSection()
+	{
+		if (--m_slot.depth == 0) m_slot.epoch.store(0, std::memory_order_release);
+	}
+
+	inline const Snapshot * operator->() const { return m_tables; }
+
+protected:
+	ReaderSlot& m_slot;
+	const Snapshot * m_tables;
+};
+
+/* Write access to the tables of ModuleClassTable. The first transaction of a thread
+   copies the published snapshot, nested ones share this copy, and the copy is
+   published when the outermost transaction ends. */
+class ModuleClassTable::Transaction {
+public:
+	Transaction(ModuleClassTable& table) : 
+	  m_table(table), m_locker(&table.m_writemutex), m_owner(table.m_pending == NULL)
+	{
+		if (m_owner) m_table.m_pending = new Snapshot(*m_table.m_snapshot.load());
+	}
+
+	~Transaction()
+	{
+		if (m_owner) {
+			const Snapshot * published = m_table.m_pending;
+			m_table.m_pending = NULL;
+			m_table.retire(m_table.m_snapshot.exchange(published));
+		}
+	}
+
+	inline Snapshot * operator->() const { return m_table.m_pending; }
+
+protected:
+	ModuleClassTable& m_table;
+	QMutexLocker m_locker;
+	bool m_owner;
+};
+
+void ModuleClassTable::retire(const Snapshot * snapshot)
+{
+	// called by writers only, with the write mutex held
+	m_retired.push_back(RetiredSnapshotList::value_type(m_epoch.fetch_add(1),snapshot));
+	uint64_t oldest = UINT64_MAX;
+	for(ReaderSlot * it = ReaderSlots.load(std::memory_order_acquire); it != NULL; it = it->next){
+		uint64_t epoch = it->epoch.load();
+		if (epoch != 0 && epoch < oldest) oldest = epoch;
+	}
+	// deleting a snapshot releases the classes only it refers to
+	RetiredSnapshotList::iterator last = m_retired.begin();
+	for(RetiredSnapshotList::iterator it = m_retired.begin(); it != m_retired.end(); ++it){
+		if (it->first < oldest) delete it->second;
+		else *last++ = *it;
+	}
+	m_retired.erase(last,m_retired.end());
+}
+
+/*---------------------------------------------------------------------------*/
+
 ModuleClassTable::ModuleClassTable():
-mandatory_declaration(false), maxnamelength(0)
+m_snapshot(new Snapshot()), m_epoch(1), m_pending(NULL), m_writemutex(QMutex::Recursive), m_removals(0)
 {
 	IncTracker(ModuleClassTable)
 	registerPredefinedModule();
@@ -197,6 +418,9 @@ mandatory_declaration(false), maxnamelength(0)
 ModuleClassTable::~ModuleClassTable()
 {
 	clear();
+	for(RetiredSnapshotList::const_iterator it = m_retired.begin(); it != m_retired.end(); ++it)
+		delete it->second;
+	delete m_snapshot.load();
 	ModuleClassTable::m_INSTANCE = NULL;
 	DecTracker(ModuleClassTable)
 }
@@ -204,21 +428,37 @@ ModuleClassTable::~ModuleClassTable()
 void
 ModuleClassTable::clear()
 {
-	modulenamemap.clear();
+	Transaction tables(*this);
+	tables->modulenamemap.clear();
+	m_removals.fetch_add(1, std::memory_order_acq_rel);
 }
 
 void 
 ModuleClassTable::reset()
 {
+	Transaction tables(*this);
 	clear();
 	registerPredefinedModule();
 }
 
+size_t ModuleClassTable::size() const
+{
+	ReadSection tables(*this);
+	return tables->modulenamelist.size();
+}
+
+bool ModuleClassTable::empty() const
+{
+	ReadSection tables(*this);
+	return tables->modulenamelist.empty();
+}
+
 /*---------------------------------------------------------------------------*/
 
 void 
 ModuleClassTable::registerPredefinedModule()
 {
+	Transaction tables(*this);
 	for(ModuleClassList::const_iterator it = ModuleClass::getPredefinedClasses().begin();
 		it != ModuleClass::getPredefinedClasses().end(); ++it) 
 		declare(it->get());
@@ -230,13 +470,19 @@ ModuleClassTable::registerPredefinedModule()
 ModuleClassPtr 
 ModuleClassTable::declare(const std::string& name)
 {
+	Transaction tables(*this);
 	ModuleClassMap::iterator itname;
-	if ((itname = modulenamemap.find(name)) == modulenamemap.end())
+	if ((itname = tables->modulenamemap.find(name)) == tables->modulenamemap.end())
 	{
 		ModuleClassPtr info = new ModuleClass(name);
-		if(maxnamelength < name.size())maxnamelength = name.size();
-		modulenamemap[name] = info.get();
-		modulenamelist[info->getId()] = info.get();
+		// a class declared by an Lsystem is only active on the threads where its context is current
+		if (!LsysContext::globalContext()->isCurrent()) {
+			info->setThreadState().active = true;
+			info->active.store(false, std::memory_order_release);
+		}
+		if(tables->maxnamelength < name.size())tables->maxnamelength = name.size();
+		tables->modulenamemap[name] = info;
+		tables->modulenamelist[info->getId()] = info;
 		// std::cerr << "declare '" << name << "' first time with id " << info->getId() << std::endl;
 		return info;
 	}
@@ -245,7 +491,7 @@ ModuleClassTable::declare(const std::string& name)
 			LsysWarning("Redeclaration of module '"+name+"'.");
 		else {
 			// std::cerr << "redeclare '" << name << "' with id " << itname->second->getId() <<". reusing." << std::endl;
-			itname->second->activate();
+			itname->second->activateInCurrentContext();
 		}
 		return itname->second;
 	}
@@ -253,41 +499,45 @@ ModuleClassTable::declare(const std::string& name)
 
 bool ModuleClassTable::declare(ModuleClass * moduleclass)
 {
-	if (modulenamelist.find(moduleclass->getId()) != modulenamelist.end()){
+	Transaction tables(*this);
+	if (tables->modulenamelist.find(moduleclass->getId()) != tables->modulenamelist.end()){
 		LsysWarning("Redeclaration of predefined module '"+moduleclass->name+"'.");
 		return false;
 	}
-	modulenamemap[moduleclass->name] = moduleclass;
-	modulenamelist[moduleclass->getId()] = moduleclass;
-	if(maxnamelength < moduleclass->name.size())maxnamelength = moduleclass->name.size();
-	for(std::vector<std::string>::iterator it = moduleclass->aliases.begin(); it != moduleclass->aliases.end(); ++it){
-		modulenamemap[*it] = moduleclass;
-		if(maxnamelength < it->size())maxnamelength = it->size();
+	tables->modulenamemap[moduleclass->name] = moduleclass;
+	tables->modulenamelist[moduleclass->getId()] = moduleclass;
+	if(tables->maxnamelength < moduleclass->name.size())tables->maxnamelength = moduleclass->name.size();
+	ModuleClass::AliasList aliases = *std::atomic_load(&moduleclass->m_aliases);
+	for(ModuleClass::AliasList::const_iterator it = aliases.begin(); it != aliases.end(); ++it){
+		tables->modulenamemap[*it] = moduleclass;
+		if(tables->maxnamelength < it->size())tables->maxnamelength = it->size();
 	}
 	return true;
 }
 
 bool ModuleClassTable::isDeclared(const ModuleClass * moduleclass) const
 {
-	return (modulenamelist.find(moduleclass->getId()) != modulenamelist.end());
+	ReadSection tables(*this);
+	return (tables->modulenamelist.find(moduleclass->getId()) != tables->modulenamelist.end());
 }
 
 
 ModuleClassPtr 
 ModuleClassTable::alias(const std::string& aliasname, const std::string& name)
 {
+	Transaction tables(*this);
 	ModuleClassMap::iterator itname;
 	ModuleClassMap::iterator italias;
-	if((itname = modulenamemap.find(name)) == modulenamemap.end() || !itname->second->isActive()){
-		if(itname == modulenamemap.end())LsysError("Undefined module '"+name+"' for alias.");
+	if((itname = tables->modulenamemap.find(name)) == tables->modulenamemap.end() || !itname->second->isActive()){
+		if(itname == tables->modulenamemap.end())LsysError("Undefined module '"+name+"' for alias.");
 		else LsysError("Inactive module '"+name+"' for alias.");
 	}
-	if ((italias = modulenamemap.find(aliasname)) == modulenamemap.end())
+	if ((italias = tables->modulenamemap.find(aliasname)) == tables->modulenamemap.end())
 	{
-		ModuleClass * info = itname->second;
-		if(maxnamelength < aliasname.size())maxnamelength = aliasname.size();
-		info->aliases.push_back(aliasname);
-		modulenamemap[aliasname] = info;
+		ModuleClassPtr info = itname->second;
+		if(tables->maxnamelength < aliasname.size())tables->maxnamelength = aliasname.size();
+		info->addAlias(aliasname);
+		tables->modulenamemap[aliasname] = info;
 		return info;
 	}
 	else {
@@ -301,10 +551,10 @@ ModuleClassTable::alias(const std::string& aliasname, const std::string& name)
 				return italias->second;
 			}
 			else {
-				remove(itname->second);
-				ModuleClass * info = itname->second;
-				info->aliases.push_back(aliasname);
-				modulenamemap[aliasname] = info;
+				ModuleClassPtr info = itname->second;
+				remove(info.get());
+				info->addAlias(aliasname);
+				tables->modulenamemap[aliasname] = info;
 				return info;
 			}
 		}
@@ -314,15 +564,16 @@ ModuleClassTable::alias(const std::string& aliasname, const std::string& name)
 void 
 ModuleClassTable::alias(const std::string& aliasname, ModuleClassPtr module)
 {
+	Transaction tables(*this);
 	ModuleClassMap::iterator italias;
 	if(!module->isActive()){
 		LsysError("Inactive module '"+module->name+"' for alias.");
 	}
-	if ((italias = modulenamemap.find(aliasname)) == modulenamemap.end())
+	if ((italias = tables->modulenamemap.find(aliasname)) == tables->modulenamemap.end())
 	{
-		if(maxnamelength < aliasname.size())maxnamelength = aliasname.size();
-		module->aliases.push_back(aliasname);
-		modulenamemap[aliasname] = module;
+		if(tables->maxnamelength < aliasname.size())tables->maxnamelength = aliasname.size();
+		module->addAlias(aliasname);
+		tables->modulenamemap[aliasname] = module;
 	}
 	else {
 		LsysError("Redeclaration of alias '"+aliasname+"' as '"+module->name+"' (previously '"+italias->second->name+"').");
@@ -331,17 +582,56 @@ ModuleClassTable::alias(const std::string& aliasname, ModuleClassPtr module)
 
 
 
+// Option of the context current on this thread.
+static thread_local bool MandatoryDeclaration = false;
+
+void ModuleClassTable::setMandatoryDeclaration(bool value) { MandatoryDeclaration = value; }
+
+bool ModuleClassTable::isMandatoryDeclaration() { return MandatoryDeclaration; }
+
+void 
+ModuleClassTable::activateAlias(const std::string& aliasname, ModuleClassPtr module)
+{
+	if(!module->isActive()){
+		LsysError("Inactive module '"+module->name+"' for alias.");
+	}
+	ModuleClassPtr previous = find(aliasname);
+	if (previous) {
+		if (previous == module) LsysWarning("Redeclaration of alias '"+aliasname+"'.");
+		else LsysError("Redeclaration of alias '"+aliasname+"' as '"+module->name+"' (previously '"+previous->name+"').");
+	}
+	else {
+		ThreadAliases[aliasname] = module;
+		if(ThreadAliasMaxLength < aliasname.size()) ThreadAliasMaxLength = aliasname.size();
+	}
+}
+
+bool 
+ModuleClassTable::desactivateAlias(const std::string& aliasname)
+{
+	ThreadAliasMap::iterator italias = ThreadAliases.find(aliasname);
+	if (italias == ThreadAliases.end()) return false;
+	ThreadAliases.erase(italias);
+	if (ThreadAliases.empty()) ThreadAliasMaxLength = 0;
+	return true;
+}
+
 ModuleClassPtr
 ModuleClassTable::getClass(const std::string& name)
 {
-	ModuleClassMap::const_iterator itname;
-	if((itname = modulenamemap.find(name)) == modulenamemap.end()){
-		if (mandatory_declaration) LsysError("Undefined module '"+name+"'.");
+	ReadSection tables(*this);
+	ModuleClassMap::const_iterator itname = tables->modulenamemap.find(name);
+	if(itname == tables->modulenamemap.end() || !itname->second->isActive()){
+		ThreadAliasMap::const_iterator italias = ThreadAliases.find(name);
+		if (italias != ThreadAliases.end() && italias->second->isActive()) return italias->second;
+	}
+	if(itname == tables->modulenamemap.end()){
+		if (MandatoryDeclaration) LsysError("Undefined module '"+name+"'.");
 		else return declare(name);
 	}
 	else if(!itname->second->isActive()){
-		if (mandatory_declaration) LsysError("Undefined module '"+name+"'.");
-		else { itname->second->activate(); return itname->second; }
+		if (MandatoryDeclaration) LsysError("Undefined module '"+name+"'.");
+		else { itname->second->activateInCurrentContext(); return itname->second; }
 	}
 	return itname->second;
 }
@@ -349,34 +639,44 @@ ModuleClassTable::getClass(const std::string& name)
 ModuleClassPtr
 ModuleClassTable::find(const std::string& name) const
 {
+	ReadSection tables(*this);
 	ModuleClassMap::const_iterator itname;
-	if((itname = modulenamemap.find(name)) == modulenamemap.end() || (!itname->second->isActive()))
+	if((itname = tables->modulenamemap.find(name)) == tables->modulenamemap.end() || (!itname->second->isActive())) {
+		ThreadAliasMap::const_iterator italias = ThreadAliases.find(name);
+		if (italias != ThreadAliases.end() && italias->second->isActive()) return italias->second;
 		return ModuleClassPtr(0);
+	}
 	return itname->second;
 }
 
 ModuleClassPtr
 ModuleClassTable::find(size_t id) const
 {
+	ReadSection tables(*this);
 	ModuleClassIdMap::const_iterator it;
-	if((it = modulenamelist.find(id)) == modulenamelist.end() || !it->second->isActive())
+	if((it = tables->modulenamelist.find(id)) == tables->modulenamelist.end() || !it->second->isActive())
 		LsysError("Undefined module with id "+TOOLS(number)(id)+".");
 	return it->second;
 }
 
 ModuleClassList ModuleClassTable::getClasses() const {
+	ReadSection tables(*this);
 	ModuleClassList res;
-	for(ModuleClassIdMap::const_iterator itid = modulenamelist.begin();
-		itid != modulenamelist.end(); ++itid)
+	for(ModuleClassIdMap::const_iterator itid = tables->modulenamelist.begin();
+		itid != tables->modulenamelist.end(); ++itid)
 		if(itid->second->isActive())
 			res.push_back(itid->second);
 	return res;
 }
 
 std::vector<std::string> ModuleClassTable::getNames() const {
+	ReadSection tables(*this);
 	std::vector<std::string> res;
-	for(ModuleClassMap::const_iterator it = modulenamemap.begin();
-		it != modulenamemap.end(); ++it)
+	for(ModuleClassMap::const_iterator it = tables->modulenamemap.begin();
+		it != tables->modulenamemap.end(); ++it)
+		if(it->second->isActive())
+			res.push_back(it->first);
+	for(ThreadAliasMap::const_iterator it = ThreadAliases.begin(); it != ThreadAliases.end(); ++it)
 		if(it->second->isActive())
 			res.push_back(it->first);
 	return res;
@@ -385,28 +685,30 @@ std::vector<std::string> ModuleClassTable::getNames() const {
 bool 
 ModuleClassTable::remove(const std::string& name)
 {
+	if (desactivateAlias(name)) return true;
+	Transaction tables(*this);
 	ModuleClassMap::iterator it;
-	std::vector<std::string>::iterator aliasiter;
-	if((it = modulenamemap.find(name)) != modulenamemap.end() && it->second->isActive()){
+	if((it = tables->modulenamemap.find(name)) != tables->modulenamemap.end() && it->second->isActive()){
 		if (it->second->name == name)
 		{   
-			if (it->second->aliases.size() > 0) {
+			ModuleClass::AliasList aliases = *std::atomic_load(&it->second->m_aliases);
+			if (aliases.size() > 0) {
 				// if has alias, rename class using first alias name
-				it->second->name = it->second->aliases[0];
-				it->second->aliases.erase(it->second->aliases.begin());
+				it->second->name = aliases[0];
+				it->second->removeAlias(aliases[0]);
 			}
 			else {
 				// no more name reference this modclass, so remove it from idmap.
-				ModuleClassIdMap::iterator itid = modulenamelist.find(it->second->getId());
-				if (itid != modulenamelist.end())modulenamelist.erase(itid);
+				ModuleClassIdMap::iterator itid = tables->modulenamelist.find(it->second->getId());
+				if (itid != tables->modulenamelist.end())tables->modulenamelist.erase(itid);
 			}
 		}
-		else if((aliasiter = std::find(it->second->aliases.begin(),it->second->aliases.end(),name)) != it->second->aliases.end())
-		{   // remove name from aliases
-			it->second->aliases.erase(aliasiter); 
+		else {   // remove name from aliases
+			it->second->removeAlias(name); 
 		}
 		// remove name
-		modulenamemap.erase(it);
+		tables->modulenamemap.erase(it);
+		m_removals.fetch_add(1, std::memory_order_acq_rel);
 		return true;
 	}
 	return false;
@@ -415,19 +717,21 @@ ModuleClassTable::remove(const std::string& name)
 
 bool ModuleClassTable::remove(const ModuleClass * moduleclass)
 {
+	Transaction tables(*this);
 	bool has_removed = false;
-	for(ModuleClassMap::iterator itname = modulenamemap.begin(); itname != modulenamemap.end(); ){
-		if (itname->second == moduleclass){
+	for(ModuleClassMap::iterator itname = tables->modulenamemap.begin(); itname != tables->modulenamemap.end(); ){
+		if (itname->second.get() == moduleclass){
 			ModuleClassMap::iterator itname2 = itname;
 			itname2++;
-			modulenamemap.erase(itname);
+			tables->modulenamemap.erase(itname);
 			has_removed = true;
 			itname = itname2;
 		}
 		else ++itname;
 	}
-	ModuleClassIdMap::iterator itid = modulenamelist.find(moduleclass->getId());
-	if (itid != modulenamelist.end())modulenamelist.erase(itid);
+	ModuleClassIdMap::iterator itid = tables->modulenamelist.find(moduleclass->getId());
+	if (itid != tables->modulenamelist.end())tables->modulenamelist.erase(itid);
+	m_removals.fetch_add(1, std::memory_order_acq_rel);
 	return has_removed;
 }
 
@@ -438,16 +742,25 @@ ModuleClassTable::parse(std::string::const_iterator beg,
 					   std::string::const_iterator end,
 					   size_t& nsize)
 {
-	size_t wordlength = std::min<size_t>(maxnamelength+1,std::distance(beg,end));
-	ModuleClassMap::iterator itname;
+	ReadSection tables(*this);
+	size_t wordlength = std::min<size_t>(std::max(tables->maxnamelength,ThreadAliasMaxLength)+1,std::distance(beg,end));
+	ModuleClassMap::const_iterator itname;
 	for (size_t w = wordlength; w > 0; --w){
-		itname = modulenamemap.find(std::string(beg,beg+w));
-		if(itname != modulenamemap.end() && itname->second->isActive()){
+		std::string word(beg,beg+w);
+		itname = tables->modulenamemap.find(word);
+		if(itname != tables->modulenamemap.end() && itname->second->isActive()){
 			nsize = w;
 			return itname->second;
 		}
+		if(!ThreadAliases.empty()){
+			ThreadAliasMap::const_iterator italias = ThreadAliases.find(word);
+			if(italias != ThreadAliases.end() && italias->second->isActive()){
+				nsize = w;
+				return italias->second;
+			}
+		}
 	}
-	if (mandatory_declaration) return ModuleClassPtr();
+	if (MandatoryDeclaration) return ModuleClassPtr();
 	else { 
 		ModuleClassPtr modclass = declare(*beg);
 		LsysContext::currentContext()->declare(modclass);
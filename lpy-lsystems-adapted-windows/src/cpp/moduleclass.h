@@ -35,6 +35,9 @@
 #include "../plantgl/tool/util_hashmap.h"
 #include "../plantgl/tool/rcobject.h"
 #include "modulevtable.h"
+#include <memory>
+#include <atomic>
+#include <QtCore/QMutex>
 
 LPY_BEGIN_NAMESPACE
 
@@ -144,6 +147,7 @@ public:
 
 	friend class ModuleVTable;
 	friend class LsysContext;
+	friend class ModuleClassTable;
 
 	ModuleClass(const std::string& name);
 	ModuleClass(const std::string& name, const std::string& alias);
@@ -154,7 +158,9 @@ public:
 	void activate(bool value = true) ;
 	inline void desactivate() { activate(false); }
 
-	inline bool isActive() const { return active; }
+	/** Activation of the class on the current thread. A thread that never activated
+	    nor desactivated the class sees the state last set by any thread. */
+	bool isActive() const ;
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
 	virtual void interpret(ParamModule& m, PGL::Turtle& t) ;
 #endif
@@ -162,7 +168,16 @@ public:
 	virtual bool isPredefined() const { return false; }
 
 	std::string name;
-	std::vector<std::string> aliases;
+
+	typedef std::vector<std::string> AliasList;
+	typedef std::shared_ptr<const AliasList> AliasListPtr;
+
+	/** Alias names of the class, including the aliases activated on the current thread
+	    (see ModuleClassTable::activateAlias). The list is never modified in place: a change 
+		publishes a new copy, so that readers of the module class table can access it concurrently. */
+	AliasList getAliases() const ;
+	void addAlias(const std::string& alias);
+	bool removeAlias(const std::string& alias);
 
 	static ModuleClassList& getPredefinedClasses();
 	static void clearPredefinedClasses();
@@ -175,14 +190,18 @@ public:
 	inline bool isExactRightBracket() const { return this == ModuleClass::ExactRightBracket; }
 	inline bool isBracket() const { return isLeftBracket() || isRightBracket() || isExactRightBracket(); }
 
+	/// Virtual table activated on the current thread, if any.
+	ModuleVTable * getVTable() const ;
+
 	inline int getScale() const 
-	{ if (m_vtable) return m_vtable->scale; 
+	{ ModuleVTable * vtable = getVTable();
+	  if (vtable) return vtable->scale; 
 	  else return DEFAULT_SCALE; }
 
 	void setScale(int scale);
 
 	inline ModulePropertyPtr getProperty(const std::string& name) const 
-	{ if (m_vtable) return m_vtable->getProperty(name); else return ModulePropertyPtr(); }
+	{ ModuleVTable * vtable = getVTable(); if (vtable) return vtable->getProperty(name); else return ModulePropertyPtr(); }
 
 	void setProperty(ModulePropertyPtr prop);
 
@@ -190,17 +209,18 @@ public:
 	ModuleClassList getBases() const;
 
 	inline bool hasBaseClasses() const 
-	{ if (m_vtable) return m_vtable->hasBaseClasses(); else return false; }
+	{ ModuleVTable * vtable = getVTable(); if (vtable) return vtable->hasBaseClasses(); else return false; }
 
 	inline bool issubclass(const ModuleClassPtr& other) const
 	{
 		if (other.get() == this) return true;
-		if(m_vtable) return m_vtable->issubclass(other);
+		ModuleVTable * vtable = getVTable();
+		if(vtable) return vtable->issubclass(other);
 		else return false;
 	}
 
 	inline std::vector<size_t> getAllBaseIds() const 
-	{ if (m_vtable) return m_vtable->getAllBaseIds(); else { return std::vector<size_t>(); } } 
+	{ ModuleVTable * vtable = getVTable(); if (vtable) return vtable->getAllBaseIds(); else { return std::vector<size_t>(); } } 
 
 	bool removeProperty(const std::string& name);
 	bool isOnlyInPattern() const { return onlyInPattern; }
@@ -221,18 +241,33 @@ public:
 	inline bool hasParameter(const std::string& name) const 
 	{ return getParameterPosition(name) != NOPOS; }
 
-	static size_t getMaxId() { return MAXID; }
+	static size_t getMaxId() { return MAXID.load(); }
 
 protected:
 	static ModuleClassList * PredefinedClasses;
 	bool onlyInPattern;
 private:
 	size_t id;
-	bool active;
-
-	static size_t MAXID;
-
-	ModuleVTablePtr m_vtable;
+	std::atomic<bool> active;
+	// unique over the whole session, as ids of deleted classes are reused
+	uint64_t m_serial;
+
+	static std::atomic<size_t> MAXID;
+	AliasListPtr m_aliases;
+
+	/* Activation and virtual table of the class on each thread. Contexts activate
+	   their classes and virtual tables when they become current on a thread. */
+	struct ThreadState;
+	static std::vector<ThreadState>& getThreadStates();
+	ThreadState * getThreadState() const;
+	ThreadState& setThreadState();
+
+	/** Activation on the current thread only, used by contexts when they become current
+	    or are done. The shared state is only changed by activations outside Lsystems. */
+	void activateOnThread(bool value = true);
+	void activateInCurrentContext();
+
+	void setVTable(ModuleVTable * vtable);
 	void create_vtable();
 
 	ParameterNameDict m_paramnames;
@@ -308,26 +343,62 @@ public:
 
 	bool remove(const std::string& name);
 	bool remove(const ModuleClass * moduleclass);
+	/// Number of removals of classes from the table. Ids of classes stay valid while it does not change.
+	inline size_t removals() const { return m_removals.load(std::memory_order_acquire); }
 
 	void reset();
-	size_t size() const { return modulenamelist.size(); }
-	bool empty() const { return modulenamelist.empty(); }
+	size_t size() const ;
+	bool empty() const ;
 	ModuleClassList getClasses() const ;
 	std::vector<std::string> getNames() const ;
 
-	static void setMandatoryDeclaration(bool value) { get().mandatory_declaration = value; }
-	bool mandatory_declaration;
+	/// Option of the current context, set per thread.
+	static void setMandatoryDeclaration(bool value) ;
+	static bool isMandatoryDeclaration() ;
+
+	/** Aliases visible only on the current thread. Contexts activate their aliases
+	    when they become current and desactivate them when they are done. */
+	void activateAlias(const std::string& aliasname, ModuleClassPtr module);
+	bool desactivateAlias(const std::string& aliasname);
 
 	ModuleClassPtr parse(std::string::const_iterator beg, std::string::const_iterator end,
 					    size_t& nsize);
 
 protected:
 
-	typedef  pgl_hash_map_string<ModuleClass *> ModuleClassMap;
-    typedef pgl_hash_map<size_t,ModuleClass *> ModuleClassIdMap;
-	ModuleClassMap  modulenamemap;
-	ModuleClassIdMap modulenamelist;
-	size_t maxnamelength;
+	typedef  pgl_hash_map_string<ModuleClassPtr> ModuleClassMap;
+    typedef pgl_hash_map<size_t,ModuleClassPtr> ModuleClassIdMap;
+
+	/** Name and id tables. A published snapshot is never modified: lookups read
+	    the current one through a ReadSection and never wait for writers, while
+	    modifications are done on a copy (see Transaction) that is then published.
+		Snapshots hold references on their classes, so that a class handed out by an old 
+		snapshot stays valid. A declared class is thus only deleted once it is removed 
+		from the table and no snapshot refers to it anymore. */
+	struct Snapshot {
+		ModuleClassMap  modulenamemap;
+		ModuleClassIdMap modulenamelist;
+		size_t maxnamelength;
+		Snapshot() : maxnamelength(0) { }
+	};
+
+	class Transaction;
+	friend class Transaction;
+	class ReadSection;
+	friend class ReadSection;
+
+	/** The published snapshot is a plain pointer. A replaced snapshot is retired with
+	    the epoch of its replacement and deleted by a later writer once no reader 
+		entered its read section before that epoch (see ReadSection). */
+	typedef std::vector<std::pair<uint64_t,const Snapshot *> > RetiredSnapshotList;
+	void retire(const Snapshot * snapshot);
+
+	std::atomic<const Snapshot *> m_snapshot;
+	std::atomic<uint64_t> m_epoch;
+	RetiredSnapshotList m_retired;
+	Snapshot * m_pending;
+	QMutex m_writemutex;
+	std::atomic<size_t> m_removals;
 
 	void clear();
 	void registerPredefinedModule();
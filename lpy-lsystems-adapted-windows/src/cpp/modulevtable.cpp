@@ -46,12 +46,12 @@ bool ModuleVTable::removeProperty(const std::string& name)
 
 void ModuleVTable::activate()
 {
-	if(m_owner)m_owner->m_vtable = ModuleVTablePtr(this);
+	if(m_owner)m_owner->setVTable(this);
 }
 
 void ModuleVTable::desactivate()
 {
-	if(m_owner)m_owner->m_vtable = ModuleVTablePtr();
+	if(m_owner)m_owner->setVTable(NULL);
 }
 
 void ModuleVTable::setBase(ModuleClassPtr mclass) 
@@ -88,7 +88,7 @@ void ModuleVTable::updateInheritedParameters()
 			bases.erase(bases.begin());
 			m_modulebasescache.insert(base->getId());
 			if (base != NULL){
-				ModuleVTable * basevtable = base->m_vtable;
+				ModuleVTable * basevtable = base->getVTable();
 				if( basevtable ) {
 					if(scale == ModuleClass::DEFAULT_SCALE) scale = basevtable->scale;
 					bases.insert(bases.begin(),basevtable->m_modulebases.begin(),basevtable->m_modulebases.end());
@@ -0,0 +1,331 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "nativerule.h"
+#include "moduleclass.h"
+#include "lsyscontext.h"
+#include "error.h"
+#include "gilrelease.h"
+#include <QtCore/QLibrary>
+#include <QtCore/QFileInfo>
+#include <QtCore/QDir>
+#include <algorithm>
+
+#define bp boost::python
+
+LPY_USING_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+namespace {
+
+/** Production under construction. The plugin function runs without the GIL: values 
+	are recorded and turned into python objects once the GIL is held again (see build).
+	Errors must not be propagated through the frames of the plugin: callbacks
+	record the first one and return an error code. */
+struct ProductionBuilder {
+	struct Value {
+		int type;
+		long long intValue;
+		double realValue;
+		PyObject * object; // borrowed from the arguments of the call
+	};
+
+	struct PendingModule {
+		size_t classid;
+		std::vector<Value> values;
+	};
+
+	std::vector<PendingModule> modules;
+	ModuleClassList * classes;
+	std::string error;
+
+	ProductionBuilder(ModuleClassList * _classes) : classes(_classes) {}
+
+	int fail(const std::string& msg) {
+		if (error.empty()) error = msg;
+		return -1;
+	}
+
+	/// To be called in a catch block, with the GIL held.
+	int failWithCurrentException() {
+		try { throw; }
+		catch (bp::error_already_set) {
+			PyObject * type, * value, * traceback;
+			PyErr_Fetch(&type, &value, &traceback);
+			bp::object etype(bp::handle<>(bp::allow_null(type)));
+			bp::object evalue(bp::handle<>(bp::allow_null(value)));
+			bp::object etraceback(bp::handle<>(bp::allow_null(traceback)));
+			try { return fail(bp::extract<std::string>(bp::str(evalue != bp::object() ? evalue : etype))()); }
+			catch (...) { PyErr_Clear(); return fail("python error"); }
+		}
+		catch (std::exception& e) { return fail(e.what()); }
+		catch (...) { return fail("unknown error"); }
+	}
+
+	inline int add(int type, long long intValue, double realValue, PyObject * object = NULL) {
+		if (modules.empty()) return fail("value added before any module.");
+		Value value = { type, intValue, realValue, object };
+		modules.back().values.push_back(value);
+		return 0;
+	}
+
+	/// Create the production. To be called with the GIL held.
+	AxialTree build() const {
+		AxialTree result;
+		for (std::vector<PendingModule>::const_iterator it = modules.begin(); it != modules.end(); ++it) {
+			result.append(ParamModule(it->classid));
+			ParamModule& module = result.last();
+			for (std::vector<Value>::const_iterator itv = it->values.begin(); itv != it->values.end(); ++itv) {
+				if (itv->object != NULL) module.append(bp::object(bp::handle<>(bp::borrowed(itv->object))));
+				else switch(itv->type){
+					case LPY_ARG_BOOL: module.append(bp::object(itv->intValue != 0)); break;
+					case LPY_ARG_INT:  module.append(bp::object(itv->intValue)); break;
+					case LPY_ARG_REAL: module.append(bp::object(itv->realValue)); break;
+					default:           module.append(bp::object()); break;
+				}
+			}
+		}
+		return result;
+	}
+
+	static int moduleClass(void * handle, const char * name) {
+		ProductionBuilder * builder = (ProductionBuilder *)handle;
+		if (name == NULL) return builder->fail("no module class name given.");
+		// the lookup may declare the class and report errors through python
+		PyGILState_STATE gilstate = PyGILState_Ensure();
+		int res;
+		try { 
+			// the class is kept alive so that the plugin can reuse its id in later calls
+			ModuleClassPtr mclass = ModuleClassTable::get().getClass(name);
+			ModuleClassList& classes = *builder->classes;
+			if (std::find(classes.begin(), classes.end(), mclass) == classes.end()) classes.push_back(mclass);
+			res = int(mclass->getId()); 
+		}
+		catch(...) { res = builder->failWithCurrentException(); }
+		PyGILState_Release(gilstate);
+		return res;
+	}
+
+	static int beginModule(void * handle, int classid) {
+		ProductionBuilder * builder = (ProductionBuilder *)handle;
+		if (classid < 0 || size_t(classid) >= ModuleClass::getMaxId()) return builder->fail("invalid module class id.");
+		PendingModule module;
+		module.classid = size_t(classid);
+		builder->modules.push_back(module);
+		return 0;
+	}
+
+	static int addBool(void * handle, int value) {
+		return ((ProductionBuilder *)handle)->add(LPY_ARG_BOOL, value != 0, 0);
+	}
+
+	static int addInt(void * handle, long long value) {
+		return ((ProductionBuilder *)handle)->add(LPY_ARG_INT, value, 0);
+	}
+
+	static int addReal(void * handle, double value) {
+		return ((ProductionBuilder *)handle)->add(LPY_ARG_REAL, 0, value);
+	}
+
+	static int addArg(void * handle, const LpyArgView * arg) {
+		ProductionBuilder * builder = (ProductionBuilder *)handle;
+		if (arg == NULL) return builder->fail("no argument given.");
+		if (arg->object != NULL) return builder->add(LPY_ARG_OBJECT, 0, 0, (PyObject *)arg->object);
+		switch(arg->type){
+			case LPY_ARG_BOOL: return addBool(handle,int(arg->intValue));
+			case LPY_ARG_INT:  return addInt(handle,arg->intValue);
+			case LPY_ARG_REAL: return addReal(handle,arg->realValue);
+			case LPY_ARG_NONE: return builder->add(LPY_ARG_NONE, 0, 0);
+			default: return builder->fail("invalid argument type.");
+		}
+	}
+
+	static double random(void * handle) {
+		return LsysContext::currentContext()->random();
+	}
+};
+
+inline void setView(LpyArgView& view, PyObject * value)
+{
+	view.object = value;
+	view.intValue = 0;
+	view.realValue = 0;
+	if (value == Py_None) view.type = LPY_ARG_NONE;
+	else if (PyBool_Check(value)) {
+		view.type = LPY_ARG_BOOL;
+		view.intValue = (value == Py_True ? 1 : 0);
+		view.realValue = double(view.intValue);
+	}
+	else if (PyLong_Check(value)) {
+		int overflow = 0;
+		view.intValue = PyLong_AsLongLongAndOverflow(value, &overflow);
+		if (overflow != 0) view.type = LPY_ARG_OBJECT;
+		else {
+			view.type = LPY_ARG_INT;
+			view.realValue = double(view.intValue);
+		}
+	}
+	else if (PyFloat_Check(value)) {
+		view.type = LPY_ARG_REAL;
+		view.realValue = PyFloat_AS_DOUBLE(value);
+	}
+	else view.type = LPY_ARG_OBJECT;
+}
+
+}
+
+/*---------------------------------------------------------------------------*/
+
+NativeRule::NativeRule(const std::string& library, const std::string& symbol, const std::string& predecessor,
+					   LpyNativeRule function, void * userdata):
+	m_library(library), m_symbol(symbol), m_predecessor(predecessor), 
+	m_function(function), m_userdata(userdata) 
+{}
+
+#define MAX_NATIVE_LOCAL_ARITY 16
+
+AxialTree NativeRule::apply(const ArgList& args, bool * isApplied) const
+{
+	size_t nbargs = len(args);
+	LpyArgView localviews[MAX_NATIVE_LOCAL_ARITY];
+	std::vector<LpyArgView> heapviews;
+	LpyArgView * views = localviews;
+	if (nbargs > MAX_NATIVE_LOCAL_ARITY) { heapviews.resize(nbargs); views = &heapviews[0]; }
+	for(size_t i = 0; i < nbargs; ++i) setView(views[i], bp::object(args[i]).ptr());
+
+	ProductionBuilder production(&m_classes);
+	LpyProductionBuilder builder = { &production, 
+									 &ProductionBuilder::moduleClass, 
+									 &ProductionBuilder::beginModule, 
+									 &ProductionBuilder::addBool, 
+									 &ProductionBuilder::addInt, 
+									 &ProductionBuilder::addReal, 
+									 &ProductionBuilder::addArg,
+									 &ProductionBuilder::random };
+	int res;
+	{
+		GilFreeSection nogil;
+		res = m_function(views, nbargs, &builder, m_userdata);
+	}
+	if (!production.error.empty()) LsysError("Native rule '"+name()+"' failed: "+production.error);
+	if (res < 0) LsysError("Native rule '"+name()+"' failed.");
+	if (isApplied) *isApplied = (res > 0);
+	if (res == 0) return AxialTree();
+	return production.build();
+}
+
+bool NativeRule::isCompatible(const PatternString& predecessor) const
+{
+	if (m_predecessor.empty()) return true;
+	PatternString pattern(m_predecessor);
+	if (pattern.size() != predecessor.size()) return false;
+	for (PatternString::const_iterator it = pattern.const_begin(), it2 = predecessor.const_begin(); 
+		 it != pattern.const_end(); ++it, ++it2)
+		if (it->getClass() != it2->getClass() || it->size() != it2->size()) return false;
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+
+NativeRuleTable * NativeRuleTable::m_INSTANCE = NULL;
+
+NativeRuleTable& NativeRuleTable::get() { 
+	if (!NativeRuleTable::m_INSTANCE){
+		NativeRuleTable::m_INSTANCE = new NativeRuleTable();
+	}
+	return *m_INSTANCE; 
+}
+
+int NativeRuleTable::registerRule(void * handle, const char * symbol, const char * predecessor, LpyNativeRule function, void * userdata)
+{
+	if (symbol == NULL || function == NULL) return -1;
+	NativeRuleTable * table = (NativeRuleTable *)handle;
+	try {
+		std::pair<std::string,std::string> key(table->m_loading, symbol);
+		if (table->m_rules.find(key) != table->m_rules.end()) return -1;
+		table->m_rules.insert(NativeRuleMap::value_type(key, NativeRule(table->m_loading, symbol, predecessor?predecessor:"", function, userdata)));
+	}
+	catch(...) { return -1; }
+	return 0;
+}
+
+bool NativeRuleTable::load(const std::string& library)
+{
+	if (m_libraries.find(library) != m_libraries.end()) return true;
+	QLibrary * lib = new QLibrary(QString(library.c_str()));
+	if (!lib->load()) { delete lib; return false; }
+	LpyPluginInit init = (LpyPluginInit)lib->resolve(LPY_PLUGIN_INIT_SYMBOL);
+	if (init == NULL) {
+		delete lib;
+		LsysError("Library '"+library+"' is not a L-Py plugin: no '" LPY_PLUGIN_INIT_SYMBOL "' function.");
+	}
+	m_libraries[library] = lib;
+	LpyPluginRegistry registry = { LPY_PLUGIN_ABI_VERSION, this, &NativeRuleTable::registerRule };
+	m_loading = library;
+	int res = init(&registry);
+	m_loading.clear();
+	if (res != 0) {
+		// the rules registered before the failure would point into the unloaded library
+		for (NativeRuleMap::iterator it = m_rules.begin(); it != m_rules.end(); ) {
+			if (it->first.first == library) it = m_rules.erase(it);
+			else ++it;
+		}
+		m_libraries.erase(library);
+		lib->unload();
+		delete lib;
+		LsysError("Initialisation of plugin '"+library+"' failed.");
+	}
+	return true;
+}
+
+const NativeRule * NativeRuleTable::find(const std::string& library, const std::string& symbol, const std::string& directory)
+{
+	std::string path = library;
+	if (!directory.empty() && QFileInfo(QString(library.c_str())).isRelative()) {
+		path = QDir(QString(directory.c_str())).filePath(QString(library.c_str())).toStdString();
+		if (!load(path) && library.find_first_of("/\\") == std::string::npos) path = library;
+	}
+	if (!load(path)) LsysError("Cannot load plugin library '"+path+"'.");
+	NativeRuleMap::const_iterator it = m_rules.find(std::pair<std::string,std::string>(path, symbol));
+	if (it == m_rules.end()) LsysError("Plugin '"+path+"' has no native rule '"+symbol+"'.");
+	return &it->second;
+}
+
+std::vector<std::string> NativeRuleTable::symbols(const std::string& library) const
+{
+	std::vector<std::string> result;
+	for (NativeRuleMap::const_iterator it = m_rules.begin(); it != m_rules.end(); ++it)
+		if (it->first.first == library) result.push_back(it->first.second);
+	return result;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,106 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "axialtree.h"
+#include "argcollector.h"
+#include "patternstring.h"
+#include "lpy_plugin.h"
+#include <map>
+
+class QLibrary;
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/// A rule implemented in a plugin library (see lpy_plugin.h).
+class LPY_API NativeRule {
+public:
+	NativeRule(const std::string& library, const std::string& symbol, const std::string& predecessor,
+		       LpyNativeRule function, void * userdata);
+
+	AxialTree apply(const ArgList& args, bool * isApplied = NULL) const;
+
+	/// Check that predecessor has the same modules, with the same number of parameters, as the registered pattern.
+	bool isCompatible(const PatternString& predecessor) const;
+
+	inline const std::string& library() const { return m_library; }
+	inline const std::string& symbol() const { return m_symbol; }
+	inline const std::string& predecessor() const { return m_predecessor; }
+	inline std::string name() const { return m_library+':'+m_symbol; }
+
+protected:
+	std::string m_library;
+	std::string m_symbol;
+	std::string m_predecessor;
+	LpyNativeRule m_function;
+	void * m_userdata;
+	mutable ModuleClassList m_classes; // classes requested by the plugin
+};
+
+/*---------------------------------------------------------------------------*/
+
+/** 
+	Table of the loaded plugins. Libraries are loaded on first use and unloaded only if their initialisation fails,
+	so that the returned rules stay valid.
+*/
+class LPY_API NativeRuleTable {
+public:
+	static NativeRuleTable& get();
+
+	/** Return the rule registered under symbol by library, loading it if needed. Raise an error if not found.
+		A relative library path is first searched in directory, then, if it has no directory part, by the system loader. */
+	const NativeRule * find(const std::string& library, const std::string& symbol, const std::string& directory = "");
+
+	/// Load library and register its rules. Return false if it cannot be loaded.
+	bool load(const std::string& library);
+
+	std::vector<std::string> symbols(const std::string& library) const;
+
+protected:
+	NativeRuleTable() {}
+
+	static int registerRule(void * handle, const char * symbol, const char * predecessor, LpyNativeRule function, void * userdata);
+
+	typedef std::map<std::pair<std::string,std::string>, NativeRule> NativeRuleMap;
+	typedef std::map<std::string, QLibrary *> LibraryMap;
+
+	NativeRuleMap m_rules;
+	LibraryMap m_libraries;
+	std::string m_loading;
+
+	static NativeRuleTable * m_INSTANCE;
+};
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
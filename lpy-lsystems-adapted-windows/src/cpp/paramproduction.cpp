@@ -56,21 +56,22 @@ ParamProductionManager * ParamProductionManager::Instance(0);
 
 ParamProductionManager& ParamProductionManager::get()
 {
-	if (ParamProductionManager::Instance == NULL)
-		ParamProductionManager::Instance = new ParamProductionManager();
-	return *ParamProductionManager::Instance;
+	// thread safe creation of the singleton
+	static ParamProductionManager * instance = (ParamProductionManager::Instance = new ParamProductionManager());
+	return *instance;
 }
 
 ParamProductionManager::ParamProductionManager():
-	m_productions(), m_free_indices()
+	m_productions()
 {
 }
 
 ParametricProductionPtr ParamProductionManager::get_production(size_t pid)
 {
-	if (pid < m_productions.size())
+	ParametricProduction * production = m_productions.get(pid);
+	if (production != NULL)
 	{
-		return ParametricProductionPtr(m_productions[pid]);
+		return ParametricProductionPtr(production);
 	}
 	else 
 	{
@@ -83,28 +84,10 @@ ParametricProductionPtr ParamProductionManager::get_production(size_t pid)
 
 void ParamProductionManager::add_production(ParametricProduction& value)
 {
-
-	size_t pid;
-	if (m_free_indices.empty()){
-		pid = m_productions.size();
-		m_productions.push_back(&value);
-	}
-	else {
-		pid = m_free_indices.front();
-		m_free_indices.pop();
-		m_productions[pid] = & value;
-	}
-
-	value.m_pid = pid;
+	value.m_pid = m_productions.insert(&value);
 }
 
 void ParamProductionManager::remove_production(ParametricProduction& value)
 {
-	size_t pid = value.pid();
-	if (pid == m_productions.size())
-		m_productions.pop_back();
-	else {
-		m_free_indices.push(pid);
-		m_productions[pid] = NULL;
-	}
+	m_productions.remove(value.pid());
 }
@@ -32,7 +32,7 @@
 
 #include "axialtree.h"
 #include "../plantgl/tool/util_hashmap.h"
-#include <queue>
+#include "concurrenttable.h"
 
 LPY_BEGIN_NAMESPACE
 
@@ -170,7 +170,7 @@ public:
 	ParametricProductionPtr get_production(size_t pid);
 
 protected:
-	typedef std::vector<ParametricProduction *> ParametricProductionMap;
+	typedef ConcurrentIdTable<ParametricProduction> ParametricProductionMap;
 
 	static ParamProductionManager * Instance;
 
@@ -180,7 +180,6 @@ protected:
 	ParamProductionManager();
 
 	ParametricProductionMap m_productions;
-	std::queue<size_t> m_free_indices;
 
 };
 
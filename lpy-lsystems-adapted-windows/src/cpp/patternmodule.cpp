@@ -42,10 +42,54 @@ LPY_USING_NAMESPACE
 
 
 LsysVar::LsysVar(const std::string& n):
-	m_name(n),m_conditionType(NoCondition){}
+	m_name(n),m_conditionType(NoCondition),
+	m_nativeComparison(NoNativeComparison), m_nativeValue(0) {}
 
 LsysVar::LsysVar(boost::python::object value):
-	m_name(), m_pyvalue(value), m_conditionType(EqualValueCondition) {}
+	m_name(), m_pyvalue(value), m_conditionType(EqualValueCondition),
+	m_nativeComparison(NoNativeComparison), m_nativeValue(0)
+{ setNativeComparison(NativeEqual,value); }
+
+/*
+  Numeric value of a python int or float that can be compared as a double
+  with the same result as in python. Big integers, bool-like or other types
+  are left to python comparison.
+*/
+static inline bool getNativeNumber(PyObject * value, double& result)
+{
+	if (PyFloat_CheckExact(value)) {
+		result = PyFloat_AS_DOUBLE(value);
+		return true;
+	}
+	if (PyLong_CheckExact(value)) {
+		int overflow = 0;
+		long long v = PyLong_AsLongLongAndOverflow(value,&overflow);
+		const long long maxexactint = 1LL << 53;
+		if (overflow != 0 || v > maxexactint || v < -maxexactint) return false;
+		result = double(v);
+		return true;
+	}
+	return false;
+}
+
+void LsysVar::setNativeComparison(NativeComparison op, const boost::python::object& constant)
+{
+	if (getNativeNumber(constant.ptr(),m_nativeValue)) m_nativeComparison = op;
+	else m_nativeComparison = NoNativeComparison;
+}
+
+bool LsysVar::nativeCompare(double value) const
+{
+	switch(m_nativeComparison) {
+		case NativeEqual:        return value == m_nativeValue;
+		case NativeNotEqual:     return value != m_nativeValue;
+		case NativeLess:         return value <  m_nativeValue;
+		case NativeLessEqual:    return value <= m_nativeValue;
+		case NativeGreater:      return value >  m_nativeValue;
+		case NativeGreaterEqual: return value >= m_nativeValue;
+		default:                 return true;
+	}
+}
 
 
 std::string LsysVar::str() const
@@ -75,6 +119,10 @@ std::string LsysVar::varname() const
 
 bool LsysVar::isCompatible(const boost::python::object& value) const
 {
+	if (m_nativeComparison != NoNativeComparison) {
+		double nvalue;
+		if (getNativeNumber(value.ptr(),nvalue)) return nativeCompare(nvalue);
+	}
 	switch(m_conditionType) {
 		case EqualValueCondition:
 			return value == m_pyvalue;
@@ -97,6 +145,24 @@ void LsysVar::setCondition(const std::string& textualcondition, int lineno)
 	m_pyvalue = LsysContext::current()->evaluate(txt);
 	m_textualcondition = textualcondition;
 	m_conditionType = FunctionalCondition;
+	m_nativeComparison = NoNativeComparison;
+
+	// conditions such as 'x > 0.5' or '2 == x' are evaluated natively on numeric values
+	std::string lhs, rhs;
+	std::string op = LpyParsing::parse_comparison(textualcondition,lhs,rhs);
+	if (op.empty()) return;
+	bool reversed = false;
+	if (rhs == varname() && LpyParsing::isAConstant(lhs)) { std::swap(lhs,rhs); reversed = true; }
+	else if (lhs != varname() || !LpyParsing::isAConstant(rhs)) return;
+	NativeComparison nop;
+	if      (op == "==") nop = NativeEqual;
+	else if (op == "!=") nop = NativeNotEqual;
+	else if (op == "<")  nop = (reversed ? NativeGreater : NativeLess);
+	else if (op == "<=") nop = (reversed ? NativeGreaterEqual : NativeLessEqual);
+	else if (op == ">")  nop = (reversed ? NativeLess : NativeGreater);
+	else                 nop = (reversed ? NativeLessEqual : NativeGreaterEqual);
+	object constant = LsysContext::current()->try_evaluate(rhs);
+	if (constant != object()) setNativeComparison(nop,constant);
 }
 
 void LsysVar::setUnnamed()
@@ -45,6 +45,17 @@ class LPY_API LsysVar {
 		FunctionalCondition
 	};
 
+	/// Comparison that can be evaluated without calling python (see setCondition)
+	enum NativeComparison {
+		NoNativeComparison,
+		NativeEqual,
+		NativeNotEqual,
+		NativeLess,
+		NativeLessEqual,
+		NativeGreater,
+		NativeGreaterEqual
+	};
+
 	LsysVar(const std::string&);
 	LsysVar(boost::python::object value);
 
@@ -67,6 +78,8 @@ class LPY_API LsysVar {
 	inline bool isArgs() const { return !m_name.empty() && m_name[0] == '*' && (m_name.end() == m_name.begin()+1 ||m_name[1] != '*'); }
 	inline bool isKwds() const { return !m_name.empty() && m_name[0] == '*' && m_name.end() != m_name.begin()+1 && m_name[1] == '*'; }
 	inline bool hasCondition() const { return m_conditionType != NoCondition; }
+	inline bool hasNativeCondition() const { return m_nativeComparison != NoNativeComparison; }
+	inline NativeComparison nativeComparison() const { return m_nativeComparison; }
 
 	void setUnnamed();
 
@@ -77,6 +90,13 @@ class LPY_API LsysVar {
 	std::string m_textualcondition;
 	boost::python::object m_pyvalue;
 
+	/// numeric constant of the condition when it reduces to a comparison with a literal
+	NativeComparison m_nativeComparison;
+	double m_nativeValue;
+
+	void setNativeComparison(NativeComparison op, const boost::python::object& constant);
+	bool nativeCompare(double value) const;
+
 };
 
 /*---------------------------------------------------------------------------*/
@@ -109,6 +129,9 @@ protected:
 
 };
 
+template<>
+struct TrackedStringCategory<PatternModule> { static const Tracker::eCategory value = Tracker::ePatternString; };
+
 /*---------------------------------------------------------------------------*/
 
 LPY_END_NAMESPACE
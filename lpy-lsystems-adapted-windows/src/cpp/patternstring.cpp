@@ -54,6 +54,7 @@ PatternString::PatternString(const std::string& s, int lineno) : BaseType() {
 	  it != parsedstring.end(); ++it){
 		append(PatternModule(it->first,it->second,lineno));
   }
+  updateStringTracking();
 }
 
 std::vector<std::string> PatternString::getVarNames() const
@@ -131,25 +132,30 @@ PatternStringManager * PatternStringManager::Instance(0);
 
 PatternStringManager& PatternStringManager::get()
 {
-	if (PatternStringManager::Instance == NULL)
-		PatternStringManager::Instance = new PatternStringManager();
-	return *PatternStringManager::Instance;
+	// thread safe creation of the singleton
+	static PatternStringManager * instance = (PatternStringManager::Instance = new PatternStringManager());
+	return *instance;
 }
 
 PatternStringManager::~PatternStringManager()
 {
+	for(size_t pid = 0; pid < m_patterns.size(); ++pid)
+		delete m_patterns.remove(pid);
+	for(std::vector<PatternString *>::const_iterator it = m_removed.begin(); it != m_removed.end(); ++it)
+		delete *it;
 }
 
 PatternStringManager::PatternStringManager():
-	m_patterns(), m_free_indices()
+	m_patterns()
 {
 }
 
 const PatternString& PatternStringManager::get_pattern(size_t pid)
 {
-	if (pid < m_patterns.size())
+	const PatternString * pattern = m_patterns.get(pid);
+	if (pattern != NULL)
 	{
-		return m_patterns[pid];
+		return *pattern;
 	}
 	else 
 	{
@@ -162,26 +168,14 @@ const PatternString& PatternStringManager::get_pattern(size_t pid)
 
 size_t PatternStringManager::register_pattern(const PatternString& pattern)
 {
-	size_t pid;
-	if (m_free_indices.empty()){
-		pid = m_patterns.size();
-		m_patterns.push_back(pattern);
-	}
-	else {
-		pid = m_free_indices.front();
-		m_free_indices.pop();
-		m_patterns[pid] = pattern;
-	}
-	return pid;
+	return m_patterns.insert(new PatternString(pattern));
 }
 
 void PatternStringManager::remove_pattern(size_t pid)
 {
-	if (pid == m_patterns.size())
-		m_patterns.pop_back();
-	else {
-		m_free_indices.push(pid);
-		m_patterns[pid] = PatternString();
+	PatternString * pattern = m_patterns.remove(pid);
+	if (pattern != NULL) {
+		QMutexLocker locker(&m_removedmutex);
+		m_removed.push_back(pattern);
 	}
 }
-
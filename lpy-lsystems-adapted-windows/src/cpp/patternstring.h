@@ -32,7 +32,8 @@
 
 #include "abstractlstring.h"
 #include "patternmodule.h"
-#include <queue>
+#include "concurrenttable.h"
+#include <QtCore/QMutex>
 
 LPY_BEGIN_NAMESPACE
 
@@ -76,19 +77,23 @@ public:
 
 	const PatternString& get_pattern(size_t pid);
 	size_t register_pattern(const PatternString& pattern);
+	/** Unregister a pattern. References returned by get_pattern may still be in use,
+	    so the pattern itself is only deleted with the manager. */
 	void remove_pattern(size_t pid);
 
 protected:
-	typedef std::vector<PatternString> PatternStringMap;
+	typedef ConcurrentIdTable<PatternString> PatternStringMap;
 
 	static PatternStringManager * Instance;
 
 	PatternStringManager();
 
 	PatternStringMap m_patterns;
-	std::queue<size_t> m_free_indices;
 	PatternString m_nullpattern;
 
+	std::vector<PatternString *> m_removed;
+	QMutex m_removedmutex;
+
 };
 
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,220 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "pipelinedderivation.h"
+#include "gilrelease.h"
+#include "../plantgl/python/pyinterpreter.h"
+
+using namespace boost::python;
+LPY_USING_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/* Move the python error of the current thread into the given objects. */
+static void fetchError(object& type, object& value, object& traceback)
+{
+	if (!PyErr_Occurred()) PyErr_SetString(PyExc_RuntimeError, "Derivation failed.");
+	PyObject * ptype, * pvalue, * ptraceback;
+	PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+	PyErr_NormalizeException(&ptype, &pvalue, &ptraceback);
+	type = object(handle<>(allow_null(ptype)));
+	value = object(handle<>(allow_null(pvalue)));
+	traceback = object(handle<>(allow_null(ptraceback)));
+}
+
+/* Raise the given python error. */
+static void restoreError(const object& type, const object& value, const object& traceback)
+{
+	PyErr_Restore(incref(type.ptr()),
+				  incref(value.ptr()),
+				  traceback.ptr() == Py_None ? NULL : incref(traceback.ptr()));
+	throw_error_already_set();
+}
+
+/* Check that the rules are applied without the GIL (see Lsystem::step). 
+   Otherwise both stages would wait for each other on the GIL. */
+static bool runWithoutGil(const RuleSet& rules)
+{
+	for(RuleSet::const_iterator it = rules.begin(); it != rules.end(); ++it)
+		if (!it->isNative() && !it->isPythonFree()) return false;
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+
+PipelinedDerivation::PipelinedDerivation(Lsystem * lsystem, 
+										 const AxialTree& workstring, 
+										 size_t starting_iter, 
+										 size_t nb_iter,
+										 boost::python::object exporter,
+										 size_t queuesize):
+	m_lsystem(lsystem),
+	m_interpreter(NULL),
+	m_axiom(workstring),
+	m_starting_iter(starting_iter),
+	m_nb_iter(nb_iter),
+	m_exporter(exporter),
+	m_mutex(),
+	m_capacity(std::max<size_t>(queuesize,1)),
+	m_derived(false),
+	m_closed(false),
+	m_worker(this)
+{
+}
+
+PipelinedDerivation::~PipelinedDerivation()
+{
+	if (m_interpreter) delete m_interpreter;
+}
+
+AxialTree PipelinedDerivation::run()
+{
+	if (m_closed) LsysError("Pipelined derivation already run.");
+	if (m_lsystem->hasDerivationObserver()) LsysError("Lsystem is already deriving.");
+	for(Lsystem::RuleGroupList::const_iterator g = m_lsystem->m_rules.begin(); g != m_lsystem->m_rules.end(); ++g) {
+		if (g->hasQuery(Lsystem::eProduction) || g->hasQuery(Lsystem::eDecomposition))
+			LsysError("Pipelined derivation is not available for models with queries.");
+		if (!runWithoutGil(g->production) || !runWithoutGil(g->decomposition))
+			LsysError("Pipelined derivation is only available for models whose production and decomposition rules are native or static without parameters.");
+	}
+
+	// the interpretation uses its own context, with its own iteration number and random stream
+	m_interpreter = m_lsystem->clone(false);
+	m_queue.push_back(Snapshot(m_starting_iter, m_lsystem->m_currentGroup, m_axiom));
+	m_lsystem->setDerivationObserver(this);
+	m_worker.start();
+	object type, value, traceback;
+	{
+		// the error is fetched before leaving the context, whose restoration may call python
+		ContextMaintainer c(m_interpreter->context());
+		try {
+			Snapshot snapshot;
+			while (pop(snapshot)) {
+				m_interpreter->context()->setIterationNb(snapshot.iteration);
+				m_interpreter->m_currentGroup = snapshot.group;
+				AxialTree interpreted = m_interpreter->interpret(snapshot.lstring);
+				if (m_exporter != object()) m_exporter(snapshot.iteration, interpreted);
+			}
+		}
+		catch (error_already_set) {
+			fetchError(type, value, traceback);
+		}
+		catch (std::exception& e) {
+			PyErr_SetString(PyExc_RuntimeError, e.what());
+			fetchError(type, value, traceback);
+		}
+	}
+	close();
+	{
+		GilFreeSection nogil;
+		m_worker.wait();
+	}
+	m_lsystem->setDerivationObserver(NULL);
+	delete m_interpreter;
+	m_interpreter = NULL;
+	if (type != object()) restoreError(type, value, traceback);
+	if (m_error_type != object()) restoreError(m_error_type, m_error_value, m_error_traceback);
+	return m_result;
+}
+
+bool PipelinedDerivation::iterationDone(size_t iteration, const AxialTree& lstring)
+{
+	return push(Snapshot(iteration, m_lsystem->m_currentGroup, lstring));
+}
+
+/* The GIL is always released before taking the mutex. Strings are only 
+   destroyed with the GIL held, since their modules may hold python objects. */
+
+bool PipelinedDerivation::push(const Snapshot& snapshot)
+{
+	GilFreeSection nogil;
+	QMutexLocker ml(&m_mutex);
+	while (!m_closed && m_queue.size() >= m_capacity) m_notfull.wait(&m_mutex);
+	if (m_closed) return false;
+	m_queue.push_back(snapshot);
+	m_notempty.wakeAll();
+	return true;
+}
+
+bool PipelinedDerivation::pop(Snapshot& snapshot)
+{
+	Snapshot next;
+	bool found = false;
+	{
+		GilFreeSection nogil;
+		QMutexLocker ml(&m_mutex);
+		while (!m_derived && m_queue.empty()) m_notempty.wait(&m_mutex);
+		if (!m_queue.empty()) {
+			next = m_queue.front();
+			m_queue.pop_front();
+			found = true;
+			m_notfull.wakeAll();
+		}
+	}
+	if (found) snapshot = next;
+	return found;
+}
+
+void PipelinedDerivation::close()
+{
+	std::deque<Snapshot> pending;
+	{
+		GilFreeSection nogil;
+		QMutexLocker ml(&m_mutex);
+		m_closed = true;
+		pending.swap(m_queue);
+		m_notfull.wakeAll();
+	}
+}
+
+void PipelinedDerivation::derive()
+{
+	PythonInterpreterAcquirer py;
+	ContextMaintainer c(m_lsystem->context());
+	try {
+		m_result = m_lsystem->derive(m_axiom, m_starting_iter, m_nb_iter);
+	}
+	catch (error_already_set) {
+		fetchError(m_error_type, m_error_value, m_error_traceback);
+	}
+	catch (std::exception& e) {
+		PyErr_SetString(PyExc_RuntimeError, e.what());
+		fetchError(m_error_type, m_error_value, m_error_traceback);
+	}
+	// the context of the lsystem stays current until the end of the interpretation
+	GilFreeSection nogil;
+	QMutexLocker ml(&m_mutex);
+	m_derived = true;
+	m_notempty.wakeAll();
+	while (!m_closed) m_notfull.wait(&m_mutex);
+}
+
+/*---------------------------------------------------------------------------*/
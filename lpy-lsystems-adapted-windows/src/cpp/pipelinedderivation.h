@@ -0,0 +1,126 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "lsystem.h"
+#include <deque>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QThread>
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/*
+  Derivation pipelined with the interpretation of its iterations.
+  The derivation runs in a worker thread and the string of each iteration is passed to 
+  the calling thread through a bounded queue. The calling thread computes its homomorphism
+  with a copy of the Lsystem and gives it to an export function while the next iterations
+  are derived. Both stages share the GIL, so the derivation is restricted to models whose
+  production and decomposition rules run without it: native rules, and static rules without
+  parameters. Models with queries in production or decomposition rules are not supported.
+  Interpretation rules see the namespace as it is modified by the running derivation.
+*/
+class LPY_API PipelinedDerivation : public Lsystem::DerivationObserver {
+public:
+	PipelinedDerivation(Lsystem * lsystem, 
+					    const AxialTree& workstring, 
+					    size_t starting_iter, 
+					    size_t nb_iter,
+					    boost::python::object exporter = boost::python::object(),
+					    size_t queuesize = 2);
+
+	virtual ~PipelinedDerivation();
+
+	/** Derive and interpret all the iterations, the starting string included. 
+		exporter(iteration, interpretedstring) is called in the calling thread for each of them.
+		Return the derived string or raise the error of one of the stages. */
+	AxialTree run();
+
+	virtual bool iterationDone(size_t iteration, const AxialTree& lstring);
+
+protected:
+	struct Snapshot {
+		Snapshot(size_t _iteration = 0, size_t _group = 0, const AxialTree& _lstring = AxialTree()) :
+			iteration(_iteration), group(_group), lstring(_lstring) {}
+		size_t iteration;
+		size_t group;
+		AxialTree lstring;
+	};
+
+	/// wait for a free place in the queue. Return false if the interpretation stopped.
+	bool push(const Snapshot& snapshot);
+	/// wait for the next string to interpret. Return false when the derivation is over.
+	bool pop(Snapshot& snapshot);
+	/// stop the interpretation and let the derivation end.
+	void close();
+
+	void derive();
+
+	class Worker : public QThread {
+	public:
+		Worker(PipelinedDerivation * pipeline) : m_pipeline(pipeline) {}
+	protected:
+		virtual void run() { m_pipeline->derive(); }
+		PipelinedDerivation * m_pipeline;
+	};
+
+	Lsystem * m_lsystem;
+	Lsystem * m_interpreter;
+	AxialTree m_axiom;
+	size_t m_starting_iter;
+	size_t m_nb_iter;
+	boost::python::object m_exporter;
+
+	QMutex m_mutex;
+	QWaitCondition m_notempty;
+	QWaitCondition m_notfull;
+	std::deque<Snapshot> m_queue;
+	size_t m_capacity;
+	bool m_derived;
+	bool m_closed;
+
+	AxialTree m_result;
+	boost::python::object m_error_type;
+	boost::python::object m_error_value;
+	boost::python::object m_error_traceback;
+
+	Worker m_worker;
+
+private:
+	PipelinedDerivation(const PipelinedDerivation&);
+	PipelinedDerivation& operator=(const PipelinedDerivation&);
+};
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
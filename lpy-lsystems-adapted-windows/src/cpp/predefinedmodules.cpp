@@ -1149,7 +1149,7 @@ void ModuleClass::createPredefinedClasses() {
 	Cut = new PredefinedModuleClass("%","Cut","Cut the remainder of the current branch in the string.",PredefinedModuleClass::eStringManipulation);
 	Star = new PredefinedModuleClass("*","any","Used to match any module in rules predecessor. First argument will become name of the module.",PredefinedModuleClass::ePatternMatching);
 	RepExp = new PredefinedModuleClass("x","repexp","Used to specify matching of a repetition of modules.",PredefinedModuleClass::ePatternMatching);
-	RepExp->aliases.push_back("all");
+	RepExp->addAlias("all");
 	Or = new PredefinedModuleClass("or","||","Used to specify an alternative matching of modules.",PredefinedModuleClass::ePatternMatching);
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
 	QueryPosition = new DeclaredModule(GetPos)("?P","GetPos");
@@ -0,0 +1,125 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "productioncache.h"
+
+LPY_USING_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+size_t ProductionCache::DefaultMaxSize = 1024;
+
+ProductionCache::ProductionCache(size_t maxsize):
+	m_maxsize(maxsize), m_hits(0), m_misses(0)
+{
+}
+
+bool ProductionCache::isCachable(PyObject * value)
+{
+	if (value == Py_None || PyLong_CheckExact(value) || PyFloat_CheckExact(value) || PyBool_Check(value) 
+		|| PyUnicode_CheckExact(value) || PyBytes_CheckExact(value)) return true;
+	if (PyTuple_CheckExact(value)) {
+		for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(value); ++i)
+			if (!isCachable(PyTuple_GET_ITEM(value, i))) return false;
+		return true;
+	}
+	return false;
+}
+
+bool ProductionCache::isEqual(PyObject * a, PyObject * b)
+{
+	// 1, 1.0 and True are equal in python but may give different productions.
+	if (Py_TYPE(a) != Py_TYPE(b)) return false;
+	if (PyTuple_CheckExact(a)) {
+		if (PyTuple_GET_SIZE(a) != PyTuple_GET_SIZE(b)) return false;
+		for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(a); ++i)
+			if (!isEqual(PyTuple_GET_ITEM(a, i),PyTuple_GET_ITEM(b, i))) return false;
+		return true;
+	}
+	int result = PyObject_RichCompareBool(a, b, Py_EQ);
+	if (result < 0) { PyErr_Clear(); return false; }
+	return result == 1;
+}
+
+bool ProductionCache::get(const boost::python::object& key, AxialTree& production, bool& isApplied)
+{
+	Py_hash_t hash = PyObject_Hash(key.ptr());
+	if (hash == -1) { PyErr_Clear(); ++m_misses; return false; }
+	std::pair<EntryMap::iterator, EntryMap::iterator> range = m_index.equal_range(hash);
+	for (EntryMap::iterator it = range.first; it != range.second; ++it) {
+		if (isEqual(it->second->key.ptr(), key.ptr())) {
+			m_entries.splice(m_entries.begin(), m_entries, it->second);
+			production = it->second->production;
+			isApplied = it->second->isApplied;
+			++m_hits;
+			return true;
+		}
+	}
+	++m_misses;
+	return false;
+}
+
+void ProductionCache::set(const boost::python::object& key, const AxialTree& production, bool isApplied)
+{
+	if (m_maxsize == 0) return;
+	Py_hash_t hash = PyObject_Hash(key.ptr());
+	if (hash == -1) { PyErr_Clear(); return; }
+	Entry entry;
+	entry.key = key;
+	entry.hash = hash;
+	entry.production = production;
+	entry.isApplied = isApplied;
+	m_entries.push_front(entry);
+	m_index.insert(EntryMap::value_type(hash, m_entries.begin()));
+	setMaxSize(m_maxsize);
+}
+
+void ProductionCache::setMaxSize(size_t maxsize)
+{
+	m_maxsize = maxsize;
+	while (m_entries.size() > m_maxsize) {
+		EntryList::iterator last = --m_entries.end();
+		std::pair<EntryMap::iterator, EntryMap::iterator> range = m_index.equal_range(last->hash);
+		for (EntryMap::iterator it = range.first; it != range.second; ++it)
+			if (it->second == last) { m_index.erase(it); break; }
+		m_entries.erase(last);
+	}
+}
+
+void ProductionCache::clear()
+{
+	m_index.clear();
+	m_entries.clear();
+	m_hits = 0;
+	m_misses = 0;
+}
+
+/*---------------------------------------------------------------------------*/
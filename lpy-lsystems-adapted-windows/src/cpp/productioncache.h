@@ -0,0 +1,107 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "axialtree.h"
+#include <list>
+#include <unordered_map>
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/** 
+	Memoization table of the productions of a pure rule, addressed by the values of its arguments.
+	Only arguments of immutable builtin types (numbers, strings, None and tuples of them) are cached,
+	so that keys are never modified and comparing them never calls python code. The least recently 
+	used production is evicted when the table is full. Must be used with the GIL held.
+*/
+class LPY_API ProductionCache : public TOOLS(RefCountObject) {
+public:
+	ProductionCache(size_t maxsize = DefaultMaxSize);
+
+	static size_t DefaultMaxSize;
+
+	/// Return a key for the arguments or an empty object if they cannot be cached.
+	template<class ArgListType>
+	static boost::python::object key(const ArgListType& args);
+
+	/// Look for the production of key. Return false if it is not in the table.
+	bool get(const boost::python::object& key, AxialTree& production, bool& isApplied);
+	void set(const boost::python::object& key, const AxialTree& production, bool isApplied);
+
+	void clear();
+	inline size_t size() const { return m_entries.size(); }
+	inline size_t maxSize() const { return m_maxsize; }
+	void setMaxSize(size_t maxsize);
+
+	inline size_t hits() const { return m_hits; }
+	inline size_t misses() const { return m_misses; }
+
+protected:
+	static bool isCachable(PyObject * value);
+	static bool isEqual(PyObject * a, PyObject * b);
+
+	struct Entry {
+		boost::python::object key;
+		Py_hash_t hash;
+		AxialTree production;
+		bool isApplied;
+	};
+	typedef std::list<Entry> EntryList;
+	typedef std::unordered_multimap<Py_hash_t, EntryList::iterator> EntryMap;
+
+	EntryList m_entries; // most recently used first
+	EntryMap m_index;
+	size_t m_maxsize;
+	size_t m_hits;
+	size_t m_misses;
+};
+
+typedef TOOLS(RefCountPtr)<ProductionCache> ProductionCachePtr;
+
+template<class ArgListType>
+boost::python::object ProductionCache::key(const ArgListType& args)
+{
+	size_t nbargs = len(args);
+	PyObject * result = PyTuple_New(nbargs);
+	for(size_t i = 0; i < nbargs; ++i){
+		boost::python::object arg(args[i]);
+		if (!isCachable(arg.ptr())) { Py_DECREF(result); return boost::python::object(); }
+		Py_INCREF(arg.ptr());
+		PyTuple_SET_ITEM(result, i, arg.ptr());
+	}
+	return boost::python::object(boost::python::handle<>(result));
+}
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
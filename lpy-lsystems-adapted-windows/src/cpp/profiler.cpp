@@ -0,0 +1,112 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "profiler.h"
+#include "lsysrule.h"
+#include <algorithm>
+
+LPY_USING_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+DerivationProfiler::IterationProfile::IterationProfile(size_t _iteration):
+	iteration(_iteration), length(0)
+{
+	for (size_t i = 0; i < eNbStages; ++i) duration[i] = 0;
+}
+
+DerivationProfiler::RuleProfile::RuleProfile():
+	group(0), lineno(-1), attempts(0), matches(0), applications(0), time(0), produced(0)
+{
+}
+
+DerivationProfiler::DerivationProfiler()
+{
+}
+
+void DerivationProfiler::clear()
+{
+	m_iterations.clear();
+	m_rules.clear();
+}
+
+void DerivationProfiler::startIteration(size_t iteration)
+{
+	m_iterations.push_back(IterationProfile(iteration));
+}
+
+void DerivationProfiler::addStageDuration(eStage stage, double duration)
+{
+	if (m_iterations.empty()) startIteration(0);
+	m_iterations.back().duration[stage] += duration;
+}
+
+void DerivationProfiler::endIteration(size_t length)
+{
+	if (!m_iterations.empty()) m_iterations.back().length = length;
+}
+
+DerivationProfiler::RuleProfile& DerivationProfiler::profile(const LsysRule * rule)
+{
+	RuleProfileMap::iterator it = m_rules.find(rule);
+	if (it != m_rules.end()) return it->second;
+	// rule description is retrieved once since rules may be deleted before the report.
+	RuleProfile& result = m_rules[rule];
+	result.name = rule->name();
+	result.group = rule->getGroupId();
+	result.lineno = rule->lineno;
+	return result;
+}
+
+void DerivationProfiler::ruleApplied(const LsysRule * rule, bool applied, double time, size_t produced)
+{
+	RuleProfile& p = profile(rule);
+	++p.matches;
+	p.time += time;
+	if (applied) {
+		++p.applications;
+		p.produced += produced;
+	}
+}
+
+static bool slower(const DerivationProfiler::RuleProfile& a, const DerivationProfiler::RuleProfile& b)
+{ return a.time > b.time; }
+
+DerivationProfiler::RuleProfileList DerivationProfiler::rules() const
+{
+	RuleProfileList result;
+	for (RuleProfileMap::const_iterator it = m_rules.begin(); it != m_rules.end(); ++it)
+		result.push_back(it->second);
+	std::sort(result.begin(), result.end(), slower);
+	return result;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,148 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "lpy_config.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+class LsysRule;
+
+/** 
+	Timings of the stages of each iteration of a derivation and statistics 
+	on the use of each rule. Enabled with the 'Profiling' option. 
+*/
+class LPY_API DerivationProfiler {
+public:
+	enum eStage {
+		ePreProcess,
+		eProduction,
+		eDecomposition,
+		ePostProcess,
+		eNbStages
+	};
+
+	struct IterationProfile {
+		IterationProfile(size_t _iteration = 0);
+		size_t iteration;
+		double duration[eNbStages]; // in seconds
+		size_t length;               // of the resulting string
+	};
+
+	struct RuleProfile {
+		RuleProfile();
+		std::string name;
+		size_t group;
+		int lineno;
+		size_t attempts;     // nb of match attempts
+		size_t matches;      // nb of successful matches
+		size_t applications; // nb of matches that produced a string
+		double time;         // spent in the application of the rule, mainly in python
+		size_t produced;     // nb of produced modules
+	};
+
+	typedef std::vector<IterationProfile> IterationProfileList;
+	typedef std::vector<RuleProfile> RuleProfileList;
+
+	DerivationProfiler();
+
+	void clear();
+
+	typedef std::chrono::steady_clock::time_point TimePoint;
+	static inline TimePoint now() { return std::chrono::steady_clock::now(); }
+	static inline double elapsed(const TimePoint& start) 
+	{ return std::chrono::duration<double>(now() - start).count(); }
+
+	void startIteration(size_t iteration);
+	void addStageDuration(eStage stage, double duration);
+	void endIteration(size_t length);
+
+	inline void matchAttempt(const LsysRule * rule) { ++profile(rule).attempts; }
+	void ruleApplied(const LsysRule * rule, bool applied, double time, size_t produced);
+
+	inline const IterationProfileList& iterations() const { return m_iterations; }
+	/// rule profiles sorted by decreasing time.
+	RuleProfileList rules() const;
+
+protected:
+	RuleProfile& profile(const LsysRule * rule);
+
+	IterationProfileList m_iterations;
+	typedef std::unordered_map<const LsysRule *, RuleProfile> RuleProfileMap;
+	RuleProfileMap m_rules;
+};
+
+/*---------------------------------------------------------------------------*/
+
+/// Add the duration of its scope to a stage of the current iteration if a profiler is given.
+class StageProbe {
+public:
+	inline StageProbe(DerivationProfiler * profiler, DerivationProfiler::eStage stage):
+		m_profiler(profiler), m_stage(stage)
+	{ if (m_profiler) m_start = DerivationProfiler::now(); }
+
+	inline ~StageProbe()
+	{ if (m_profiler) m_profiler->addStageDuration(m_stage, DerivationProfiler::elapsed(m_start)); }
+
+protected:
+	DerivationProfiler * m_profiler;
+	DerivationProfiler::eStage m_stage;
+	DerivationProfiler::TimePoint m_start;
+};
+
+/// Measure the application of a rule on a string if a profiler is given.
+class RuleApplicationProbe {
+public:
+	template<class StringType>
+	inline RuleApplicationProbe(DerivationProfiler * profiler, const LsysRule * rule, const StringType& target):
+		m_profiler(profiler), m_rule(rule), m_size(0)
+	{ if (m_profiler) { m_size = target.size(); m_start = DerivationProfiler::now(); } }
+
+	template<class StringType>
+	inline void done(bool applied, const StringType& target)
+	{ if (m_profiler) m_profiler->ruleApplied(m_rule, applied, DerivationProfiler::elapsed(m_start), target.size() - m_size); }
+
+protected:
+	DerivationProfiler * m_profiler;
+	const LsysRule * m_rule;
+	size_t m_size;
+	DerivationProfiler::TimePoint m_start;
+};
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
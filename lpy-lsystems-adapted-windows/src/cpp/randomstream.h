@@ -0,0 +1,124 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "lpy_config.h"
+#include <stdint.h>
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/** 
+	Counter-based random stream (Philox4x32-10, Salmon et al. 2011).
+	A draw is a pure function of the seed and of its address: the iteration, the pass in the 
+	iteration (production then decomposition passes), the position of the module in the lstring, 
+	the rule and the rank of the draw in the rule application.
+	Results thus do not depend on the order in which modules are processed.
+*/
+class RandomStream {
+public:
+	RandomStream(uint64_t seed = 0) : 
+		m_seed(seed), m_iteration(0), m_pass(0), m_position(0), m_rule(0), m_index(0) {}
+
+	inline void setSeed(uint64_t seed) { m_seed = seed; m_index = 0; }
+	inline uint64_t getSeed() const { return m_seed; }
+
+	inline void setIteration(uint32_t iteration) 
+	{ m_iteration = iteration; m_pass = 0; m_position = 0; m_rule = 0; m_index = 0; }
+	inline uint32_t getIteration() const { return m_iteration; }
+
+	inline void setPass(uint32_t pass) 
+	{ m_pass = pass; m_position = 0; m_rule = 0; m_index = 0; }
+	inline uint32_t getPass() const { return m_pass; }
+
+	/// Set the address of the next draws. Restart the rank of the draws.
+	inline void setAddress(uint64_t position, uint32_t rule) 
+	{ m_position = position; m_rule = rule; m_index = 0; }
+
+	inline uint64_t getPosition() const { return m_position; }
+	inline uint32_t getRule() const { return m_rule; }
+
+	/// Rule id of the draws made to select among stochastic rules. Their rank is the group of alternatives.
+	static const uint32_t SelectionStream = 0xFFFFFFFFu;
+
+	/// Uniform draw of given rank at position for rule of the current pass. Does not change the state of the stream.
+	inline double uniformAt(uint64_t position, uint32_t rule, uint32_t index = 0) const
+	{ return toUniform(at(m_seed, m_iteration, m_pass, position, rule, index)); }
+
+	/// Next 64 random bits.
+	inline uint64_t next() 
+	{ return at(m_seed, m_iteration, m_pass, m_position, m_rule, m_index++); }
+
+	/// Uniform draw in [0,1).
+	inline double random() 
+	{ return toUniform(next()); }
+
+	/// Uniform draw in [a,b).
+	inline double uniform(double a, double b) 
+	{ return a + (b - a) * random(); }
+
+	/// Integer draw in [a,b].
+	inline int64_t randint(int64_t a, int64_t b) 
+	{ return a + int64_t(random() * double(b - a + 1)); }
+
+	/// Bits drawn at a given address.
+	static inline uint64_t at(uint64_t seed, uint32_t iteration, uint32_t pass, uint64_t position, uint32_t rule, uint32_t index)
+	{
+		uint32_t ctr[4] = { iteration, uint32_t(position), rule ^ uint32_t(position >> 32), index ^ (pass << 20) };
+		uint32_t key[2] = { uint32_t(seed), uint32_t(seed >> 32) };
+		for (int round = 0; round < 10; ++round) {
+			uint64_t p0 = uint64_t(0xD2511F53) * ctr[0];
+			uint64_t p1 = uint64_t(0xCD9E8D57) * ctr[2];
+			uint32_t c0 = uint32_t(p1 >> 32) ^ ctr[1] ^ key[0];
+			uint32_t c2 = uint32_t(p0 >> 32) ^ ctr[3] ^ key[1];
+			ctr[0] = c0; ctr[1] = uint32_t(p1);
+			ctr[2] = c2; ctr[3] = uint32_t(p0);
+			key[0] += 0x9E3779B9; key[1] += 0xBB67AE85;
+		}
+		return (uint64_t(ctr[0]) << 32) | ctr[1];
+	}
+
+	static inline double toUniform(uint64_t bits) 
+	{ return double(bits >> 11) * (1.0 / 9007199254740992.0); }
+
+protected:
+	uint64_t m_seed;
+	uint32_t m_iteration;
+	uint32_t m_pass;
+	uint64_t m_position;
+	uint32_t m_rule;
+	uint32_t m_index;
+};
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
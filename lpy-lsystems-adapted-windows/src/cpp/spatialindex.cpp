@@ -0,0 +1,181 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#include "spatialindex.h"
+#include "error.h"
+#include <algorithm>
+#include <math.h>
+
+LPY_USING_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+SpatialIndex::SpatialIndex(const std::vector<Vector3>& points, const std::vector<real_t>& attributes):
+	m_points(points), m_attributes(attributes), m_order(points.size())
+{
+	if (!m_attributes.empty() && m_attributes.size() != m_points.size())
+		LsysError("SpatialIndex: the number of attributes should be the number of points.");
+	for (size_t i = 0; i < m_order.size(); ++i) m_order[i] = i;
+	if (!m_points.empty()) {
+		m_nodes.reserve(2 * m_points.size() / LeafSize + 1);
+		build(0, m_points.size());
+	}
+}
+
+size_t SpatialIndex::build(size_t begin, size_t end)
+{
+	size_t id = m_nodes.size();
+	m_nodes.push_back(Node());
+	Node node = { begin, end, 0, 0, 0, 0 };
+	if (end - begin > LeafSize) {
+		// split along the axis of largest extent at the median point
+		Vector3 minp = m_points[m_order[begin]], maxp = minp;
+		for (size_t i = begin+1; i < end; ++i) {
+			const Vector3& p = m_points[m_order[i]];
+			for (int a = 0; a < 3; ++a) {
+				if (p[a] < minp[a]) minp[a] = p[a];
+				else if (p[a] > maxp[a]) maxp[a] = p[a];
+			}
+		}
+		Vector3 extent = maxp - minp;
+		node.axis = (extent.x() >= extent.y() ? (extent.x() >= extent.z() ? 0 : 2) : (extent.y() >= extent.z() ? 1 : 2));
+		size_t mid = (begin + end) / 2;
+		int axis = node.axis;
+		std::nth_element(m_order.begin()+begin, m_order.begin()+mid, m_order.begin()+end,
+						 [this, axis](size_t a, size_t b) { return m_points[a][axis] < m_points[b][axis]; });
+		node.split = m_points[m_order[mid]][axis];
+		node.left = build(begin, mid);
+		node.right = build(mid, end);
+	}
+	m_nodes[id] = node;
+	return id;
+}
+
+static inline real_t sqdistance(const TOOLS(Vector3)& a, const TOOLS(Vector3)& b)
+{ 
+	real_t dx = a.x() - b.x(), dy = a.y() - b.y(), dz = a.z() - b.z();
+	return dx * dx + dy * dy + dz * dz; 
+}
+
+void SpatialIndex::searchNearest(size_t id, const Vector3& p, size_t k, std::vector<Neighbor>& heap) const
+{
+	const Node& node = m_nodes[id];
+	if (node.left == 0) {
+		for (size_t i = node.begin; i < node.end; ++i) {
+			Neighbor candidate(sqdistance(p, m_points[m_order[i]]), m_order[i]);
+			if (heap.size() < k) { 
+				heap.push_back(candidate); 
+				std::push_heap(heap.begin(), heap.end()); 
+			}
+			else if (candidate < heap.front()) {
+				std::pop_heap(heap.begin(), heap.end());
+				heap.back() = candidate;
+				std::push_heap(heap.begin(), heap.end());
+			}
+		}
+		return;
+	}
+	real_t delta = p[node.axis] - node.split;
+	size_t nearside = (delta < 0 ? node.left : node.right);
+	size_t farside = (delta < 0 ? node.right : node.left);
+	searchNearest(nearside, p, k, heap);
+	if (heap.size() < k || delta * delta < heap.front().first)
+		searchNearest(farside, p, k, heap);
+}
+
+void SpatialIndex::searchRadius(size_t id, const Vector3& p, real_t sqradius, std::vector<Neighbor>& result) const
+{
+	const Node& node = m_nodes[id];
+	if (node.left == 0) {
+		for (size_t i = node.begin; i < node.end; ++i) {
+			real_t d = sqdistance(p, m_points[m_order[i]]);
+			if (d < sqradius) result.push_back(Neighbor(d, m_order[i]));
+		}
+		return;
+	}
+	real_t delta = p[node.axis] - node.split;
+	if (delta < 0 || delta * delta < sqradius) searchRadius(node.left, p, sqradius, result);
+	if (delta >= 0 || delta * delta < sqradius) searchRadius(node.right, p, sqradius, result);
+}
+
+size_t SpatialIndex::nearest(const Vector3& p, real_t * distance) const
+{
+	if (m_nodes.empty()) return size();
+	std::vector<Neighbor> heap;
+	heap.reserve(1);
+	searchNearest(0, p, 1, heap);
+	if (distance) *distance = sqrt(heap.front().first);
+	return heap.front().second;
+}
+
+SpatialIndex::IndexList SpatialIndex::nearest(const Vector3& p, size_t k) const
+{
+	IndexList result;
+	if (m_nodes.empty() || k == 0) return result;
+	std::vector<Neighbor> heap;
+	heap.reserve(k);
+	searchNearest(0, p, k, heap);
+	std::sort_heap(heap.begin(), heap.end());
+	result.reserve(heap.size());
+	for (std::vector<Neighbor>::const_iterator it = heap.begin(); it != heap.end(); ++it) 
+		result.push_back(it->second);
+	return result;
+}
+
+SpatialIndex::IndexList SpatialIndex::inRadius(const Vector3& p, real_t radius) const
+{
+	IndexList result;
+	if (m_nodes.empty()) return result;
+	std::vector<Neighbor> neighbors;
+	searchRadius(0, p, radius * radius, neighbors);
+	std::sort(neighbors.begin(), neighbors.end());
+	result.reserve(neighbors.size());
+	for (std::vector<Neighbor>::const_iterator it = neighbors.begin(); it != neighbors.end(); ++it) 
+		result.push_back(it->second);
+	return result;
+}
+
+real_t SpatialIndex::weightedAverage(const Vector3& p, real_t radius, real_t defaultvalue) const
+{
+	if (!hasAttributes()) LsysError("SpatialIndex: no attributes to average.");
+	if (m_nodes.empty()) return defaultvalue;
+	std::vector<Neighbor> neighbors;
+	searchRadius(0, p, radius * radius, neighbors);
+	real_t sum = 0, weights = 0;
+	for (std::vector<Neighbor>::const_iterator it = neighbors.begin(); it != neighbors.end(); ++it) {
+		if (it->first <= 0) return m_attributes[it->second];
+		real_t w = 1 / sqrt(it->first);
+		sum += w * m_attributes[it->second];
+		weights += w;
+	}
+	return (weights > 0 ? sum / weights : defaultvalue);
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,102 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "lpy_config.h"
+#include "../plantgl/math/util_vector.h"
+#include "../plantgl/tool/rcobject.h"
+#include <vector>
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/** 
+	Static kd-tree over a set of points with an optional scalar attribute per point, 
+	for instance the vertices of an environment mesh and their weights. It is built 
+	once and answers nearest neighbour, k nearest, radius and weighted average queries 
+	natively, so that rules can query the environment at each derivation step.
+*/
+class LPY_API SpatialIndex : public TOOLS(RefCountObject) {
+public:
+	typedef TOOLS(Vector3) Vector3;
+	typedef std::vector<size_t> IndexList;
+
+	SpatialIndex(const std::vector<Vector3>& points, 
+				 const std::vector<real_t>& attributes = std::vector<real_t>());
+
+	inline size_t size() const { return m_points.size(); }
+	inline const Vector3& point(size_t i) const { return m_points[i]; }
+
+	inline bool hasAttributes() const { return !m_attributes.empty(); }
+	inline real_t attribute(size_t i) const { return m_attributes[i]; }
+
+	/// Index of the nearest point of p, or size() if the index is empty.
+	size_t nearest(const Vector3& p, real_t * distance = NULL) const;
+
+	/// Indices of the k nearest points of p, from the nearest one.
+	IndexList nearest(const Vector3& p, size_t k) const;
+
+	/// Indices of the points at distance lower than radius of p, from the nearest one.
+	IndexList inRadius(const Vector3& p, real_t radius) const;
+
+	/** Average of the attributes of the points in radius of p weighted by the inverse 
+		of their distance. Return defaultvalue if there is no point in radius. */
+	real_t weightedAverage(const Vector3& p, real_t radius, real_t defaultvalue = 0) const;
+
+protected:
+	struct Node {
+		size_t begin, end;  // range of m_order
+		size_t left, right; // children, 0 for a leaf
+		int axis;
+		real_t split;
+	};
+
+	typedef std::pair<real_t,size_t> Neighbor; // squared distance, point index
+
+	size_t build(size_t begin, size_t end);
+
+	void searchNearest(size_t node, const Vector3& p, size_t k, std::vector<Neighbor>& heap) const;
+	void searchRadius(size_t node, const Vector3& p, real_t sqradius, std::vector<Neighbor>& result) const;
+
+	std::vector<Vector3> m_points;
+	std::vector<real_t> m_attributes;
+	std::vector<size_t> m_order;
+	std::vector<Node> m_nodes;
+
+	static const size_t LeafSize = 8;
+};
+
+typedef TOOLS(RefCountPtr)<SpatialIndex> SpatialIndexPtr;
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
@@ -0,0 +1,330 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "streamingderivation.h"
+#include "gilrelease.h"
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <algorithm>
+
+LPY_USING_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+static const char LSTRINGFILE_MAGIC[4] = { 'L', 'P', 'Y', 'S' };
+static const uint32_t LSTRINGFILE_VERSION = 1;
+static const size_t LSTRINGFILE_HEADER_SIZE = 4 + sizeof(uint32_t);
+
+LStringFileWriter::LStringFileWriter(const std::string& filename):
+	m_stream(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc),
+	m_filename(filename),
+	m_size(0)
+{
+	if (!m_stream) LsysError("Cannot write lstring file '"+filename+"'.");
+	m_stream.write(LSTRINGFILE_MAGIC, 4);
+	m_stream.write(reinterpret_cast<const char *>(&LSTRINGFILE_VERSION), sizeof(uint32_t));
+}
+
+LStringFileWriter::~LStringFileWriter()
+{
+	if (m_stream.is_open()) m_stream.close();
+}
+
+void LStringFileWriter::write(const AxialTree& lstring)
+{
+	if (lstring.empty()) return;
+	std::string data = lstring.toBinary();
+	uint64_t length = data.size();
+	m_stream.write(reinterpret_cast<const char *>(&length), sizeof(uint64_t));
+	m_stream.write(data.data(), data.size());
+	if (!m_stream) LsysError("Cannot write lstring file '"+m_filename+"'.");
+	m_size += lstring.size();
+}
+
+void LStringFileWriter::close()
+{
+	m_stream.close();
+	if (!m_stream) LsysError("Cannot write lstring file '"+m_filename+"'.");
+}
+
+/*---------------------------------------------------------------------------*/
+
+LStringFileReader::LStringFileReader(const std::string& filename):
+	m_file(QString(filename.c_str())),
+	m_filename(filename),
+	m_pos(LSTRINGFILE_HEADER_SIZE),
+	m_size(0)
+{
+	if (!m_file.open(QIODevice::ReadOnly)) LsysError("Cannot read lstring file '"+filename+"'.");
+	m_size = m_file.size();
+	if (m_size < qint64(LSTRINGFILE_HEADER_SIZE)) LsysError("Invalid lstring file '"+filename+"'.");
+	uchar * header = m_file.map(0, LSTRINGFILE_HEADER_SIZE);
+	if (header == NULL) LsysError("Cannot read lstring file '"+filename+"'.");
+	uint32_t version;
+	memcpy(&version, header + 4, sizeof(uint32_t));
+	bool valid = memcmp(header, LSTRINGFILE_MAGIC, 4) == 0 && version == LSTRINGFILE_VERSION;
+	m_file.unmap(header);
+	if (!valid) LsysError("Invalid lstring file '"+filename+"'.");
+}
+
+LStringFileReader::~LStringFileReader()
+{
+	m_file.close();
+}
+
+AxialTree LStringFileReader::read()
+{
+	if (atEnd()) return AxialTree();
+	if (m_pos + qint64(sizeof(uint64_t)) > m_size) LsysError("Truncated lstring file '"+m_filename+"'.");
+	uint64_t length;
+	uchar * data = m_file.map(m_pos, sizeof(uint64_t));
+	if (data == NULL) LsysError("Cannot read lstring file '"+m_filename+"'.");
+	memcpy(&length, data, sizeof(uint64_t));
+	m_file.unmap(data);
+	m_pos += sizeof(uint64_t);
+	if (m_pos + qint64(length) > m_size) LsysError("Truncated lstring file '"+m_filename+"'.");
+	data = m_file.map(m_pos, length);
+	if (data == NULL) LsysError("Cannot read lstring file '"+m_filename+"'.");
+	std::string chunk(reinterpret_cast<const char *>(data), length);
+	m_file.unmap(data);
+	m_pos += length;
+	return AxialTree::fromBinary(chunk);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void LPY::writeLStringFile(const std::string& filename, const AxialTree& lstring, size_t chunksize)
+{
+	LStringFileWriter writer(filename);
+	chunksize = std::max<size_t>(chunksize,1);
+	for (size_t pos = 0; pos < lstring.size(); pos += chunksize)
+		writer.write(AxialTree(lstring.const_begin() + pos, lstring.const_begin() + std::min(pos + chunksize, lstring.size())));
+	writer.close();
+}
+
+AxialTree LPY::readLStringFile(const std::string& filename)
+{
+	LStringFileReader reader(filename);
+	AxialTree result;
+	while (!reader.atEnd()) result += reader.read();
+	return result;
+}
+
+/*---------------------------------------------------------------------------*/
+
+StreamingDerivation::StreamingDerivation(Lsystem * lsystem, size_t window, size_t lookahead):
+	m_lsystem(lsystem),
+	m_window(std::max<size_t>(window,1)),
+	m_lookahead(lookahead),
+	m_size(0)
+{
+}
+
+void StreamingDerivation::checkRules() const
+{
+	for(Lsystem::RuleGroupList::const_iterator g = m_lsystem->m_rules.begin(); g != m_lsystem->m_rules.end(); ++g){
+		if (g->hasQuery(Lsystem::eProduction) || g->hasQuery(Lsystem::eDecomposition))
+			LsysError("Streaming derivation is not available for models with queries.");
+		if (m_lookahead > 0) continue;
+		for (int type = Lsystem::eProduction; type <= Lsystem::eDecomposition; ++type){
+			const RuleSet& rules = g->getGroup(Lsystem::eRuleType(type));
+			for(RuleSet::const_iterator r = rules.begin(); r != rules.end(); ++r)
+				if (!r->isContextFree() || r->predecessor().size() > 1)
+					LsysError("Rule '"+r->name()+"' requires a lookahead for streaming derivation.");
+		}
+	}
+}
+
+void StreamingDerivation::callStart(bool starteach)
+{
+	LsysContext& context = m_lsystem->m_context;
+	if ((starteach ? context.getStartEachNbArgs() : context.getStartNbArgs()) > 0)
+		LsysError(std::string(starteach ? "StartEach" : "Start") + " function taking the lstring as argument is not available in streaming derivation.");
+	boost::python::object result = starteach ? context.startEach() : context.start();
+	if (result != boost::python::object())
+		LsysError(std::string(starteach ? "StartEach" : "Start") + " function cannot return an lstring in streaming derivation.");
+}
+
+size_t StreamingDerivation::derive(const std::string& source, const std::string& target, size_t starting_iter, size_t nb_iter)
+{
+	checkRules();
+	LsysContext& context = m_lsystem->m_context;
+	ContextMaintainer c(&context);
+	if (starting_iter == 0) {
+		context.setIterationNb(0);
+		callStart(false);
+	}
+	// passes write alternatively in two temporary files
+	std::string tmpfiles[2] = { target + ".0.tmp", target + ".1.tmp" };
+	size_t nextfile = 0;
+	std::string input = source;
+	m_size = 0;
+	try {
+		for (size_t i = 0; i < nb_iter; ++i){
+			context.setIterationNb(starting_iter+i);
+			callStart(true);
+			if (m_lsystem->getDirection() != eForward) LsysError("Backward derivation is not available in streaming derivation.");
+			size_t group_ = context.getGroup();
+			m_lsystem->m_currentGroup = group_;
+			RulePtrMap production = m_lsystem->getRules(Lsystem::eProduction,group_,eForward);
+			RulePtrMap decomposition = m_lsystem->getRules(Lsystem::eDecomposition,group_,eForward);
+			bool matching = false;
+			if (!production.empty()){
+				matching = pass(input, tmpfiles[nextfile], production);
+				input = tmpfiles[nextfile]; nextfile = 1 - nextfile;
+			}
+			bool decmatching = true;
+			for(size_t j = 0; decmatching && !decomposition.empty() && j < m_lsystem->m_decomposition_max_depth; j++){
+				context.randomStream().setPass(uint32_t(j+1));
+				decmatching = pass(input, tmpfiles[nextfile], decomposition);
+				input = tmpfiles[nextfile]; nextfile = 1 - nextfile;
+				if (decmatching) matching = true;
+			}
+			if (!matching && context.return_if_no_matching) break;
+			if (m_lsystem->isEarlyReturnEnabled()) break;
+		}
+		if (input == source) {
+			// nothing derived: the source is copied. The copy goes through a temporary file 
+			// since target may be the source itself.
+			LStringFileReader reader(source);
+			LStringFileWriter writer(tmpfiles[nextfile]);
+			while (!reader.atEnd()) writer.write(reader.read());
+			writer.close();
+			m_size = writer.size();
+			input = tmpfiles[nextfile];
+		}
+		std::remove(target.c_str());
+		if (std::rename(input.c_str(), target.c_str()) != 0) LsysError("Cannot write lstring file '"+target+"'.");
+	}
+	catch (...) {
+		std::remove(tmpfiles[0].c_str());
+		std::remove(tmpfiles[1].c_str());
+		throw;
+	}
+	std::remove(tmpfiles[0].c_str());
+	std::remove(tmpfiles[1].c_str());
+	return m_size;
+}
+
+bool StreamingDerivation::pass(const std::string& source, const std::string& target, const RulePtrMap& ruleset)
+{
+	LsysContext& context = m_lsystem->m_context;
+	DerivationProfiler * profiler = m_lsystem->activeProfiler();
+	LStringFileReader reader(source);
+	LStringFileWriter writer(target);
+
+	// modules already processed are kept as left context, the last ones as right context.
+	AxialTree workingstring;
+	// the last produced modules are kept as new left context.
+	AxialTree targetstring;
+	size_t offset = 0;    // position in the whole string of the first module of workingstring
+	size_t current = 0;   // next module to process in workingstring
+	bool cutting = false; // remove modules up to the end of the current branch
+	size_t depth = 0;     // depth of the brackets opened in the branch being cut
+	bool matching = false;
+	size_t prodlength;
+
+	for(;;) {
+		while (!reader.atEnd() && workingstring.size() - current < m_window + m_lookahead) workingstring += reader.read();
+		bool last = reader.atEnd();
+		size_t limit = last ? workingstring.size() : workingstring.size() - m_lookahead;
+		{
+			GilReleaser gil;
+			AxialTree::const_iterator _beg = workingstring.const_begin();
+			AxialTree::const_iterator _it = _beg + current;
+			AxialTree::const_iterator _it3 = _it;
+			AxialTree::const_iterator _limit = _beg + limit;
+			while ( _it < _limit ) {
+				if (cutting) {
+					gil.native();
+					if (_it->isLeftBracket()) ++depth;
+					else if (_it->isRightBracket()) {
+						if (depth == 0) { cutting = false; continue; }
+						--depth;
+					}
+					++_it;
+				}
+				else if ( _it->isCut() ){
+					gil.native();
+					cutting = true; depth = 0;
+					++_it;
+				}
+				else {
+					bool match = false;
+					size_t position = offset + (_it - _beg);
+					const RulePtrSet& mruleset = ruleset[_it->getClassId()];
+					if (mruleset.empty()) gil.native(); else gil.python();
+					StochasticSelection selection(context.randomStream(), position);
+					// contexts are matched on the lookahead around the module, whatever the content of the window.
+					AxialTree::const_iterator _first = _it - std::min<size_t>(_it - _beg, m_lookahead);
+					AxialTree::const_iterator _last = _it + std::min<size_t>(workingstring.const_end() - _it, m_lookahead + 1);
+					for(RulePtrSet::const_iterator _it2 = mruleset.begin();
+						_it2 != mruleset.end(); _it2++){
+							if(!selection.isSelected(*_it2)) continue;
+							ArgList args;
+							if(profiler) profiler->matchAttempt(*_it2);
+							if((*_it2)->match(_first,_last,_it,targetstring,m_lookahead,_it3,args)){
+								RuleApplicationProbe probe(profiler,*_it2,targetstring);
+								context.randomStream().setAddress(position, (*_it2)->getStreamId());
+								match = (*_it2)->applyTo(targetstring,args,&prodlength);
+								probe.done(match,targetstring);
+								if(match) { _it = _it3; break; }
+							}
+					}
+					if (!match){
+						targetstring.push_back(_it);++_it;
+					}
+					else matching = true;
+				}
+			}
+			current = _it - _beg;
+		}
+		if (last) break;
+		size_t drop = current > m_lookahead ? current - m_lookahead : 0;
+		if (drop > 0) {
+			workingstring = AxialTree(workingstring.const_begin() + drop, workingstring.const_end());
+			offset += drop;
+			current -= drop;
+		}
+		if (targetstring.size() > m_window + m_lookahead) {
+			AxialTree::const_iterator _keep = targetstring.const_end() - m_lookahead;
+			writer.write(AxialTree(targetstring.const_begin(), _keep));
+			targetstring = AxialTree(_keep, targetstring.const_end());
+		}
+	}
+	writer.write(targetstring);
+	writer.close();
+	m_size = writer.size();
+	return matching;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,122 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "lsystem.h"
+#include <fstream>
+#include <QtCore/QFile>
+
+LPY_BEGIN_NAMESPACE
+
+/*---------------------------------------------------------------------------*/
+
+/**
+	Lstring stored in a file as a sequence of chunks, so that it can be written and read 
+	by parts. The file starts with a magic number and a version. Each chunk is then given
+	by its size and a binary AxialTree (see AxialTree::toBinary).
+*/
+class LPY_API LStringFileWriter {
+public:
+	LStringFileWriter(const std::string& filename);
+	~LStringFileWriter();
+
+	/// append the modules of lstring as a new chunk.
+	void write(const AxialTree& lstring);
+	void close();
+
+	/// number of modules written.
+	inline size_t size() const { return m_size; }
+
+protected:
+	std::ofstream m_stream;
+	std::string m_filename;
+	size_t m_size;
+};
+
+/** Read the chunks of an lstring file one at a time. Each chunk is 
+	accessed through a memory mapping of its part of the file. */
+class LPY_API LStringFileReader {
+public:
+	LStringFileReader(const std::string& filename);
+	~LStringFileReader();
+
+	inline bool atEnd() const { return m_pos >= m_size; }
+
+	/// return the modules of the next chunk.
+	AxialTree read();
+
+protected:
+	QFile m_file;
+	std::string m_filename;
+	qint64 m_pos;
+	qint64 m_size;
+};
+
+LPY_API void writeLStringFile(const std::string& filename, const AxialTree& lstring, size_t chunksize = 100000);
+LPY_API AxialTree readLStringFile(const std::string& filename);
+
+/*---------------------------------------------------------------------------*/
+
+/**
+	Derivation of an lstring stored in a file, for strings too large to be kept in memory.
+	Each production or decomposition pass reads the source file by chunks and appends its 
+	result to a new file. Only a window of modules is kept in memory, with lookahead modules 
+	on each side to resolve contexts and the bracket depth of a branch being cut.
+	With a null lookahead, all the rules should be context-free with a single module predecessor.
+	Otherwise, contexts and predecessors should be found within lookahead modules, farther 
+	modules are considered to be out of the string.
+	Rules with queries, backward derivation and Start or StartEach functions 
+	taking the lstring as argument are not supported.
+*/
+class LPY_API StreamingDerivation {
+public:
+	StreamingDerivation(Lsystem * lsystem, size_t window = 100000, size_t lookahead = 0);
+
+	/** Derive nb_iter iterations of the lstring in source and write the result in target, 
+		which may be source itself. Return the number of modules of the result. */
+	size_t derive(const std::string& source, const std::string& target, size_t starting_iter, size_t nb_iter);
+
+protected:
+	/// apply the rules once on the lstring in source and write the result in target. Return whether a rule was applied.
+	bool pass(const std::string& source, const std::string& target, const RulePtrMap& rules);
+
+	void checkRules() const;
+	void callStart(bool starteach);
+
+	Lsystem * m_lsystem;
+	size_t m_window;
+	size_t m_lookahead;
+	size_t m_size;
+};
+
+/*---------------------------------------------------------------------------*/
+
+LPY_END_NAMESPACE
@@ -30,6 +30,7 @@
 
 #include "tracker.h"
 #include <iostream>
+#include <chrono>
 
 LPY_BEGIN_NAMESPACE
 
@@ -44,11 +45,52 @@ TRACKER_CLASS_APPLY(TRACKER_CLASS_IMP_DECLARE)
 
 #define TRACKER_CLASS_PRINT(mclass) std::cerr << #mclass " count : " << Tracker::mclass << std::endl;
 
+#endif
+
+std::atomic<bool> Tracker::enabled(false);
+Tracker::Counter Tracker::counters[Tracker::eNbCategories];
+
+static std::chrono::steady_clock::time_point TRACKER_START = std::chrono::steady_clock::now();
+
 void Tracker::printReport(){
+#ifdef TRACKER_ENABLED
 	TRACKER_CLASS_APPLY(TRACKER_CLASS_PRINT)
+#endif
+	for (int i = 0; i < eNbCategories; ++i){
+		eCategory category = eCategory(i);
+		std::cerr << categoryName(category) << " live : " << live(category) << " bytes : " << bytes(category) 
+				  << " allocations : " << allocations(category) << std::endl;
+	}
 }
 
-#endif
+void Tracker::setEnabled(bool value)
+{
+	if (value && !isEnabled()) reset();
+	enabled = value;
+}
+
+const char * Tracker::categoryName(eCategory category)
+{
+	switch(category){
+		case eAxialTree:      return "AxialTree";
+		case eArgumentBlock:  return "ArgumentBlock";
+		case eModuleArgument: return "ModuleArgument";
+		case eLsysRule:       return "LsysRule";
+		case ePatternString:  return "PatternString";
+		default:              return "Unknown";
+	}
+}
+
+double Tracker::elapsed()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - TRACKER_START).count();
+}
+
+void Tracker::reset()
+{
+	for (int i = 0; i < eNbCategories; ++i) counters[i].allocations = 0;
+	TRACKER_START = std::chrono::steady_clock::now();
+}
 
 /*---------------------------------------------------------------------------*/
 
@@ -32,6 +32,7 @@
 
 #include "lpy_config.h"
 #include <stddef.h>
+#include <atomic>
 
 LPY_BEGIN_NAMESPACE
 
@@ -60,12 +61,63 @@ LPY_BEGIN_NAMESPACE
 
 #define TRACKER_CLASS_DECLARE(mclass) static size_t mclass;
 
+#endif
+
+/** 
+	Count of instances of the main classes. The counts of all classes are only available
+	if compiled with TRACKER_ENABLED. The memory accounting of strings, module arguments, 
+	rules and patterns can be enabled at runtime. Only the instances created while it is 
+	enabled are accounted, each one releasing what it accounted when deleted.
+*/
 class LPY_API Tracker {
 public:
+#ifdef TRACKER_ENABLED
 	TRACKER_CLASS_APPLY(TRACKER_CLASS_DECLARE)
+#endif
 	static void printReport();
+
+	enum eCategory {
+		eAxialTree,
+		eArgumentBlock,  // argument lists of ParamModule
+		eModuleArgument, // python objects held by modules
+		eLsysRule,
+		ePatternString,
+		eNbCategories
+	};
+
+	static inline bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+	static void setEnabled(bool value);
+
+	static inline void allocate(eCategory category, long bytes, long count = 1)
+	{ Counter& c = counters[category]; c.live += count; c.bytes += bytes; c.allocations += count; }
+	static inline void release(eCategory category, long bytes, long count = 1)
+	{ Counter& c = counters[category]; c.live -= count; c.bytes -= bytes; }
+	static inline void resize(eCategory category, long bytes)
+	{ counters[category].bytes += bytes; }
+
+	static const char * categoryName(eCategory category);
+	static inline long live(eCategory category) { return counters[category].live; }
+	static inline long bytes(eCategory category) { return counters[category].bytes; }
+	static inline unsigned long allocations(eCategory category) { return counters[category].allocations; }
+
+	/// Duration in seconds since accounting was enabled or reset.
+	static double elapsed();
+	/// Reset the allocation counts and elapsed time. Live counts are kept.
+	static void reset();
+
+protected:
+	struct Counter {
+		std::atomic<long> live;
+		std::atomic<long> bytes;
+		std::atomic<unsigned long> allocations;
+	};
+
+	static std::atomic<bool> enabled;
+	static Counter counters[eNbCategories];
 };
 
+#ifdef TRACKER_ENABLED
+
 #define IncTracker(classname) ++Tracker::classname;
 #define DecTracker(classname) --Tracker::classname;
 
@@ -78,4 +130,36 @@ public:
 
 /*---------------------------------------------------------------------------*/
 
+/// Memory accounting of an instance, to be used as a member of the accounted class.
+template<Tracker::eCategory category>
+class TrackedInstance {
+public:
+	inline TrackedInstance(size_t bytes) : m_bytes(0) { track(bytes); }
+	inline TrackedInstance(const TrackedInstance& other) : m_bytes(0) { size_t bytes = other.m_bytes.load(); track(bytes ? bytes - 1 : 0); }
+	inline ~TrackedInstance() { size_t bytes = m_bytes.load(); if (bytes) Tracker::release(category, long(bytes - 1)); }
+
+	// the accounting belongs to the instance and is not assigned.
+	inline TrackedInstance& operator=(const TrackedInstance&) { return *this; }
+
+	/// Can be called from several threads on a shared instance. Only the one that changes the size accounts the difference.
+	inline void resize(size_t bytes) 
+	{ 
+		size_t tracked = m_bytes.load(std::memory_order_relaxed);
+		if (tracked && tracked != bytes + 1 && m_bytes.compare_exchange_strong(tracked, bytes + 1)) 
+			Tracker::resize(category, long(bytes) - long(tracked - 1)); 
+	}
+
+protected:
+	inline void track(size_t bytes) 
+	{ if (Tracker::isEnabled()) { m_bytes = bytes + 1; Tracker::allocate(category, long(bytes)); } }
+
+	std::atomic<size_t> m_bytes; // accounted bytes + 1. 0 if not accounted.
+};
+
+/// Category in which the lstrings of a given module type are accounted.
+template<class Module>
+struct TrackedStringCategory;
+
+/*---------------------------------------------------------------------------*/
+
 LPY_END_NAMESPACE
@@ -33,6 +33,7 @@
 #include "../cpp/nodemodule.h"
 #include "../cpp/axialtree_manip.h"
 #include "../cpp/axialtree_iter.h"
+#include "../cpp/streamingderivation.h"
 #include "export_lstring.h"
 #include "../plantgl/python/export_list.h"
 using namespace boost::python;
@@ -246,6 +247,39 @@ void py_insert_ax_tuple(AxialTree * first, int i, const boost::python::tuple& pa
 NodeModule py_node(AxialTree * lstring, int i) 
 {   return NodeModule(int_to_iter(lstring,i),lstring->const_begin(),lstring->const_end());  }
 
+object py_to_binary(const AxialTree * tree)
+{
+  std::string data = tree->toBinary();
+  return object(handle<>(PyBytes_FromStringAndSize(data.data(), data.size())));
+}
+
+AxialTree py_insert_cuts(const AxialTree * tree, object positions)
+{
+  std::vector<size_t> cutpositions;
+  object iterator(handle<>(PyObject_GetIter(positions.ptr())));
+  while (PyObject * item = PyIter_Next(iterator.ptr())) {
+	  long pos = extract<long>(object(handle<>(item)))();
+	  if (pos < 0) pos += tree->size();
+	  if (pos < 0 || pos >= (long)tree->size()) {
+		  PyErr_SetString(PyExc_IndexError, "cut position out of range");
+		  throw_error_already_set();
+	  }
+	  cutpositions.push_back(pos);
+  }
+  if (PyErr_Occurred()) throw_error_already_set();
+  return tree->insertCuts(cutpositions);
+}
+
+void py_to_file(const AxialTree * tree, const std::string& filename, size_t chunksize)
+{ writeLStringFile(filename, *tree, chunksize); }
+
+AxialTree py_from_binary(object data)
+{
+  char * buffer; Py_ssize_t length;
+  if (PyBytes_AsStringAndSize(data.ptr(), &buffer, &length) == -1) throw_error_already_set();
+  return AxialTree::fromBinary(std::string(buffer, length));
+}
+
 void export_AxialTree() {
 
   class_<AxialTree>
@@ -279,6 +313,13 @@ void export_AxialTree() {
 	.PY_MATCH_WRAPPER_DEC(rightmatch)
     .def( "__iter__", &py_at_iter )
     .def( "node", &py_node )
+    .def( "insertCuts", &py_insert_cuts, bp::arg("positions"), "Return a copy with a cut (%) before the modules at the given positions. Raise IndexError for positions out of range." )
+    .def( "toBinary", &py_to_binary, "Return a binary representation of the string." )
+    .def( "fromBinary", &py_from_binary, "Build a string from its binary representation." )
+    .staticmethod("fromBinary")
+    .def( "toFile", &py_to_file, (bp::arg("filename"),bp::arg("chunksize")=100000), "Write the string in a file by chunks of chunksize modules. See Lsystem.deriveStream." )
+    .def( "fromFile", &readLStringFile, "Read a string written with toFile." )
+    .staticmethod("fromFile")
 	;
     axialtree_from_str();
 
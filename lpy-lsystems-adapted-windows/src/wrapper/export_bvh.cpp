@@ -0,0 +1,104 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "../cpp/bvh.h"
+#include "export_vector3.h"
+#include "../plantgl/python/export_refcountptr.h"
+#include "../plantgl/python/export_list.h"
+
+using namespace boost::python;
+#define bp boost::python
+LPY_USING_NAMESPACE
+
+size_t py_bvh_addSegment(BVH * bvh, const bp::object& start, const bp::object& end, real_t radius, long id)
+{ return bvh->addSegment(extract_vector3(start), extract_vector3(end), radius, id); }
+
+size_t py_bvh_addTriangle(BVH * bvh, const bp::object& a, const bp::object& b, const bp::object& c, long id)
+{ return bvh->addTriangle(extract_vector3(a), extract_vector3(b), extract_vector3(c), id); }
+
+void py_bvh_addMesh(BVH * bvh, const bp::object& points, const bp::object& faces, long id)
+{
+	std::vector<TOOLS(Vector3)> vertices = extract_vector3_list(points);
+	bp::object iterator(bp::handle<>(PyObject_GetIter(faces.ptr())));
+	while (PyObject * item = PyIter_Next(iterator.ptr())) {
+		bp::object face((bp::handle<>(item)));
+		size_t nbindices = bp::len(face);
+		std::vector<size_t> indices(nbindices);
+		for (size_t i = 0; i < nbindices; ++i) {
+			indices[i] = bp::extract<size_t>(face[i])();
+			if (indices[i] >= vertices.size()) { PyErr_SetString(PyExc_IndexError, "vertex index out of range"); throw_error_already_set(); }
+		}
+		// polygons are triangulated as fans
+		for (size_t i = 2; i < nbindices; ++i) 
+			bvh->addTriangle(vertices[indices[0]], vertices[indices[i-1]], vertices[indices[i]], id);
+	}
+	if (PyErr_Occurred()) throw_error_already_set();
+}
+
+void py_bvh_setSegment(BVH * bvh, size_t index, const bp::object& start, const bp::object& end, real_t radius)
+{ bvh->setSegment(index, extract_vector3(start), extract_vector3(end), radius); }
+
+bp::object py_bvh_intersectBox(BVH * bvh, const bp::object& lower, const bp::object& upper)
+{ return make_list(bvh->intersectBox(extract_vector3(lower), extract_vector3(upper)))(); }
+
+bp::object py_bvh_intersectSphere(BVH * bvh, const bp::object& center, real_t radius)
+{ return make_list(bvh->intersectSphere(extract_vector3(center), radius))(); }
+
+bp::object py_bvh_intersect(BVH * bvh, const BVH& other)
+{ return make_list(bvh->intersect(other))(); }
+
+bp::object py_bvh_outside(BVH * bvh, const BVH& other)
+{ return make_list(bvh->outside(other))(); }
+
+bool py_bvh_isInside(BVH * bvh, const bp::object& point)
+{ return bvh->isInside(extract_vector3(point)); }
+
+void export_BVH(){
+
+    class_<BVH,BVHPtr,boost::noncopyable>
+	("BVH", "Bounding volume hierarchy over segments and triangles with ids, for batch intersection queries.", init<>("BVH()"))
+	.def("clear", &BVH::clear)
+	.def("__len__", &BVH::size)
+	.def("addSegment", &py_bvh_addSegment, (bp::arg("start"), bp::arg("end"), bp::arg("radius"), bp::arg("id")=-1),
+		 "Add a segment with a radius and return its index.")
+	.def("addTriangle", &py_bvh_addTriangle, (bp::arg("a"), bp::arg("b"), bp::arg("c"), bp::arg("id")=-1),
+		 "Add a triangle and return its index.")
+	.def("addMesh", &py_bvh_addMesh, (bp::arg("points"), bp::arg("faces"), bp::arg("id")=-1),
+		 "Add the triangles of a mesh given by its points and polygons of point indices.")
+	.def("setSegment", &py_bvh_setSegment, (bp::arg("index"), bp::arg("start"), bp::arg("end"), bp::arg("radius")),
+		 "Update a segment. The hierarchy is refitted and not rebuilt.")
+	.def("intersectBox", &py_bvh_intersectBox, args("lower","upper"), "Ids of the primitives intersecting a box.")
+	.def("intersectSphere", &py_bvh_intersectSphere, args("center","radius"), "Ids of the primitives intersecting a sphere.")
+	.def("intersect", &py_bvh_intersect, args("other"), "Ids of the primitives intersecting the primitives of other.")
+	.def("isInside", &py_bvh_isInside, args("point"), "Test if point is inside the closed mesh of the hierarchy.")
+	.def("outside", &py_bvh_outside, args("mesh"), "Ids of the segments with an end outside of the closed mesh of another hierarchy.")
+	;
+}
@@ -0,0 +1,100 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "../cpp/lightgrid.h"
+#include "export_vector3.h"
+#include <boost/python/make_constructor.hpp>
+#include "../plantgl/python/export_refcountptr.h"
+
+using namespace boost::python;
+#define bp boost::python
+LPY_USING_NAMESPACE
+
+LightGrid * create_lightgrid(const bp::object& lower, const bp::object& upper, real_t voxelsize, real_t extinction)
+{ return new LightGrid(extract_vector3(lower), extract_vector3(upper), voxelsize, extinction); }
+
+void py_lg_addSegment(LightGrid * grid, const bp::object& start, const bp::object& end, real_t width, long id)
+{ grid->addSegment(extract_vector3(start), extract_vector3(end), width, id); }
+
+void py_lg_addArea(LightGrid * grid, const bp::object& position, real_t area, long id)
+{ grid->addArea(extract_vector3(position), area, id); }
+
+void py_lg_propagate(LightGrid * grid, const bp::object& direction, real_t intensity)
+{ grid->propagate(extract_vector3(direction), intensity); }
+
+real_t py_lg_light(LightGrid * grid, const bp::object& position)
+{ return grid->light(extract_vector3(position)); }
+
+real_t py_lg_area(LightGrid * grid, const bp::object& position)
+{ return grid->area(extract_vector3(position)); }
+
+real_t py_lg_moduleLight(LightGrid * grid, long id)
+{
+	real_t value;
+	if (!grid->moduleLight(id, value)) {
+		PyErr_SetString(PyExc_KeyError, "no geometry added for this module");
+		throw_error_already_set();
+	}
+	return value;
+}
+
+real_t py_lg_moduleLightDefault(LightGrid * grid, long id, real_t defaultvalue)
+{
+	real_t value;
+	if (!grid->moduleLight(id, value)) return defaultvalue;
+	return value;
+}
+
+void export_LightGrid(){
+
+    class_<LightGrid,LightGridPtr,boost::noncopyable>
+	("LightGrid", "Voxel grid estimating the light intercepted by the plant geometry with a directional sweep.", no_init)
+	.def("__init__", make_constructor(&create_lightgrid, default_call_policies(), 
+		 (bp::arg("lower"), bp::arg("upper"), bp::arg("voxelsize"), bp::arg("extinction")=0.5)), 
+		 "LightGrid(lower, upper, voxelsize, extinction = 0.5)")
+	.def("clear", &LightGrid::clear, "Remove geometry and light.")
+	.def("clearLight", &LightGrid::clearLight, "Remove light only.")
+	.def("addSegment", &py_lg_addSegment, (bp::arg("start"), bp::arg("end"), bp::arg("width"), bp::arg("id")=-1),
+		 "Add the area of a segment of the given width, associated to a module id.")
+	.def("addArea", &py_lg_addArea, (bp::arg("position"), bp::arg("area"), bp::arg("id")=-1),
+		 "Add an area at position, associated to a module id.")
+	.def("propagate", &py_lg_propagate, (bp::arg("direction"), bp::arg("intensity")=1),
+		 "Propagate light traveling in direction. Light of successive directions is summed.")
+	.def("light", &py_lg_light, args("position"))
+	.def("area", &py_lg_area, args("position"))
+	.def("moduleLight", &py_lg_moduleLight, args("id"), "Mean light received by the voxels of a module.")
+	.def("moduleLight", &py_lg_moduleLightDefault, args("id", "default"))
+	.add_property("totalIntensity", &LightGrid::totalIntensity)
+	.add_property("voxelSize", &LightGrid::voxelSize)
+	.add_property("extinction", &LightGrid::extinction, &LightGrid::setExtinction)
+	.def("__len__", &LightGrid::nbVoxels)
+	;
+}
@@ -30,6 +30,7 @@
 #define BOOST_PYTHON_STATIC_LIB
 #include "../cpp/lsyscontext.h"
 #include "../cpp/compilation.h"
+#include "../cpp/derivationcache.h"
 #include "../cpp/patternstring.h"
 #include <boost/python/make_constructor.hpp>
 #include <boost/python/raw_function.hpp>
@@ -203,6 +204,11 @@ void export_LsysContext(){
     .def("setSelectionAlwaysRequired", &LsysContext::setSelectionAlwaysRequired)
     .def("requestSelection", &LsysContext::requestSelection,(bp::arg("message")))
     .def("getIterationNb", &LsysContext::getIterationNb)
+    .def("setRandomSeed", &LsysContext::setRandomSeed,"Set the seed of the reproducible random draws of the derivation.")
+    .def("getRandomSeed", &LsysContext::getRandomSeed)
+    .def("random", &LsysContext::random,"Uniform draw in [0,1) addressed by iteration, module position and rule.")
+    .def("uniform", &LsysContext::uniform,(bp::arg("a"),bp::arg("b")))
+    .def("randint", &LsysContext::randint,(bp::arg("a"),bp::arg("b")))
     .def("isAnimationEnabled",  &LsysContext::isAnimationEnabled)
 	.add_property("__production_buffer__",&LsysContext::get_nproduction,&LsysContext::set_nproduction)
 	.def("__reset_production_buffer",&LsysContext::reset_nproduction)
@@ -228,6 +234,9 @@ void export_LsysContext(){
     def("setSelectionAlwaysRequired", &setSelectionAlwaysRequired);
 	def("requestSelection", &requestSelection,(bp::arg("message")));
     def("getIterationNb", &getIterationNb);
+    def("lrandom", &lrandom,"Reproducible uniform draw in [0,1), addressed by iteration, module position and rule.");
+    def("luniform", &luniform,(bp::arg("a"),bp::arg("b")),"Reproducible uniform draw in [a,b).");
+    def("lrandint", &lrandint,(bp::arg("a"),bp::arg("b")),"Reproducible integer draw in [a,b].");
     def("isAnimationEnabled",  &isAnimationEnabled);
 	def("declare", &declare);
 	def("undeclare", &undeclare);
@@ -242,5 +251,8 @@ void export_LsysContext(){
 
 	def("__setCythonAvailable",&Compilation::setCythonAvailable);
 	def("__setPythonExec",&Compilation::setPythonExec);
+	def("getCacheDirectory",&Compilation::getCacheDirectory,"Return the directory in which compiled code and derivations are cached.");
+	def("setCacheDirectory",&Compilation::setCacheDirectory,"Set the cache directory. An empty path disables the storage on disk.");
+	def("clearDerivationCache",&DerivationCache::clear,"Remove all the derivations stored in the cache directory.");
 
 }
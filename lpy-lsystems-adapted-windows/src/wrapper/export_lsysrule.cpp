@@ -138,6 +138,22 @@ std::string py_str_ag(const ArgList * obj) {
 
 object Lr_param(LsysRule * rule) {  return make_list(rule->formalParameters()); }
 
+object Lr_memo_stats(LsysRule * rule) {
+  ProductionCachePtr memo = rule->getProductionCache();
+  if (!memo) return object();
+  return make_tuple(memo->size(),memo->hits(),memo->misses());
+}
+
+object Lr_probability(LsysRule * rule) {
+  if (!rule->isStochastic()) return object();
+  return object(rule->getProbability());
+}
+
+object Lr_native(LsysRule * rule) {
+  if (!rule->isNative()) return object();
+  return object(rule->nativeRule()->name());
+}
+
 void export_LsysRule(){
 
 #ifdef USE_OBJECTVEC_COLLECTOR
@@ -162,6 +178,10 @@ void export_LsysRule(){
 	.add_property("codelength",&LsysRule::getCodeLength)
 	.add_property("static",&LsysRule::isStatic)
 	.add_property("__static_production__",&LsysRule::getStaticProduction)
+	.add_property("memoized",&LsysRule::isMemoized,&LsysRule::setMemoized)
+	.def("memoStats", &Lr_memo_stats, "Return (size, hits, misses) of the memoization table of the rule or None.")
+	.add_property("probability",&Lr_probability, "Probability of selection of a stochastic rule among the alternatives of its predecessor or None. It is set by '@prob(expr)' in the code of the lsystem.")
+	.add_property("native",&Lr_native, "'library:symbol' of the plugin function of a native rule or None.")
 	.def("predecessor",&LsysRule::predecessor, boost::python::return_internal_reference<1>())
 	.def("leftContext", &LsysRule::leftContext, boost::python::return_internal_reference<1>())
 	.def("newLeftContext", &LsysRule::newLeftContext, boost::python::return_internal_reference<1>())
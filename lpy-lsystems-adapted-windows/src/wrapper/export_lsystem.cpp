@@ -29,7 +29,13 @@
  */
 #define BOOST_PYTHON_STATIC_LIB
 #include "../cpp/lsystem.h"
+#include "../cpp/derivationtask.h"
+#include "../cpp/batchderivation.h"
+#include "../cpp/homomorphismiterator.h"
+#include "../cpp/pipelinedderivation.h"
+#include "../cpp/streamingderivation.h"
 #include "../plantgl/python/export_list.h"
+#include "../plantgl/python/export_refcountptr.h"
 using namespace boost::python;
 #define bp boost::python
 
@@ -53,6 +59,22 @@ void check_ruleid(int& id, size_t nbRule) {
   }
 }
 
+HomomorphismIterator * py_iter_interpretation(Lsystem * lsys, const AxialTree& lstring)
+{ return new HomomorphismIterator(lsys,lstring); }
+
+object py_hi_iter(object self) { return self; }
+
+ParamModule py_hi_next(HomomorphismIterator * it)
+{
+  if (it->atEnd()) {
+	PyErr_SetString(PyExc_StopIteration, "end of interpretation");
+    throw_error_already_set();
+  }
+  ParamModule result = it->current();
+  it->next();
+  return result;
+}
+
 const LsysRule& py_productionRule(Lsystem * lsys, int pos = 0, int group = 0)
 { 
   check_group(group,lsys->nbGroups());
@@ -97,8 +119,116 @@ object py_get_rule_fonction_table(const Lsystem * lsys)
 	return make_dict(lsys->get_rule_fonction_table())();
 }
 
+DerivationTaskPtr py_deriveAsync(object pylsys, object workstring, size_t starting_iter, object nb_iter, object progress)
+{
+	Lsystem * lsys = extract<Lsystem *>(pylsys)();
+	AxialTree axiom = (workstring == object() ? lsys->getAxiom() : extract<AxialTree>(workstring)());
+	size_t nbiter = 0;
+	if (nb_iter != object()) nbiter = extract<size_t>(nb_iter)();
+	else if (starting_iter < lsys->derivationLength()) nbiter = lsys->derivationLength() - starting_iter;
+	DerivationTaskPtr task(new DerivationTask(lsys, axiom, starting_iter, nbiter, progress, pylsys));
+	task->start();
+	return task;
+}
+
+AxialTree py_derivePipelined(Lsystem * lsys, object workstring, size_t starting_iter, object nb_iter, object exporter, size_t queuesize)
+{
+	AxialTree axiom = (workstring == object() ? lsys->getAxiom() : extract<AxialTree>(workstring)());
+	size_t nbiter = 0;
+	if (nb_iter != object()) nbiter = extract<size_t>(nb_iter)();
+	else if (starting_iter < lsys->derivationLength()) nbiter = lsys->derivationLength() - starting_iter;
+	PipelinedDerivation pipeline(lsys, axiom, starting_iter, nbiter, exporter, queuesize);
+	return pipeline.run();
+}
+
+size_t py_deriveStream(Lsystem * lsys, const std::string& source, const std::string& target, size_t starting_iter, object nb_iter, size_t window, size_t lookahead)
+{
+	size_t nbiter = 0;
+	if (nb_iter != object()) nbiter = extract<size_t>(nb_iter)();
+	else if (starting_iter < lsys->derivationLength()) nbiter = lsys->derivationLength() - starting_iter;
+	StreamingDerivation derivation(lsys, window, lookahead);
+	return derivation.derive(source, target, starting_iter, nbiter);
+}
+
+list py_deriveBatch(Lsystem * lsys, object variants, object nb_iter, size_t nbprocesses)
+{
+	DerivationVariantList vlist;
+	for(size_t i = 0; i < (size_t)len(variants); ++i){
+		object variant = variants[i];
+		if (extract<tuple>(variant).check()) {
+			tuple t = extract<tuple>(variant)();
+			dict parameters;
+			if (len(t) > 1 && t[1] != object()) parameters = dict(t[1]);
+			vlist.push_back(DerivationVariant(len(t) > 0 ? object(t[0]) : object(), parameters));
+		}
+		else vlist.push_back(DerivationVariant(variant));
+	}
+	size_t nbiter = (nb_iter == object() ? DerivationVariant::DerivationLength : extract<size_t>(nb_iter)());
+	std::vector<std::string> results = deriveVariants(*lsys, vlist, nbiter, nbprocesses);
+	list pyresults;
+	for(std::vector<std::string>::const_iterator it = results.begin(); it != results.end(); ++it)
+		pyresults.append(object(handle<>(PyBytes_FromStringAndSize(it->data(), it->size()))));
+	return pyresults;
+}
+
+dict py_profile(const Lsystem * lsys)
+{
+	const DerivationProfiler& profiler = lsys->getProfiler();
+	list iterations;
+	const DerivationProfiler::IterationProfileList& iprofiles = profiler.iterations();
+	for(DerivationProfiler::IterationProfileList::const_iterator it = iprofiles.begin(); it != iprofiles.end(); ++it){
+		dict iteration;
+		iteration["iteration"] = it->iteration;
+		iteration["preprocess"] = it->duration[DerivationProfiler::ePreProcess];
+		iteration["production"] = it->duration[DerivationProfiler::eProduction];
+		iteration["decomposition"] = it->duration[DerivationProfiler::eDecomposition];
+		iteration["postprocess"] = it->duration[DerivationProfiler::ePostProcess];
+		iteration["length"] = it->length;
+		iterations.append(iteration);
+	}
+	list rules;
+	DerivationProfiler::RuleProfileList rprofiles = profiler.rules();
+	for(DerivationProfiler::RuleProfileList::const_iterator it = rprofiles.begin(); it != rprofiles.end(); ++it){
+		dict rule;
+		rule["name"] = it->name;
+		rule["group"] = it->group;
+		rule["lineno"] = it->lineno;
+		rule["attempts"] = it->attempts;
+		rule["matches"] = it->matches;
+		rule["applications"] = it->applications;
+		rule["time"] = it->time;
+		rule["produced"] = it->produced;
+		rules.append(rule);
+	}
+	dict result;
+	result["iterations"] = iterations;
+	result["rules"] = rules;
+	return result;
+}
 
 void export_Lsystem(){
+  enum_<DerivationTask::eState>("eDerivationState")
+	  .value("eWaiting",DerivationTask::eWaiting)
+	  .value("eRunning",DerivationTask::eRunning)
+	  .value("eFinished",DerivationTask::eFinished)
+	  .value("eCancelled",DerivationTask::eCancelled)
+	  .value("eFailed",DerivationTask::eFailed)
+	  .export_values()
+	  ;
+
+  class_<DerivationTask,DerivationTaskPtr,boost::noncopyable>
+	  ("DerivationTask", "Derivation of an Lsystem running in a background thread. See Lsystem.deriveAsync.", no_init)
+	.add_property("state",&DerivationTask::state)
+	.add_property("iterationNb",&DerivationTask::iterationNb,"Number of the last completed iteration.")
+	.def("cancel",&DerivationTask::cancel,"Request the derivation to stop at the end of the current iteration.")
+	.def("wait",&DerivationTask::wait,(bp::arg("timeout")=-1),"Wait for the end of the derivation. Timeout is given in ms. Return whether the derivation is done.")
+	.def("done",&DerivationTask::isDone)
+	.def("running",&DerivationTask::isRunning)
+	.def("cancelled",&DerivationTask::isCancelled)
+	.def("currentString",&DerivationTask::currentString,"Return the string of the last completed iteration.")
+	.def("result",&DerivationTask::result,"Wait for the end of the derivation and return its result. Raise the error of the derivation if any.")
+	;
+
   enum_<eDirection>("eDirection")
 	  .value("eForward",eForward)
 	  .value("eBackward",eBackward)
@@ -111,6 +241,13 @@ void export_Lsystem(){
 	  .export_values()
 	  ;
   
+  class_<HomomorphismIterator,boost::noncopyable>
+	  ("HomomorphismIterator", "Modules of the homomorphism of an lstring, computed on the fly.", no_init)
+	.def("__iter__", &py_hi_iter)
+	.def("__next__", &py_hi_next)
+	.def("atEnd", &HomomorphismIterator::atEnd)
+	;
+
   class_<Lsystem,boost::noncopyable>
 	  ("Lsystem", init<optional<std::string,boost::python::dict> >("Lsystem([filename])", args("filename","globals")))
 	.add_property("axiom",&lsys_axiom,(void(Lsystem::*)(const AxialTree&))&Lsystem::setAxiom)
@@ -118,6 +255,8 @@ void export_Lsystem(){
 	.add_property("decompositionMaxDepth",&Lsystem::decompositionMaxDepth,&Lsystem::setDecompositionMaxDepth)
 	.add_property("interpretationMaxDepth",&Lsystem::interpretationMaxDepth,&Lsystem::setInterpretationMaxDepth)
 	.add_property("filename",&Lsystem::getFilename,&Lsystem::setFilename)
+	.add_property("derivationCacheKey",make_function(&Lsystem::getDerivationCacheKey,return_value_policy<copy_const_reference>()),&Lsystem::setDerivationCacheKey,
+				  "Key added to the key of the cached derivations, to describe the external state used by the rules (see the 'Derivation cache' option).")
 	.def("__str__", &Lsystem::str)
 	//.def("__repr__", &Lsystem::str)
 	.def("context", (LsysContext*(Lsystem::*)())&Lsystem::context,return_internal_reference<>(),"Return execution context of the L-system. See also execContext.")
@@ -128,6 +267,8 @@ void export_Lsystem(){
 	.def("isCompiled",&Lsystem::isCompiled)
 	.def("compile",&Lsystem::compile)
 	.def("clear", &Lsystem::clear)
+	.def("clone", &Lsystem::clone, (bp::arg("isolatedNamespace")=true), return_value_policy<manage_new_object>(),
+		 "Return a copy of the Lsystem sharing its compiled rules. If isolatedNamespace, the python namespace is shallow copied, otherwise it is shared.")
 	.def("empty", &Lsystem::empty)
 	.def("code", &Lsystem::code)
 	.def("read", &Lsystem::read,"Read the content of a file and execute it",(boost::python::arg("filename"),boost::python::arg("parameters")=boost::python::dict()))
@@ -136,7 +277,16 @@ void export_Lsystem(){
 	.def("derive", (AxialTree(Lsystem::*)(size_t))&Lsystem::derive)
 	.def("derive", (AxialTree(Lsystem::*)(const AxialTree&))&Lsystem::derive)
 	.def("derive", (AxialTree(Lsystem::*)(const AxialTree&,size_t))&Lsystem::derive)
-	.def("derive", (AxialTree(Lsystem::*)(const AxialTree&,size_t,size_t,bool))&Lsystem::derive,(bp::arg("workstring"),bp::arg("starting_iter"),bp::arg("nb_iter"),bp::arg("previouslyinterpreted")=false))
+	.def("derive", (AxialTree(Lsystem::*)(const AxialTree&,size_t,size_t,bool))&Lsystem::derive,(bp::arg("workstring"),bp::arg("starting_iter"),bp::arg("nb_iter"),bp::arg("previouslyinterpreted")=false),
+		 "Derive the string. The GIL is released while modules are processed by static rules without parameters or left unchanged, and while native rules (@native) run. Matching and applying other rules holds the GIL.")
+	.def("deriveAsync", &py_deriveAsync,(bp::arg("self"),bp::arg("workstring")=object(),bp::arg("starting_iter")=0,bp::arg("nb_iter")=object(),bp::arg("progress")=object()),
+		 "Start the derivation in a background thread and return a DerivationTask. progress(iteration, lstring) is called at the end of each iteration.")
+	.def("derivePipelined", &py_derivePipelined,(bp::arg("workstring")=object(),bp::arg("starting_iter")=0,bp::arg("nb_iter")=object(),bp::arg("exporter")=object(),bp::arg("queuesize")=2),
+		 "Derive in a background thread while the previous iterations are interpreted in the calling thread. exporter(iteration, interpretedstring) is called for the starting string and each iteration. Return the derived string. Only models whose production and decomposition rules are native (@native) or static without parameters are supported, since the derivation must run without the GIL to overlap with the interpretation.")
+	.def("deriveStream", &py_deriveStream,(bp::arg("source"),bp::arg("target"),bp::arg("starting_iter")=0,bp::arg("nb_iter")=object(),bp::arg("window")=100000,bp::arg("lookahead")=0),
+		 "Derive the string stored in the source file (see AxialTree.toFile) and write the result in the target file, keeping only a window of modules in memory. Contexts should be found within lookahead modules. Return the number of modules of the result.")
+	.def("deriveBatch", &py_deriveBatch,(bp::arg("variants"),bp::arg("nb_iter")=object(),bp::arg("nbprocesses")=0),
+		 "Derive the variants given as a list of (seed, parameters) in nbprocesses worker processes. The lsystem is rebuilt with the parameters of each variant and, if nb_iter is None, derived for its derivation length. Return the resulting strings in binary format. See AxialTree.fromBinary.")
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
 	.def("turtle_interpretation", (void(Lsystem::*)(AxialTree&))&Lsystem::turtle_interpretation,"Apply interpretation with execContext().turtle.")
 	.def("turtle_interpretation", (void(Lsystem::*)(AxialTree& , PGL::Turtle&))&Lsystem::turtle_interpretation,"Apply interpretation with given turtle.")
@@ -145,11 +295,16 @@ void export_Lsystem(){
 	.def("plot", (void(Lsystem::*)(AxialTree&,bool))&Lsystem::plot,(bp::arg("lstring"),bp::arg("checkLastComputedScene")=false),"Apply interpretation with execContext().turtle and plot the resulting scene. If checkLastComputedScene, check whether during last iteration a scene was computed. If yes reuse it.")
 #endif
 	.def("interpret", &Lsystem::interpret,"Apply interpretation rule and gives the resulting string.")
+	.def("iterInterpretation", &py_iter_interpretation, return_value_policy<manage_new_object, with_custodian_and_ward_postcall<0,1> >(),
+		 "Iterate on the modules resulting from the interpretation rules without building the resulting string.")
 	.def("nbProductionRules", &Lsystem::nbProductionRules, (bp::arg("group")=0))
 	.def("nbDecompositionRules", &Lsystem::nbDecompositionRules, (bp::arg("group")=0))
 	.def("nbInterpretationRules", &Lsystem::nbInterpretationRules, (bp::arg("group")=0))
 	.def("nbTotalRules", &Lsystem::nbTotalRules,"Return total number of rules considering all groups")
 	.def("nbGroups", &Lsystem::nbGroups,"Return number of groups")
+	.def("profile", &py_profile,"Return the profile of the last derivation as a dict with 'iterations' and 'rules' lists. Rules are sorted by decreasing time. Requires the 'Profiling' option.")
+	.def("clearProfile", &Lsystem::clearProfile)
+	.def("isDerivationCachable", &Lsystem::isDerivationCachable,"Return whether derivations are reused from the derivation cache.")
 	.def("productionRule", py_productionRule, return_internal_reference<>(), (bp::arg("ruleid")=0,bp::arg("group")=0))
 	.def("decompositionRule", py_decompositionRule, return_internal_reference<>(), (bp::arg("ruleid")=0,bp::arg("group")=0))
 	.def("interpretationRule", py_interpretationRule, return_internal_reference<>(), (bp::arg("ruleid")=0,bp::arg("group")=0))
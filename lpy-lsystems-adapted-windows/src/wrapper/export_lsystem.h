@@ -43,6 +43,10 @@ void export_Lsystem();
 void export_parser();
 void export_StringMatching();
 void export_Consider();
+void export_Tracker();
+void export_SpatialIndex();
+void export_LightGrid();
+void export_BVH();
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
 void export_Debugger();
 void export_Interpretation();
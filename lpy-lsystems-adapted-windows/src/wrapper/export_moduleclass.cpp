@@ -49,18 +49,25 @@ LPY_USING_NAMESPACE
 
 std::string mc_repr(ModuleClassPtr mc){
 	std::string res = "ModuleClass('"+mc->name+"',"+TOOLS(number)(mc->getId());
-	if (!mc->aliases.empty()){
-		res+=",['" + mc->aliases[0];
-		for(size_t i = 1; i < mc->aliases.size(); ++i)
-			res+= "','"+mc->aliases[i];
+	ModuleClass::AliasList aliases = mc->getAliases();
+	if (!aliases.empty()){
+		res+=",['" + aliases[0];
+		for(size_t i = 1; i < aliases.size(); ++i)
+			res+= "','"+aliases[i];
 		res += "']";
 	}
 	res += ")";
 	return res;
 }
 
+bool py_get_mandatory_declaration(ModuleClassTable * table) 
+{ return ModuleClassTable::isMandatoryDeclaration(); }
+
+void py_set_mandatory_declaration(ModuleClassTable * table, bool value) 
+{ ModuleClassTable::setMandatoryDeclaration(value); }
+
 boost::python::object py_modaliases(ModuleClass * m) {
-	return make_list<std::vector<std::string> >(m->aliases)();
+	return make_list<std::vector<std::string> >(m->getAliases())();
 }
 
 boost::python::object py_modclasses(ModuleClassTable * m) {
@@ -150,7 +157,7 @@ void export_ModuleClass(){
 	// .def("__repr__",&mc_repr)
 	.def("get",&ModuleClassTable::get,return_value_policy<reference_existing_object>())
 	.staticmethod("get")
-	.def_readwrite("mandatory_declaration",&ModuleClassTable::mandatory_declaration)
+	.add_property("mandatory_declaration",&py_get_mandatory_declaration,&py_set_mandatory_declaration)
 	.def("size",&ModuleClassTable::size)
 	.def("empty",&ModuleClassTable::empty)
 	.def("getClasses",&py_modclasses)
@@ -167,7 +174,8 @@ void export_ModuleClass(){
     for (ModuleClassList::const_iterator itmod = modulelist.begin(); itmod != modulelist.end(); ++itmod){
         if (LpyParsing::isValidVariableName((*itmod)->name))
             scope().attr((*itmod)->name.c_str()) = object(*itmod);
-        for (std::vector<std::string>::const_iterator italias = (*itmod)->aliases.begin(); italias != (*itmod)->aliases.end(); ++italias){
+        ModuleClass::AliasList aliases = (*itmod)->getAliases();
+        for (std::vector<std::string>::const_iterator italias = aliases.begin(); italias != aliases.end(); ++italias){
             if (LpyParsing::isValidVariableName(*italias))
                 scope().attr(italias->c_str()) = object(*itmod);
         }
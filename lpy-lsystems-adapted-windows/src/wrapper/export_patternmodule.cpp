@@ -56,6 +56,7 @@ void export_PatternModule(){
 	.def("isArgs",  &LsysVar::isArgs)
     .def("isKwds",  &LsysVar::isKwds)
     .def("value",  &var_value)
+    .def("hasNativeCondition",  &LsysVar::hasNativeCondition)
 	.add_property("name",var_getname,&LsysVar::setName)
 	;
 
@@ -0,0 +1,103 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "../cpp/spatialindex.h"
+#include "export_vector3.h"
+#include <boost/python/make_constructor.hpp>
+#include "../plantgl/python/export_refcountptr.h"
+#include "../plantgl/python/export_list.h"
+
+using namespace boost::python;
+#define bp boost::python
+LPY_USING_NAMESPACE
+
+SpatialIndex * create_spatialindex(const bp::object& points, const bp::object& attributes)
+{ return new SpatialIndex(extract_vector3_list(points), extract_real_list(attributes)); }
+
+SpatialIndex * create_spatialindex_noattributes(const bp::object& points)
+{ return new SpatialIndex(extract_vector3_list(points)); }
+
+bp::object py_si_nearest(SpatialIndex * index, const bp::object& p)
+{
+	real_t distance;
+	size_t i = index->nearest(extract_vector3(p), &distance);
+	if (i == index->size()) return bp::object();
+	return bp::make_tuple(i, distance);
+}
+
+bp::object py_si_nearestN(SpatialIndex * index, const bp::object& p, size_t k)
+{ return make_list(index->nearest(extract_vector3(p), k))(); }
+
+bp::object py_si_inRadius(SpatialIndex * index, const bp::object& p, real_t radius)
+{ return make_list(index->inRadius(extract_vector3(p), radius))(); }
+
+real_t py_si_weightedAverage(SpatialIndex * index, const bp::object& p, real_t radius, real_t defaultvalue)
+{ return index->weightedAverage(extract_vector3(p), radius, defaultvalue); }
+
+real_t py_si_nearestAttribute(SpatialIndex * index, const bp::object& p)
+{
+	if (!index->hasAttributes() || index->size() == 0) {
+		PyErr_SetString(PyExc_ValueError, "no attributes in the SpatialIndex");
+		throw_error_already_set();
+	}
+	return index->attribute(index->nearest(extract_vector3(p)));
+}
+
+bp::tuple py_si_point(SpatialIndex * index, size_t i)
+{
+	if (i >= index->size()) { PyErr_SetString(PyExc_IndexError, "index out of range"); throw_error_already_set(); }
+	return vector3_to_tuple(index->point(i));
+}
+
+real_t py_si_attribute(SpatialIndex * index, size_t i)
+{
+	if (i >= index->size() || !index->hasAttributes()) { PyErr_SetString(PyExc_IndexError, "index out of range"); throw_error_already_set(); }
+	return index->attribute(i);
+}
+
+void export_SpatialIndex(){
+
+    class_<SpatialIndex,SpatialIndexPtr,boost::noncopyable>
+	("SpatialIndex", "Static kd-tree over points with an optional attribute per point, to query the environment from the rules.", no_init)
+	.def("__init__", make_constructor(&create_spatialindex), "SpatialIndex(points, attributes)")
+	.def("__init__", make_constructor(&create_spatialindex_noattributes), "SpatialIndex(points)")
+	.def("__len__", &SpatialIndex::size)
+	.def("hasAttributes", &SpatialIndex::hasAttributes)
+	.def("point", &py_si_point, args("index"))
+	.def("attribute", &py_si_attribute, args("index"))
+	.def("nearest", &py_si_nearest, args("point"), "Return the index of the nearest point and its distance.")
+	.def("nearestN", &py_si_nearestN, args("point","k"), "Return the indices of the k nearest points, from the nearest one.")
+	.def("inRadius", &py_si_inRadius, args("point","radius"), "Return the indices of the points in radius, from the nearest one.")
+	.def("weightedAverage", &py_si_weightedAverage, (bp::arg("point"),bp::arg("radius"),bp::arg("default")=0), 
+		 "Return the average of the attributes of the points in radius weighted by the inverse of their distance.")
+	.def("nearestAttribute", &py_si_nearestAttribute, args("point"), "Return the attribute of the nearest point.")
+	;
+}
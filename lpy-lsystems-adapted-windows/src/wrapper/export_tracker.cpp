@@ -0,0 +1,72 @@
+/* ---------------------------------------------------------------------------
+ #
+ #       L-Py: L-systems in Python
+ #
+ #       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+ #
+ #       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+ #
+ # ---------------------------------------------------------------------------
+ #
+ #                      GNU General Public Licence
+ #
+ #       This program is free software; you can redistribute it and/or
+ #       modify it under the terms of the GNU General Public License as
+ #       published by the Free Software Foundation; either version 2 of
+ #       the License, or (at your option) any later version.
+ #
+ #       This program is distributed in the hope that it will be useful,
+ #       but WITHOUT ANY WARRANTY; without even the implied warranty of
+ #       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+ #       GNU General Public License for more details.
+ #
+ #       You should have received a copy of the GNU General Public
+ #       License along with this program; see the file COPYING. If not,
+ #       write to the Free Software Foundation, Inc., 59
+ #       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ #
+ # ---------------------------------------------------------------------------
+ */
+
+#define BOOST_PYTHON_STATIC_LIB
+#include "../cpp/tracker.h"
+#include <boost/python.hpp>
+
+using namespace boost::python;
+#define bp boost::python
+LPY_USING_NAMESPACE
+
+bp::dict tracker_report() {
+	bp::dict result;
+	double elapsed = Tracker::elapsed();
+	for (int i = 0; i < Tracker::eNbCategories; ++i) {
+		Tracker::eCategory category = (Tracker::eCategory)i;
+		bp::dict values;
+		values["live"] = Tracker::live(category);
+		values["bytes"] = Tracker::bytes(category);
+		values["allocations"] = Tracker::allocations(category);
+		values["allocationRate"] = (elapsed > 0 ? Tracker::allocations(category) / elapsed : 0.0);
+		result[Tracker::categoryName(category)] = values;
+	}
+	result["time"] = elapsed;
+	return result;
+}
+
+void export_Tracker(){
+
+    class_<Tracker,boost::noncopyable>
+	("Tracker", "Runtime memory accounting of lstrings, module arguments, rules and patterns.", no_init)
+	.def("setEnabled",  &Tracker::setEnabled, args("enabled"), "Enable the accounting. Only the instances created while enabled are accounted.")
+	.staticmethod("setEnabled")
+	.def("isEnabled",   &Tracker::isEnabled)
+	.staticmethod("isEnabled")
+	.def("reset",       &Tracker::reset, "Reset the allocation counts and elapsed time.")
+	.staticmethod("reset")
+	.def("elapsed",     &Tracker::elapsed, "Duration in seconds since accounting was enabled or reset.")
+	.staticmethod("elapsed")
+	.def("report",      &tracker_report, "Return for each category the live instances, the bytes, the allocations and the allocation rate per second.")
+	.staticmethod("report")
+	.def("printReport", &Tracker::printReport)
+	.staticmethod("printReport")
+	;
+}
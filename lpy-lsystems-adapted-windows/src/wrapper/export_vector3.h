@@ -0,0 +1,72 @@
+/* ---------------------------------------------------------------------------
+#
+#       L-Py: L-systems in Python
+#
+#       Copyright 2003-2008 UMR Cirad/Inria/Inra Dap - Virtual Plant Team
+#
+#       File author(s): F. Boudon (frederic.boudon@cirad.fr)
+#
+# ---------------------------------------------------------------------------
+#
+#                      GNU General Public Licence
+#
+#       This program is free software; you can redistribute it and/or
+#       modify it under the terms of the GNU General Public License as
+#       published by the Free Software Foundation; either version 2 of
+#       the License, or (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS For A PARTICULAR PURPOSE. See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public
+#       License along with this program; see the file COPYING. If not,
+#       write to the Free Software Foundation, Inc., 59
+#       Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+#
+# ---------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <boost/python.hpp>
+#include <vector>
+#include "../plantgl/math/util_vector.h"
+
+/* Conversion of python sequences of 3 numbers, such as tuples or mathutils.Vector, to Vector3. */
+
+inline TOOLS(Vector3) extract_vector3(const boost::python::object& obj)
+{
+	if (PySequence_Check(obj.ptr()) == 0 || boost::python::len(obj) != 3) {
+		PyErr_SetString(PyExc_TypeError, "a sequence of 3 numbers is expected");
+		boost::python::throw_error_already_set();
+	}
+	return TOOLS(Vector3)(boost::python::extract<real_t>(obj[0])(),
+						  boost::python::extract<real_t>(obj[1])(),
+						  boost::python::extract<real_t>(obj[2])());
+}
+
+template<class T, class Converter>
+std::vector<T> extract_sequence(const boost::python::object& obj, Converter converter)
+{
+	std::vector<T> result;
+	if (obj.ptr() == Py_None) return result;
+	boost::python::object iterator(boost::python::handle<>(PyObject_GetIter(obj.ptr())));
+	while (PyObject * item = PyIter_Next(iterator.ptr()))
+		result.push_back(converter(boost::python::object(boost::python::handle<>(item))));
+	if (PyErr_Occurred()) boost::python::throw_error_already_set();
+	return result;
+}
+
+inline std::vector<TOOLS(Vector3)> extract_vector3_list(const boost::python::object& obj)
+{ return extract_sequence<TOOLS(Vector3)>(obj, &extract_vector3); }
+
+inline real_t extract_real(const boost::python::object& obj)
+{ return boost::python::extract<real_t>(obj)(); }
+
+inline std::vector<real_t> extract_real_list(const boost::python::object& obj)
+{ return extract_sequence<real_t>(obj, &extract_real); }
+
+inline boost::python::tuple vector3_to_tuple(const TOOLS(Vector3)& v)
+{ return boost::python::make_tuple(v.x(), v.y(), v.z()); }
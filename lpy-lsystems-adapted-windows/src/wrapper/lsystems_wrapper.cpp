@@ -78,6 +78,10 @@ BOOST_PYTHON_MODULE(lpy)
     export_Lsystem();
 	export_parser();
     export_StringMatching();
+    export_Tracker();
+    export_SpatialIndex();
+    export_LightGrid();
+    export_BVH();
 #ifndef LPY_NO_PLANTGL_INTERPRETATION
     export_Debugger();
     export_Interpretation();